@@ -0,0 +1,31 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout (binding=0) uniform Uniforms {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} u;
+
+/* NOTE(jan): Only its size is needed, to get texture coordinates. */
+layout (binding=5) uniform sampler2D heightMap;
+
+/* NOTE(jan): A Terrain::PackedVertex, placed by its chunk's corner. */
+layout (location=0) in uvec2 local;
+layout (location=1) in float height;
+layout (location=2) in vec2 origin;
+
+layout (location=0) out vec2 texCoord;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+void main() {
+    vec2 position = origin + vec2(local);
+    gl_Position = u.proj * u.view * u.model *
+        vec4(position.x, height, position.y, 1.0);
+    /* NOTE(jan): Texture coordinates run from the first vertex of the
+     * terrain to the last. */
+    texCoord = position / (vec2(textureSize(heightMap, 0)) - 1.f);
+}
@@ -0,0 +1,88 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout (binding=0) uniform Uniforms {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    vec4 eye;
+} u;
+
+/* NOTE(jan): A square tile of heights per level, stacked along y, each
+ * holding its level's window toroidally. See Clipmap. */
+layout (binding=6) uniform sampler2D clipmap;
+
+layout (location=0) in vec2 grid;
+layout (location=1) in vec2 origin;
+layout (location=2) in vec2 texel;
+layout (location=3) in vec2 coarseTexel;
+layout (location=4) in float spacing;
+layout (location=5) in float level;
+layout (location=6) in float transition;
+
+layout (location=0) out vec2 texCoord;
+layout (location=1) out vec3 outNormal;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+/* NOTE(jan): Texture coordinates run from 0 to 1 over as much ground as
+ * the other renderers draw, and repeat beyond it. */
+const float TEXTURE_SCALE = 1.f / 1023.f;
+
+float fetch(int tile, ivec2 first, ivec2 offset) {
+    int size = textureSize(clipmap, 0).x;
+    ivec2 t = (first + offset) % size;
+    return texelFetch(clipmap, ivec2(t.x, t.y + tile * size), 0).x;
+}
+
+/* NOTE(jan): The level above at a sample of this level, interpolated
+ * along the edges of its triangles, whose diagonals run from (x + 1, z)
+ * to (x, z + 1). */
+float coarseHeight(ivec2 g) {
+    ivec2 corner = g >> 1;
+    ivec2 odd = g & 1;
+    ivec2 first = ivec2(coarseTexel);
+    int tile = int(level) + 1;
+    float a = fetch(tile, first, corner + ivec2(odd.x, 0));
+    float b = fetch(tile, first, corner + ivec2(0, odd.y));
+    return (a + b) * 0.5f;
+}
+
+/* NOTE(jan): Blends into the level above towards the edge of the window,
+ * so that the outermost samples match it exactly. */
+float height(ivec2 g) {
+    float fine = fetch(int(level), ivec2(texel), g);
+    if (transition == 0.f) {
+        return fine;
+    }
+    float middle = float(textureSize(clipmap, 0).x - 1) * 0.5f;
+    vec2 offset = abs(vec2(g) - middle);
+    float alpha = clamp(
+        (max(offset.x, offset.y) - (middle - transition - 1.f)) / transition,
+        0.f, 1.f
+    );
+    return mix(fine, coarseHeight(g), alpha);
+}
+
+void main() {
+    ivec2 g = ivec2(grid);
+    int last = textureSize(clipmap, 0).x - 1;
+    vec2 position = (origin + grid) * spacing;
+    float y = height(g);
+
+    /* NOTE(jan): Central differences, one-sided at the edge of the
+     * window, where the samples beyond are stale. */
+    ivec2 lo = max(g - 1, ivec2(0));
+    ivec2 hi = min(g + 1, ivec2(last));
+    float dx = (height(ivec2(hi.x, g.y)) - height(ivec2(lo.x, g.y))) /
+        (float(hi.x - lo.x) * spacing);
+    float dz = (height(ivec2(g.x, hi.y)) - height(ivec2(g.x, lo.y))) /
+        (float(hi.y - lo.y) * spacing);
+
+    gl_Position = u.proj * u.view * u.model *
+        vec4(position.x, y, position.y, 1.0);
+    texCoord = position * TEXTURE_SCALE;
+    outNormal = normalize(vec3(-dx, 1.f, -dz));
+}
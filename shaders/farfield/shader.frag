@@ -0,0 +1,237 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+/* NOTE(jan): Ray-marches the ground beyond u.farField, where the triangle
+ * mesh stops, the way HeightPyramid::castRay() does. */
+
+layout (binding=0) uniform Uniforms {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    vec4 eye;
+    vec4 viewport;
+    float farField;
+} u;
+
+layout(binding=2) uniform sampler2D colorTexture;
+layout(binding=3) uniform sampler2D noiseTexture;
+layout(binding=4) uniform sampler2D normalMap;
+/* NOTE(jan): Smoothed height, a texel per vertex of the terrain. */
+layout(binding=5) uniform sampler2D heightMap;
+layout(binding=7) uniform sampler2D occlusionMap;
+/* NOTE(jan): Lowest and highest height of every cell of the height
+ * pyramid, see HeightPyramid::writeBounds(), finest level first. */
+layout(binding=8) readonly buffer Bounds { vec2 bounds[]; };
+
+layout(location=0) in vec3 direction;
+
+layout(location=0) out vec4 outColor;
+/* NOTE(jan): Hits are never nearer than the triangle, see shader.vert. */
+layout(depth_greater) out float gl_FragDepth;
+
+const vec3 green = vec3(0.274509f, 0.537254f, 0.086274f);
+const vec3 yellow = vec3(0.933333f, 0.862745f, 0.509803f);
+const vec3 lightDirection = normalize(vec3(1.f, 1.f, 1.f));
+
+/* NOTE(jan): Rays start this far short of the far field, so that ground
+ * the triangle mesh leaves out just in front of it is still found. */
+const float SEAM = 8.f;
+/* NOTE(jan): Enough for a plane of 32768 samples a side. */
+const uint MAX_LEVELS = 16;
+/* NOTE(jan): Bounds the cost of rays that graze the ground. */
+const int MAX_STEPS = 512;
+const float HIT_EPSILON = 1e-5f;
+const float NO_EXIT = 1e30f;
+
+uint levelCount;
+uvec2 levelSizes[MAX_LEVELS];
+uint levelOffsets[MAX_LEVELS];
+
+/* NOTE(jan): The same sizes as HeightPyramid, a cell per quad at the
+ * bottom and 2x2 cells merged per level up to a single one. */
+void setUpLevels(uvec2 size) {
+    size = max(size - 1u, uvec2(1u));
+    uint offset = 0u;
+    levelCount = 0u;
+    while (levelCount < MAX_LEVELS) {
+        levelSizes[levelCount] = size;
+        levelOffsets[levelCount] = offset;
+        levelCount++;
+        offset += size.x * size.y;
+        if (size == uvec2(1u)) {
+            break;
+        }
+        size = (size + 1u) / 2u;
+    }
+}
+
+float getHeight(uint x, uint z) {
+    return texelFetch(heightMap, ivec2(x, z), 0).x;
+}
+
+uint getCell(float position, float direction, float size, uint count) {
+    float cell = direction < 0.f
+        ? ceil(position / size) - 1.f
+        : floor(position / size);
+    return uint(clamp(cell, 0.f, float(count - 1u)));
+}
+
+float getCellExit(float origin, float direction, uint cell, float size) {
+    if (direction > 0.f) {
+        return (float(cell + 1u) * size - origin) / direction;
+    } else if (direction < 0.f) {
+        return (float(cell) * size - origin) / direction;
+    }
+    return NO_EXIT;
+}
+
+bool clipSlab(float origin, float direction, float lo, float hi,
+              inout float t0, inout float t1) {
+    if (direction == 0.f) {
+        return (origin >= lo) && (origin <= hi);
+    }
+    float a = (lo - origin) / direction;
+    float b = (hi - origin) / direction;
+    t0 = max(t0, min(a, b));
+    t1 = min(t1, max(a, b));
+    return t0 <= t1;
+}
+
+float intersectTriangle(vec3 origin, vec3 direction, vec3 a, vec3 b,
+                        vec3 c) {
+    vec3 e1 = b - a;
+    vec3 e2 = c - a;
+    vec3 p = cross(direction, e2);
+    float det = dot(e1, p);
+    if (abs(det) < 1e-12f) {
+        return -1.f;
+    }
+    float reciprocal = 1.f / det;
+    vec3 s = origin - a;
+    float w1 = dot(s, p) * reciprocal;
+    if ((w1 < -HIT_EPSILON) || (w1 > 1.f + HIT_EPSILON)) {
+        return -1.f;
+    }
+    vec3 q = cross(s, e1);
+    float w2 = dot(direction, q) * reciprocal;
+    if ((w2 < -HIT_EPSILON) || (w1 + w2 > 1.f + HIT_EPSILON)) {
+        return -1.f;
+    }
+    return dot(e2, q) * reciprocal;
+}
+
+/* NOTE(jan): Split along the diagonal from (x + 1, z) to (x, z + 1), like
+ * the triangle mesh. */
+float intersectQuad(vec3 origin, vec3 direction, uint x, uint z, float t0,
+                    float t1) {
+    vec3 p00 = vec3(x, getHeight(x, z), z);
+    vec3 p10 = vec3(x + 1u, getHeight(x + 1u, z), z);
+    vec3 p01 = vec3(x, getHeight(x, z + 1u), z + 1u);
+    vec3 p11 = vec3(x + 1u, getHeight(x + 1u, z + 1u), z + 1u);
+    float slack = HIT_EPSILON * (1.f + t1);
+    float hits[2] = float[](
+        intersectTriangle(origin, direction, p00, p01, p10),
+        intersectTriangle(origin, direction, p10, p01, p11)
+    );
+    float result = -1.f;
+    for (int h = 0; h < 2; h++) {
+        if ((hits[h] >= t0 - slack) && (hits[h] <= t1 + slack) &&
+            ((result < 0.f) || (hits[h] < result))) {
+            result = max(hits[h], 0.f);
+        }
+    }
+    return result;
+}
+
+/* NOTE(jan): Distance along the ray, in multiples of d, of the nearest
+ * hit in [t, tExit], or a negative number. */
+float castRay(vec3 o, vec3 d, float t, float tExit, uvec2 size) {
+    uint top = levelCount - 1u;
+    vec2 bound = bounds[levelOffsets[top]];
+    if (!clipSlab(o.x, d.x, 0.f, float(size.x - 1u), t, tExit) ||
+        !clipSlab(o.z, d.z, 0.f, float(size.y - 1u), t, tExit) ||
+        !clipSlab(o.y, d.y, bound.x, bound.y, t, tExit)) {
+        return -1.f;
+    }
+
+    uint l = top;
+    for (int step = 0; (step < MAX_STEPS) && (t < tExit); step++) {
+        uvec2 cells = levelSizes[l];
+        float cellSize = float(1u << l);
+        vec3 p = o + d * t;
+        uint cx = getCell(p.x, d.x, cellSize, cells.x);
+        uint cz = getCell(p.z, d.z, cellSize, cells.y);
+        float tEnd = min(
+            min(getCellExit(o.x, d.x, cx, cellSize),
+                getCellExit(o.z, d.z, cz, cellSize)),
+            tExit
+        );
+
+        float y0 = o.y + d.y * t;
+        float y1 = o.y + d.y * tEnd;
+        vec2 cell = bounds[levelOffsets[l] + cz * cells.x + cx];
+        bool missed = (max(y0, y1) < cell.x) || (min(y0, y1) > cell.y);
+        if (!missed) {
+            if (l > 0u) {
+                l--;
+                continue;
+            }
+            float hit = intersectQuad(o, d, cx, cz, t, tEnd);
+            if (hit >= 0.f) {
+                return hit;
+            }
+        }
+        /* NOTE(jan): t is positive, so the next float up is one more. */
+        t = tEnd > t ? tEnd : uintBitsToFloat(floatBitsToUint(t) + 1u);
+        l = min(l + 1u, top);
+    }
+    return -1.f;
+}
+
+/* NOTE(jan): Derivatives are no use across the edges of hills, so the
+ * level of detail comes from the size of a pixel on the ground. */
+vec4 sampleAt(sampler2D s, vec2 coord, float footprint, float span) {
+    float texels = footprint * float(textureSize(s, 0).x) / span;
+    return textureLod(s, coord, log2(max(texels, 1.f)));
+}
+
+void main() {
+    uvec2 size = uvec2(textureSize(heightMap, 0));
+    setUpLevels(size);
+
+    /* NOTE(jan): The ray ends at the far plane, where d does. */
+    vec3 o = u.eye.xyz;
+    vec3 d = direction;
+    float t = castRay(o, d, (u.farField - SEAM) / length(d), 1.f, size);
+    if (t < 0.f) {
+        discard;
+    }
+    vec3 position = o + d * t;
+    vec4 clip = u.proj * u.view * u.model * vec4(position, 1.f);
+    gl_FragDepth = clip.z / clip.w;
+
+    /* NOTE(jan): As the ground's shader does. */
+    float span = float(size.x - 1u);
+    float footprint = 2.f * t * length(d) /
+        (abs(u.proj[1][1]) * u.viewport.y);
+    vec2 textureCoord = position.xz / (vec2(size) - 1.f);
+    outColor = sampleAt(colorTexture, textureCoord, footprint, span);
+
+    float noiseValue =
+        sampleAt(noiseTexture, textureCoord, footprint, span).x;
+    vec3 noiseColor = mix(yellow, green, noiseValue);
+    vec3 mixedColor = mix(outColor.xyz, noiseColor, 0.15f);
+
+    vec2 mapSize = vec2(size);
+    vec2 normalCoord = (textureCoord * (mapSize - 1.f) + 0.5f) / mapSize;
+    vec2 encoded = sampleAt(normalMap, normalCoord, footprint, span).xy;
+    vec3 normal = normalize(
+        vec3(encoded.x, 1.f - abs(encoded.x) - abs(encoded.y), encoded.y)
+    );
+
+    float occlusion =
+        sampleAt(occlusionMap, normalCoord, footprint, span).x;
+    float lighting = dot(lightDirection, normal) * occlusion;
+
+    outColor = vec4(lighting * mixedColor, outColor.w);
+}
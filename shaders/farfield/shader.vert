@@ -0,0 +1,43 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout (binding=0) uniform Uniforms {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    vec4 eye;
+    vec4 viewport;
+    float farField;
+} u;
+
+/* NOTE(jan): From the camera to the far plane, in model space. */
+layout (location=0) out vec3 direction;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+/* NOTE(jan): Must match SEAM in shader.frag. */
+const float SEAM = 8.f;
+
+/* NOTE(jan): One triangle over the whole screen. */
+void main() {
+    vec2 corner = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    corner = corner * 2.f - 1.f;
+
+    /* NOTE(jan): Points on the far plane are affine in screen position,
+     * so the directions interpolate exactly. */
+    vec4 far = inverse(u.proj * u.view * u.model) * vec4(corner, 1.f, 1.f);
+    direction = far.xyz / far.w - u.eye.xyz;
+
+    /* NOTE(jan): No ray starts nearer than SEAM short of the far field,
+     * which is nearest to the camera at the corners of the screen. Put
+     * the triangle at that depth, so that the shader, which only ever
+     * pushes fragments back, can be skipped where the triangle mesh is
+     * in front. */
+    vec2 slope = 1.f / vec2(u.proj[0][0], u.proj[1][1]);
+    float nearest =
+        (u.farField - SEAM) * inversesqrt(1.f + dot(slope, slope));
+    vec4 clip = u.proj * vec4(0.f, 0.f, -nearest, 1.f);
+    gl_Position = vec4(corner, clip.z / clip.w, 1.f);
+}
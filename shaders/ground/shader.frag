@@ -1,19 +1,35 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+layout (binding=0) uniform Uniforms {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    vec4 eye;
+    vec4 viewport;
+    float farField;
+} u;
+
 layout(binding=2) uniform sampler2D colorTexture;
 layout(binding=3) uniform sampler2D noiseTexture;
+layout(binding=4) uniform sampler2D normalMap;
+layout(binding=7) uniform sampler2D occlusionMap;
 
 layout(location=0) out vec4 outColor;
 
-layout(location=0) in vec3 normal;
-layout(location=1) in vec2 textureCoord;
+layout(location=0) in vec2 textureCoord;
+layout(location=1) in vec3 fromEye;
 
 const vec3 green = vec3(0.274509f, 0.537254f, 0.086274f);
 const vec3 yellow = vec3(0.933333f, 0.862745f, 0.509803f);
 const vec3 lightDirection = normalize(vec3(1.f, 1.f, 1.f));
 
 void main() {
+    /* NOTE(jan): Past the far field the ground is ray-marched instead,
+     * see shaders/farfield. */
+    if ((u.farField > 0.f) && (length(fromEye) > u.farField)) {
+        discard;
+    }
     outColor = texture(colorTexture, textureCoord);
 
 	/* NOTE(jan): Vary texture colour by noise. */
@@ -21,7 +37,19 @@ void main() {
 	vec3 noiseColor = mix(yellow, green, noiseValue);
 	vec3 mixedColor = mix(outColor.xyz, noiseColor, 0.15f);
 
-	float lighting = dot(lightDirection, normal);
+	/* NOTE(jan): The normal and occlusion maps have a texel per vertex,
+	 * centred on it, while texture coordinates run from the first vertex
+	 * to the last. */
+	vec2 size = vec2(textureSize(normalMap, 0));
+	vec2 normalCoord = (textureCoord * (size - 1.f) + 0.5f) / size;
+	vec2 encoded = texture(normalMap, normalCoord).xy;
+	vec3 normal = normalize(
+		vec3(encoded.x, 1.f - abs(encoded.x) - abs(encoded.y), encoded.y)
+	);
+
+	/* NOTE(jan): Occlusion is baked by Terrain. */
+	float occlusion = texture(occlusionMap, normalCoord).x;
+	float lighting = dot(lightDirection, normal) * occlusion;
 
 	outColor = vec4(lighting * mixedColor, outColor.w);
 }
@@ -5,21 +5,62 @@ layout (binding=0) uniform Uniforms {
     mat4 model;
     mat4 view;
     mat4 proj;
+    vec4 eye;
+    vec4 viewport;
+    float farField;
 } u;
 
-layout (location=0) in vec3 pos;
-layout (location=1) in vec3 normal;
-layout (location=2) in vec2 tex;
+/* NOTE(jan): Smoothed height, a texel per vertex of the terrain. */
+layout (binding=5) uniform sampler2D heightMap;
 
-layout (location=0) out vec3 outNormal;
-layout (location=1) out vec2 texCoord;
+layout (location=0) in vec2 origin;
+layout (location=1) in float spacing;
+layout (location=2) in vec2 morph;
+
+layout (location=0) out vec2 texCoord;
+/* NOTE(jan): From the camera, which interpolates exactly, unlike the
+ * distance. */
+layout (location=1) out vec3 fromEye;
 
 out gl_PerVertex {
     vec4 gl_Position;
 };
 
+/* NOTE(jan): Vertices of either grid are numbered in rows of the whole
+ * node grid's width, see LodInstance. */
+const int GRID_WIDTH = 33;
+
+/* NOTE(jan): Interpolated by hand, since linear filtering of float
+ * textures is optional. */
+float sampleHeightMap(vec2 position, vec2 size) {
+    vec2 corner = min(floor(position), size - 2.f);
+    vec2 t = position - corner;
+    ivec2 i = ivec2(corner);
+    float a = texelFetch(heightMap, i, 0).x;
+    float b = texelFetch(heightMap, i + ivec2(1, 0), 0).x;
+    float c = texelFetch(heightMap, i + ivec2(0, 1), 0).x;
+    float d = texelFetch(heightMap, i + ivec2(1, 1), 0).x;
+    return mix(mix(a, b, t.x), mix(c, d, t.x), t.y);
+}
+
 void main() {
-    gl_Position = u.proj * u.view * u.model * vec4(pos, 1.0);
-    outNormal = normal;
-	texCoord = tex;
+    vec2 grid = vec2(gl_VertexIndex % GRID_WIDTH, gl_VertexIndex / GRID_WIDTH);
+    vec2 size = vec2(textureSize(heightMap, 0));
+    vec2 position = clamp(origin + grid * spacing, vec2(0.f), size - 1.f);
+    float height = sampleHeightMap(position, size);
+
+    /* NOTE(jan): Slide odd vertices onto the even ones before them, which
+     * are the vertices of the next coarser level, as the camera moves
+     * away. By the end of a level's range it matches its coarser
+     * neighbours exactly. */
+    float distance = length(u.eye.xyz - vec3(position.x, height, position.y));
+    float amount = clamp((distance - morph.x) / (morph.y - morph.x), 0.f, 1.f);
+    position = origin + (grid - mod(grid, 2.f) * amount) * spacing;
+    position = clamp(position, vec2(0.f), size - 1.f);
+    height = sampleHeightMap(position, size);
+
+    gl_Position = u.proj * u.view * u.model *
+        vec4(position.x, height, position.y, 1.0);
+    texCoord = position / (size - 1.f);
+    fromEye = vec3(position.x, height, position.y) - u.eye.xyz;
 }
@@ -0,0 +1,10 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout (location=0) in vec2 corner;
+
+layout (location=0) out vec2 outCorner;
+
+void main() {
+    outCorner = corner;
+}
@@ -9,12 +9,12 @@ vkCheckSuccess(VkResult r,
 struct Vertex {
     glm::vec3 pos;
 
-    static VkVertexInputBindingDescription
-    getInputBindingDescription() {
-        VkVertexInputBindingDescription i = {};
-        i.binding = 0;
-        i.stride = sizeof(Vertex);
-        i.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    static std::array<VkVertexInputBindingDescription, 1>
+    getInputBindingDescriptions() {
+        std::array<VkVertexInputBindingDescription, 1> i = {};
+        i[0].binding = 0;
+        i[0].stride = sizeof(Vertex);
+        i[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
         return i;
     }
 
@@ -33,12 +33,12 @@ struct GridVertex: public Vertex {
     glm::vec3 pos;
     uint8_t type;
 
-    static VkVertexInputBindingDescription
-    getInputBindingDescription() {
-        VkVertexInputBindingDescription i = {};
-        i.binding = 0;
-        i.stride = sizeof(GridVertex);
-        i.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    static std::array<VkVertexInputBindingDescription, 1>
+    getInputBindingDescriptions() {
+        std::array<VkVertexInputBindingDescription, 1> i = {};
+        i[0].binding = 0;
+        i[0].stride = sizeof(GridVertex);
+        i[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
         return i;
     }
 
@@ -57,39 +57,243 @@ struct GridVertex: public Vertex {
     }
 };
 
-struct TerrainVertex: public Vertex {
+/* NOTE(jan): Normals come from the ground's normal map rather than the
+ * vertices, see Terrain::writeNormalMap(). The layout of the cooked
+ * terrain, chunks are drawn with ChunkVertex. */
+struct TerrainVertex {
     glm::vec3 pos;
-    glm::vec3 normal;
     glm::vec2 tex;
+    float occlusion;
 
-    static VkVertexInputBindingDescription
-    getInputBindingDescription() {
-        VkVertexInputBindingDescription i = {};
-        i.binding = 0;
-        i.stride = sizeof(TerrainVertex);
-        i.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    static std::array<VkVertexInputBindingDescription, 1>
+    getInputBindingDescriptions() {
+        std::array<VkVertexInputBindingDescription, 1> i = {};
+        i[0].binding = 0;
+        i[0].stride = sizeof(TerrainVertex);
+        i[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
         return i;
     }
 
-    static std::array<VkVertexInputAttributeDescription, 2>
+    static std::array<VkVertexInputAttributeDescription, 3>
     getInputAttributeDescriptions() {
-        std::array<VkVertexInputAttributeDescription, 2> i = {};
+        std::array<VkVertexInputAttributeDescription, 3> i = {};
         i[0].binding = 0;
         i[0].location = 0;
         i[0].format = VK_FORMAT_R32G32B32_SFLOAT;
         i[0].offset = offsetof(TerrainVertex, pos);
-        i[0].binding = 0;
-        i[0].location = 1;
-        i[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-        i[0].offset = offsetof(TerrainVertex, normal);
         i[1].binding = 0;
-        i[1].location = 2;
-        i[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+        i[1].location = 1;
+        i[1].format = VK_FORMAT_R32G32_SFLOAT;
         i[1].offset = offsetof(TerrainVertex, tex);
+        i[2].binding = 0;
+        i[2].location = 2;
+        i[2].format = VK_FORMAT_R32_SFLOAT;
+        i[2].offset = offsetof(TerrainVertex, occlusion);
+        return i;
+    }
+
+    static VertexLayout
+    getLayout() {
+        VertexLayout l = {};
+        l.stride = sizeof(TerrainVertex);
+        l.position = offsetof(TerrainVertex, pos);
+        l.normal = VertexLayout::ABSENT;
+        l.tex = offsetof(TerrainVertex, tex);
+        l.occlusion = offsetof(TerrainVertex, occlusion);
+        return l;
+    }
+};
+
+/* NOTE(jan): A Terrain::PackedVertex of a chunk. Each chunk is an
+ * instance, which places its vertices. */
+struct ChunkVertex {
+    struct Instance {
+        /** Corner of the chunk, in heightmap coordinates. */
+        glm::vec2 origin;
+    };
+
+    static std::array<VkVertexInputBindingDescription, 2>
+    getInputBindingDescriptions() {
+        std::array<VkVertexInputBindingDescription, 2> i = {};
+        i[0].binding = 0;
+        i[0].stride = sizeof(Terrain::PackedVertex);
+        i[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        i[1].binding = 1;
+        i[1].stride = sizeof(Instance);
+        i[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+        return i;
+    }
+
+    static std::array<VkVertexInputAttributeDescription, 3>
+    getInputAttributeDescriptions() {
+        std::array<VkVertexInputAttributeDescription, 3> i = {};
+        i[0].binding = 0;
+        i[0].location = 0;
+        i[0].format = VK_FORMAT_R16G16_UINT;
+        i[0].offset = offsetof(Terrain::PackedVertex, x);
+        i[1].binding = 0;
+        i[1].location = 1;
+        i[1].format = VK_FORMAT_R32_SFLOAT;
+        i[1].offset = offsetof(Terrain::PackedVertex, height);
+        i[2].binding = 1;
+        i[2].location = 2;
+        i[2].format = VK_FORMAT_R32G32_SFLOAT;
+        i[2].offset = offsetof(Instance, origin);
+        return i;
+    }
+};
+
+/* NOTE(jan): A node of a LodQuadtree, drawn as an instance of one of the
+ * shared grids. The grids have no vertex buffer: their vertices are
+ * numbered row after row of LodQuadtree::LEAF_SIZE + 1, and the shader
+ * works out where each is from gl_VertexIndex. The heights come from the
+ * ground's height map. */
+struct LodInstance {
+    /** Corner of the node, in heightmap coordinates. */
+    glm::vec2 origin;
+    /** Width of a quad of the node's level. */
+    float spacing;
+    /** Distances from the camera between which the level morphs. */
+    glm::vec2 morph;
+
+    static std::array<VkVertexInputBindingDescription, 1>
+    getInputBindingDescriptions() {
+        std::array<VkVertexInputBindingDescription, 1> i = {};
+        i[0].binding = 0;
+        i[0].stride = sizeof(LodInstance);
+        i[0].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+        return i;
+    }
+
+    static std::array<VkVertexInputAttributeDescription, 3>
+    getInputAttributeDescriptions() {
+        std::array<VkVertexInputAttributeDescription, 3> i = {};
+        i[0].binding = 0;
+        i[0].location = 0;
+        i[0].format = VK_FORMAT_R32G32_SFLOAT;
+        i[0].offset = offsetof(LodInstance, origin);
+        i[1].binding = 0;
+        i[1].location = 1;
+        i[1].format = VK_FORMAT_R32_SFLOAT;
+        i[1].offset = offsetof(LodInstance, spacing);
+        i[2].binding = 0;
+        i[2].location = 2;
+        i[2].format = VK_FORMAT_R32G32_SFLOAT;
+        i[2].offset = offsetof(LodInstance, morph);
         return i;
     }
 };
 
+/* NOTE(jan): A vertex of the grid every level of a Clipmap is drawn with,
+ * in quads from the corner of the level's window. Each level is an
+ * instance, and the heights come from the clipmap's tiles. */
+struct ClipmapVertex {
+    glm::vec2 grid;
+
+    struct Instance {
+        /** First sample of the level's window, in the level's spacing. */
+        glm::vec2 origin;
+        /** Texel of the level's tile the first sample is at. */
+        glm::vec2 texel;
+        /** Texel of the tile of the level above the first sample is at,
+          * rounded down to a sample of that level. */
+        glm::vec2 coarseTexel;
+        /** Width of a quad of the level. */
+        float spacing;
+        /** Level, which is also the tile of the heightmap it reads. */
+        float level;
+        /** Quads along the edge of the window over which it blends into
+          * the level above, 0 for the coarsest. */
+        float transition;
+    };
+
+    static std::array<VkVertexInputBindingDescription, 2>
+    getInputBindingDescriptions() {
+        std::array<VkVertexInputBindingDescription, 2> i = {};
+        i[0].binding = 0;
+        i[0].stride = sizeof(ClipmapVertex);
+        i[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        i[1].binding = 1;
+        i[1].stride = sizeof(Instance);
+        i[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+        return i;
+    }
+
+    static std::array<VkVertexInputAttributeDescription, 7>
+    getInputAttributeDescriptions() {
+        std::array<VkVertexInputAttributeDescription, 7> i = {};
+        i[0].binding = 0;
+        i[0].location = 0;
+        i[0].format = VK_FORMAT_R32G32_SFLOAT;
+        i[0].offset = offsetof(ClipmapVertex, grid);
+        i[1].binding = 1;
+        i[1].location = 1;
+        i[1].format = VK_FORMAT_R32G32_SFLOAT;
+        i[1].offset = offsetof(Instance, origin);
+        i[2].binding = 1;
+        i[2].location = 2;
+        i[2].format = VK_FORMAT_R32G32_SFLOAT;
+        i[2].offset = offsetof(Instance, texel);
+        i[3].binding = 1;
+        i[3].location = 3;
+        i[3].format = VK_FORMAT_R32G32_SFLOAT;
+        i[3].offset = offsetof(Instance, coarseTexel);
+        i[4].binding = 1;
+        i[4].location = 4;
+        i[4].format = VK_FORMAT_R32_SFLOAT;
+        i[4].offset = offsetof(Instance, spacing);
+        i[5].binding = 1;
+        i[5].location = 5;
+        i[5].format = VK_FORMAT_R32_SFLOAT;
+        i[5].offset = offsetof(Instance, level);
+        i[6].binding = 1;
+        i[6].location = 6;
+        i[6].format = VK_FORMAT_R32_SFLOAT;
+        i[6].offset = offsetof(Instance, transition);
+        return i;
+    }
+};
+
+/* NOTE(jan): A corner of the coarse patches the ground is tessellated
+ * from, in heightmap coordinates. */
+struct PatchVertex {
+    glm::vec2 corner;
+
+    static std::array<VkVertexInputBindingDescription, 1>
+    getInputBindingDescriptions() {
+        std::array<VkVertexInputBindingDescription, 1> i = {};
+        i[0].binding = 0;
+        i[0].stride = sizeof(PatchVertex);
+        i[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        return i;
+    }
+
+    static std::array<VkVertexInputAttributeDescription, 1>
+    getInputAttributeDescriptions() {
+        std::array<VkVertexInputAttributeDescription, 1> i = {};
+        i[0].binding = 0;
+        i[0].location = 0;
+        i[0].format = VK_FORMAT_R32G32_SFLOAT;
+        i[0].offset = offsetof(PatchVertex, corner);
+        return i;
+    }
+};
+
+/* NOTE(jan): For pipelines without vertex buffers, whose shaders work out
+ * where each vertex goes from gl_VertexIndex alone, such as a triangle
+ * over the whole screen. */
+struct NoVertex {
+    static std::array<VkVertexInputBindingDescription, 0>
+    getInputBindingDescriptions() {
+        return {};
+    }
+
+    static std::array<VkVertexInputAttributeDescription, 0>
+    getInputAttributeDescriptions() {
+        return {};
+    }
+};
+
 struct Queue {
     VkQueue q;
     int family_index;
@@ -127,6 +331,8 @@ struct Pipeline {
     VkShaderModule vert;
     VkShaderModule frag;
     VkShaderModule geom;
+    VkShaderModule tesc;
+    VkShaderModule tese;
     VkPipelineLayout layout;
     VkPipeline handle;
 };
@@ -319,6 +525,12 @@ public:
             barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
             stage_src = VK_PIPELINE_STAGE_TRANSFER_BIT;
             stage_dst = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        } else if ((oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) &&
+                   (newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)) {
+            barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            stage_src = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+            stage_dst = VK_PIPELINE_STAGE_TRANSFER_BIT;
         } else if ((oldLayout == VK_IMAGE_LAYOUT_UNDEFINED) &&
                    (newLayout ==
                        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL)) {
@@ -377,7 +589,24 @@ public:
     createDeviceLocalBuffer(
         VkBufferUsageFlags usage,
         VkDeviceSize size,
-        void* contents
+        const void* contents
+    ) const {
+        return this->createDeviceLocalBuffer(
+            usage, size,
+            [&](void* data) { memcpy(data, contents, (size_t)size); }
+        );
+    }
+
+    /**
+     * Create a device local buffer, letting fill write the contents
+     * straight into the mapped staging buffer. The staging memory may be
+     * write-combined, so fill should write sequentially and not read back.
+     */
+    Buffer
+    createDeviceLocalBuffer(
+        VkBufferUsageFlags usage,
+        VkDeviceSize size,
+        const std::function<void(void*)>& fill
     ) const {
         auto staging = this->createBuffer(
            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
@@ -388,7 +617,7 @@ public:
 
         void* data;
         vkMapMemory(this->device, staging.memory, 0, size, 0, &data);
-            memcpy(data, contents, (size_t)size);
+            fill(data);
         vkUnmapMemory(this->device, staging.memory);
 
         auto result = this->createBuffer(
@@ -410,6 +639,44 @@ public:
         return result;
     }
 
+    /**
+     * Overwrite parts of a device local buffer. fill writes size bytes of
+     * new contents into a mapped staging buffer, and each region copies a
+     * range of those bytes into the buffer. Waits for the graphics queue
+     * to drain first, so nothing in flight is still reading the buffer.
+     */
+    void
+    updateDeviceLocalBuffer(
+        const Buffer& buffer,
+        VkDeviceSize size,
+        const std::vector<VkBufferCopy>& regions,
+        const std::function<void(void*)>& fill
+    ) const {
+        if (regions.empty()) {
+            return;
+        }
+        auto staging = this->createBuffer(
+           VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+           size
+        );
+
+        void* data;
+        vkMapMemory(this->device, staging.memory, 0, size, 0, &data);
+            fill(data);
+        vkUnmapMemory(this->device, staging.memory);
+
+        vkQueueWaitIdle(this->queues.graphics.q);
+        auto commandBuffer = this->startCommand();
+        vkCmdCopyBuffer(commandBuffer, staging.buffer, buffer.buffer,
+                        static_cast<uint32_t>(regions.size()), regions.data());
+        this->submitCommand(commandBuffer);
+
+        vkDestroyBuffer(this->device, staging.buffer, nullptr);
+        vkFreeMemory(this->device, staging.memory, nullptr);
+    }
+
     VkDescriptorSetLayout
     createDescriptorSetLayout(
         const std::vector<VkDescriptorSetLayoutBinding>& bindings
@@ -544,35 +811,53 @@ public:
         if (!pixels) {
             throw std::runtime_error("Could not load texture.");
         }
-        auto length = width * height * 4;
+        Image result = this->createTexture(
+            static_cast<uint32_t>(width),
+            static_cast<uint32_t>(height),
+            VK_FORMAT_R8G8B8A8_UNORM,
+            width * height * 4,
+            [&](void* data) { memcpy(data, pixels, width * height * 4); },
+            tile
+        );
+        stbi_image_free(pixels);
+        return result;
+    }
+
+    /**
+     * Create a sampled texture, letting fill write the texels straight
+     * into the mapped staging buffer, tightly packed row after row. The
+     * staging memory may be write-combined, so fill should write
+     * sequentially and not read back.
+     */
+    Image
+    createTexture(uint32_t width,
+                  uint32_t height,
+                  VkFormat format,
+                  VkDeviceSize size,
+                  const std::function<void(void*)>& fill,
+                  bool tile=false) {
         auto staging = this->createBuffer(
             VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
             VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            length
+            size
         );
         void* data;
-        auto size = (VkDeviceSize)length;
         vkMapMemory(this->device, staging.memory, 0, size, 0, &data);
-            memcpy(data, pixels, length);
+            fill(data);
         vkUnmapMemory(this->device, staging.memory);
-        stbi_image_free(pixels);
 
         Image result = this->createImage(
-            {
-                static_cast<uint32_t>(width),
-                static_cast<uint32_t>(height),
-                1
-            },
+            {width, height, 1},
 			VK_SAMPLE_COUNT_1_BIT,
-            VK_FORMAT_R8G8B8A8_UNORM,
+            format,
             VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
             VK_IMAGE_ASPECT_COLOR_BIT
         );
         this->transitionImage(
             result,
-            VK_FORMAT_R8G8B8A8_UNORM,
+            format,
             VK_IMAGE_LAYOUT_UNDEFINED,
             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
         );
@@ -587,11 +872,7 @@ public:
             i.imageSubresource.baseArrayLayer = 0;
             i.imageSubresource.layerCount = 1;
             i.imageOffset = {0, 0};
-            i.imageExtent = {
-                static_cast<uint32_t>(width),
-                static_cast<uint32_t>(height),
-                1
-            };
+            i.imageExtent = {width, height, 1};
             vkCmdCopyBufferToImage(
                 commandBuffer,
                 staging.buffer,
@@ -604,7 +885,7 @@ public:
         }
         this->transitionImage(
             result,
-            VK_FORMAT_R8G8B8A8_UNORM,
+            format,
             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
             VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
         );
@@ -638,6 +919,64 @@ public:
         return result;
     }
 
+    /**
+     * Overwrite parts of a texture made by createTexture(). fill writes
+     * size bytes of new texels into a mapped staging buffer, and each
+     * region copies some of those into the texture. Waits for the
+     * graphics queue to drain first, so nothing in flight is still
+     * sampling the texture.
+     */
+    void
+    updateTexture(
+        const Image& image,
+        VkFormat format,
+        VkDeviceSize size,
+        const std::vector<VkBufferImageCopy>& regions,
+        const std::function<void(void*)>& fill
+    ) {
+        if (regions.empty()) {
+            return;
+        }
+        auto staging = this->createBuffer(
+           VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+           size
+        );
+
+        void* data;
+        vkMapMemory(this->device, staging.memory, 0, size, 0, &data);
+            fill(data);
+        vkUnmapMemory(this->device, staging.memory);
+
+        vkQueueWaitIdle(this->queues.graphics.q);
+        this->transitionImage(
+            image,
+            format,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+        );
+        auto commandBuffer = this->startCommand();
+        vkCmdCopyBufferToImage(
+            commandBuffer,
+            staging.buffer,
+            image.i,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            static_cast<uint32_t>(regions.size()),
+            regions.data()
+        );
+        this->submitCommand(commandBuffer);
+        this->transitionImage(
+            image,
+            format,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+        );
+
+        vkDestroyBuffer(this->device, staging.buffer, nullptr);
+        vkFreeMemory(this->device, staging.memory, nullptr);
+    }
+
     VkShaderModule
     createShaderModule(const std::filesystem::path& path) {
         auto code = readFile(path);
@@ -655,11 +994,20 @@ public:
         return result;
     }
 
+    /**
+     * Create a pipeline from the shaders in a directory. Strip topologies
+     * get primitive restart, so that one draw can hold many strips. Patch
+     * lists take tesc.spv and tese.spv, and patchControlPoints vertices
+     * per patch.
+     */
     template<typename V>
     Pipeline
     createPipeline(const std::filesystem::path& path,
                    VkRenderPass renderPass,
-                   VkDescriptorSetLayout descriptorSetLayout) {
+                   VkDescriptorSetLayout descriptorSetLayout,
+                   VkPrimitiveTopology topology =
+                       VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+                   uint32_t patchControlPoints = 0) {
         Pipeline result = {};
 
         std::vector<char> code;
@@ -682,19 +1030,29 @@ public:
                 result.geom = this->createShaderModule(filePath);
                 i.stage = VK_SHADER_STAGE_GEOMETRY_BIT;
                 i.module = result.geom;
+            } else if (filename == "tesc.spv") {
+                result.tesc = this->createShaderModule(filePath);
+                i.stage = VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+                i.module = result.tesc;
+            } else if (filename == "tese.spv") {
+                result.tese = this->createShaderModule(filePath);
+                i.stage = VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+                i.module = result.tese;
             }
             if (i.stage) {
                 stages.push_back(i);
             }
         }
 
-        auto bindingDescription = V::getInputBindingDescription();
+        auto bindingDescriptions = V::getInputBindingDescriptions();
         auto attributeDescriptions = V::getInputAttributeDescriptions();
         VkPipelineVertexInputStateCreateInfo vertexInput = {};
         vertexInput.sType =
             VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        vertexInput.vertexBindingDescriptionCount = 1;
-        vertexInput.pVertexBindingDescriptions = &bindingDescription;
+        vertexInput.vertexBindingDescriptionCount = static_cast<uint32_t>(
+            bindingDescriptions.size()
+        );
+        vertexInput.pVertexBindingDescriptions = bindingDescriptions.data();
         vertexInput.vertexAttributeDescriptionCount = static_cast<uint32_t>(
             attributeDescriptions.size()
         );
@@ -703,8 +1061,27 @@ public:
         VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
         inputAssembly.sType =
                 VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-        inputAssembly.primitiveRestartEnable = VK_FALSE;
+		inputAssembly.topology = topology;
+        inputAssembly.primitiveRestartEnable =
+            (topology == VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP) ||
+            (topology == VK_PRIMITIVE_TOPOLOGY_LINE_STRIP)
+                ? VK_TRUE : VK_FALSE;
+
+        /* NOTE(jan): Patches are only drawn with both tessellation
+         * stages, and those only take patches. */
+        const bool patches = topology == VK_PRIMITIVE_TOPOLOGY_PATCH_LIST;
+        if (patches != (result.tesc && result.tese)) {
+            throw std::runtime_error(
+                "Patch lists need tessellation shaders and vice versa."
+            );
+        }
+        if (patches && (patchControlPoints == 0)) {
+            throw std::runtime_error("Patch lists need control points.");
+        }
+        VkPipelineTessellationStateCreateInfo tessellation = {};
+        tessellation.sType =
+            VK_STRUCTURE_TYPE_PIPELINE_TESSELLATION_STATE_CREATE_INFO;
+        tessellation.patchControlPoints = patchControlPoints;
 
         VkViewport viewport = {};
         viewport.x = 0.0f;
@@ -807,6 +1184,7 @@ public:
         pipeline.pStages = stages.data();
         pipeline.pVertexInputState = &vertexInput;
         pipeline.pInputAssemblyState = &inputAssembly;
+        pipeline.pTessellationState = patches ? &tessellation : nullptr;
         pipeline.pViewportState = &viewportState;
         pipeline.pRasterizationState = &rasterizer;
         pipeline.pMultisampleState = &multisampling;
@@ -832,6 +1210,12 @@ public:
         if (result.geom) {
             vkDestroyShaderModule(this->device, result.geom, nullptr);
         }
+        if (result.tesc) {
+            vkDestroyShaderModule(this->device, result.tesc, nullptr);
+        }
+        if (result.tese) {
+            vkDestroyShaderModule(this->device, result.tese, nullptr);
+        }
         vkDestroyShaderModule(this->device, result.vert, nullptr);
 
         return result;
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/** Hash of no bytes at all. */
+static const uint64_t HASH_SEED = 14695981039346656037ULL;
+/** FNV 64-bit prime. */
+static const uint64_t HASH_PRIME = 1099511628211ULL;
+
+/**
+  * Continue a 64-bit FNV-1a hash over size bytes. Whole 8-byte words are
+  * folded in at once, which keeps hashing large files cheap at the cost of
+  * not matching reference FNV-1a values. Not meant to be cryptographic,
+  * only to tell inputs apart.
+  *
+  * @param data First byte to hash.
+  * @param size Amount of bytes to hash.
+  * @param hash Hash to continue from.
+  */
+inline uint64_t
+hashBytes(const void* data, size_t size, uint64_t hash = HASH_SEED) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, bytes, sizeof(word));
+        hash = (hash ^ word) * HASH_PRIME;
+        bytes += sizeof(word);
+    }
+    for (; size > 0; size--) {
+        hash = (hash ^ *bytes++) * HASH_PRIME;
+    }
+    return hash;
+}
+
+/**
+  * Continue a hash over the bytes of a plain value.
+  */
+template <typename T>
+inline uint64_t
+hashValue(const T& value, uint64_t hash) {
+    return hashBytes(&value, sizeof(value), hash);
+}
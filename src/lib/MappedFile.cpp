@@ -0,0 +1,215 @@
+#include "MappedFile.h"
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+# ifndef NOMINMAX
+#  define NOMINMAX
+# endif
+# include <windows.h>
+#else
+# include <cerrno>
+# include <cstring>
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+using std::runtime_error;
+
+MappedFile::
+MappedFile(const string& path) :
+        MappedFile(path, 0, false) {}
+
+MappedFile MappedFile::
+create(const string& path, size_t size) {
+    return MappedFile(path, size, true);
+}
+
+#ifdef _WIN32
+
+MappedFile::
+MappedFile(const string& path, size_t size, bool writable) :
+        _data(nullptr),
+        _size(size),
+        _writable(writable),
+        _file(INVALID_HANDLE_VALUE),
+        _mapping(nullptr) {
+    _file = CreateFileA(
+        path.c_str(),
+        writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        writable ? CREATE_ALWAYS : OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        nullptr
+    );
+    if (_file == INVALID_HANDLE_VALUE) {
+        throw runtime_error("Could not open " + path);
+    }
+    if (!writable) {
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(_file, &fileSize);
+        _size = static_cast<size_t>(fileSize.QuadPart);
+    }
+    if (_size == 0) {
+        /* NOTE(jan): Empty files can't be mapped. */
+        return;
+    }
+    const unsigned long long mappingSize = _size;
+    _mapping = CreateFileMappingA(
+        _file, nullptr,
+        writable ? PAGE_READWRITE : PAGE_READONLY,
+        static_cast<DWORD>(mappingSize >> 32),
+        static_cast<DWORD>(mappingSize & 0xffffffff),
+        nullptr
+    );
+    if (_mapping == nullptr) {
+        release();
+        throw runtime_error("Could not map " + path);
+    }
+    _data = static_cast<unsigned char*>(MapViewOfFile(
+        _mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, _size
+    ));
+    if (_data == nullptr) {
+        release();
+        throw runtime_error("Could not map " + path);
+    }
+}
+
+void MappedFile::
+release() {
+    if (_data) UnmapViewOfFile(_data);
+    if (_mapping) CloseHandle(_mapping);
+    if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+    _data = nullptr;
+    _mapping = nullptr;
+    _file = INVALID_HANDLE_VALUE;
+}
+
+MappedFile::
+MappedFile(MappedFile&& rhs) noexcept :
+        _data(rhs._data),
+        _size(rhs._size),
+        _writable(rhs._writable),
+        _file(rhs._file),
+        _mapping(rhs._mapping) {
+    rhs._data = nullptr;
+    rhs._mapping = nullptr;
+    rhs._file = INVALID_HANDLE_VALUE;
+}
+
+MappedFile& MappedFile::
+operator=(MappedFile&& rhs) noexcept {
+    if (this != &rhs) {
+        release();
+        std::swap(_data, rhs._data);
+        std::swap(_size, rhs._size);
+        std::swap(_writable, rhs._writable);
+        std::swap(_file, rhs._file);
+        std::swap(_mapping, rhs._mapping);
+    }
+    return *this;
+}
+
+#else
+
+MappedFile::
+MappedFile(const string& path, size_t size, bool writable) :
+        _data(nullptr),
+        _size(size),
+        _writable(writable),
+        _fd(-1) {
+    _fd = writable ? open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644)
+                   : open(path.c_str(), O_RDONLY);
+    if (_fd < 0) {
+        throw runtime_error(
+            "Could not open " + path + ": " + strerror(errno)
+        );
+    }
+    if (writable) {
+        if (ftruncate(_fd, static_cast<off_t>(size)) != 0) {
+            release();
+            throw runtime_error("Could not resize " + path);
+        }
+    } else {
+        struct stat info;
+        fstat(_fd, &info);
+        _size = static_cast<size_t>(info.st_size);
+    }
+    if (_size == 0) {
+        /* NOTE(jan): Empty files can't be mapped. */
+        return;
+    }
+    void* data = mmap(
+        nullptr, _size,
+        writable ? PROT_READ | PROT_WRITE : PROT_READ,
+        MAP_SHARED, _fd, 0
+    );
+    if (data == MAP_FAILED) {
+        release();
+        throw runtime_error("Could not map " + path + ": " + strerror(errno));
+    }
+    _data = static_cast<unsigned char*>(data);
+    if (!writable) {
+        /* NOTE(jan): Readers mostly stream through the file front to back. */
+        madvise(_data, _size, MADV_SEQUENTIAL);
+    }
+}
+
+void MappedFile::
+release() {
+    if (_data) munmap(_data, _size);
+    if (_fd >= 0) close(_fd);
+    _data = nullptr;
+    _fd = -1;
+}
+
+MappedFile::
+MappedFile(MappedFile&& rhs) noexcept :
+        _data(rhs._data),
+        _size(rhs._size),
+        _writable(rhs._writable),
+        _fd(rhs._fd) {
+    rhs._data = nullptr;
+    rhs._fd = -1;
+}
+
+MappedFile& MappedFile::
+operator=(MappedFile&& rhs) noexcept {
+    if (this != &rhs) {
+        release();
+        std::swap(_data, rhs._data);
+        std::swap(_size, rhs._size);
+        std::swap(_writable, rhs._writable);
+        std::swap(_fd, rhs._fd);
+    }
+    return *this;
+}
+
+#endif
+
+MappedFile::
+~MappedFile() {
+    release();
+}
+
+const unsigned char* MappedFile::
+getData() const {
+    return _data;
+}
+
+unsigned char* MappedFile::
+getWritableData() {
+    if (!_writable) {
+        throw runtime_error("Mapping is read-only.");
+    }
+    return _data;
+}
+
+size_t MappedFile::
+getSize() const {
+    return _size;
+}
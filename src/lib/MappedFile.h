@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+using std::string;
+
+/**
+  * A file mapped into the address space. Pages are faulted in on first
+  * access, so nothing is read until it is used.
+  */
+class MappedFile {
+public:
+    /**
+      * Constructor, maps an existing file read-only.
+      *
+      * @param path Path to the file.
+      */
+    explicit MappedFile(const string& path);
+
+    /**
+      * Create (or truncate) a file of the given size and map it writable.
+      *
+      * @param path Path to the file.
+      * @param size Size of the file in bytes.
+      */
+    static MappedFile create(const string& path, size_t size);
+
+    /**
+      * Destructor, unmaps the file. Writes to a writable mapping are
+      * flushed to the file by the OS.
+      */
+    ~MappedFile();
+
+    MappedFile(MappedFile&& rhs) noexcept;
+    MappedFile& operator=(MappedFile&& rhs) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+      * Get the start of the mapping.
+      */
+    const unsigned char* getData() const;
+
+    /**
+      * Get the start of a writable mapping.
+      */
+    unsigned char* getWritableData();
+
+    /**
+      * Get the size of the file in bytes.
+      */
+    size_t getSize() const;
+
+private:
+    /**
+      * Constructor, maps a file.
+      */
+    MappedFile(const string& path, size_t size, bool writable);
+
+    /**
+      * Unmap and close.
+      */
+    void release();
+
+    /** Start of the mapping. */
+    unsigned char* _data;
+    /** Size of the mapping in bytes. */
+    size_t _size;
+    /** Whether the mapping may be written to. */
+    bool _writable;
+#ifdef _WIN32
+    /** File handle. */
+    void* _file;
+    /** File mapping object handle. */
+    void* _mapping;
+#else
+    /** File descriptor. */
+    int _fd;
+#endif
+};
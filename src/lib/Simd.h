@@ -0,0 +1,131 @@
+#pragma once
+
+/**
+  * Thin wrappers around the widest float vector instructions the compiler
+  * has been told it may use. AVX is used when the translation unit is built
+  * with AVX enabled (see ENABLE_AVX2 in CMakeLists.txt), otherwise SSE2,
+  * which every x64 target supports. Other targets fall back to scalars so
+  * that the kernels built on top of this still compile everywhere.
+  */
+
+#include <cstdint>
+
+#if defined(__AVX__)
+# include <immintrin.h>
+# define SIMD_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || \
+      (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# include <emmintrin.h>
+# define SIMD_SSE 1
+#endif
+
+#if defined(SIMD_AVX)
+
+/** How many floats fit in one vector register. */
+static const unsigned SIMD_WIDTH = 8;
+typedef __m256 simd_float;
+
+inline simd_float simd_load(const float* p) { return _mm256_loadu_ps(p); }
+inline void simd_store(float* p, simd_float v) { _mm256_storeu_ps(p, v); }
+inline simd_float simd_set1(float f) { return _mm256_set1_ps(f); }
+inline simd_float simd_zero() { return _mm256_setzero_ps(); }
+inline simd_float simd_add(simd_float a, simd_float b) { return _mm256_add_ps(a, b); }
+inline simd_float simd_sub(simd_float a, simd_float b) { return _mm256_sub_ps(a, b); }
+inline simd_float simd_mul(simd_float a, simd_float b) { return _mm256_mul_ps(a, b); }
+inline simd_float simd_div(simd_float a, simd_float b) { return _mm256_div_ps(a, b); }
+inline simd_float simd_min(simd_float a, simd_float b) { return _mm256_min_ps(a, b); }
+inline simd_float simd_max(simd_float a, simd_float b) { return _mm256_max_ps(a, b); }
+inline simd_float simd_floor(simd_float a) { return _mm256_floor_ps(a); }
+inline simd_float simd_sqrt(simd_float a) { return _mm256_sqrt_ps(a); }
+inline void simd_store_int(int32_t* p, simd_float v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm256_cvttps_epi32(v));
+}
+# if defined(__FMA__)
+inline simd_float simd_madd(simd_float a, simd_float b, simd_float c) {
+    return _mm256_fmadd_ps(a, b, c);
+}
+# else
+inline simd_float simd_madd(simd_float a, simd_float b, simd_float c) {
+    return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+}
+# endif
+# if defined(__AVX2__)
+inline simd_float simd_gather(const float* base, const int32_t* indices) {
+    __m256i i = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices));
+    return _mm256_i32gather_ps(base, i, 4);
+}
+# else
+inline simd_float simd_gather(const float* base, const int32_t* indices) {
+    return _mm256_setr_ps(
+        base[indices[0]], base[indices[1]], base[indices[2]], base[indices[3]],
+        base[indices[4]], base[indices[5]], base[indices[6]], base[indices[7]]
+    );
+}
+# endif
+
+#elif defined(SIMD_SSE)
+
+/** How many floats fit in one vector register. */
+static const unsigned SIMD_WIDTH = 4;
+typedef __m128 simd_float;
+
+inline simd_float simd_load(const float* p) { return _mm_loadu_ps(p); }
+inline void simd_store(float* p, simd_float v) { _mm_storeu_ps(p, v); }
+inline simd_float simd_set1(float f) { return _mm_set1_ps(f); }
+inline simd_float simd_zero() { return _mm_setzero_ps(); }
+inline simd_float simd_add(simd_float a, simd_float b) { return _mm_add_ps(a, b); }
+inline simd_float simd_sub(simd_float a, simd_float b) { return _mm_sub_ps(a, b); }
+inline simd_float simd_mul(simd_float a, simd_float b) { return _mm_mul_ps(a, b); }
+inline simd_float simd_div(simd_float a, simd_float b) { return _mm_div_ps(a, b); }
+inline simd_float simd_min(simd_float a, simd_float b) { return _mm_min_ps(a, b); }
+inline simd_float simd_max(simd_float a, simd_float b) { return _mm_max_ps(a, b); }
+inline simd_float simd_sqrt(simd_float a) { return _mm_sqrt_ps(a); }
+inline void simd_store_int(int32_t* p, simd_float v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_cvttps_epi32(v));
+}
+inline simd_float simd_floor(simd_float a) {
+    /* NOTE(jan): SSE2 has no floor, truncate and correct negatives. */
+    simd_float t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+    simd_float correction = _mm_and_ps(_mm_cmpgt_ps(t, a), _mm_set1_ps(1.f));
+    return _mm_sub_ps(t, correction);
+}
+inline simd_float simd_madd(simd_float a, simd_float b, simd_float c) {
+    return _mm_add_ps(_mm_mul_ps(a, b), c);
+}
+inline simd_float simd_gather(const float* base, const int32_t* indices) {
+    return _mm_setr_ps(
+        base[indices[0]], base[indices[1]], base[indices[2]], base[indices[3]]
+    );
+}
+
+#else
+
+#include <cmath>
+
+/** How many floats fit in one vector register. */
+static const unsigned SIMD_WIDTH = 1;
+typedef float simd_float;
+
+inline simd_float simd_load(const float* p) { return *p; }
+inline void simd_store(float* p, simd_float v) { *p = v; }
+inline simd_float simd_set1(float f) { return f; }
+inline simd_float simd_zero() { return 0.f; }
+inline simd_float simd_add(simd_float a, simd_float b) { return a + b; }
+inline simd_float simd_sub(simd_float a, simd_float b) { return a - b; }
+inline simd_float simd_mul(simd_float a, simd_float b) { return a * b; }
+inline simd_float simd_div(simd_float a, simd_float b) { return a / b; }
+inline simd_float simd_min(simd_float a, simd_float b) { return a < b ? a : b; }
+inline simd_float simd_max(simd_float a, simd_float b) { return a > b ? a : b; }
+inline simd_float simd_floor(simd_float a) { return std::floor(a); }
+inline simd_float simd_sqrt(simd_float a) { return std::sqrt(a); }
+inline void simd_store_int(int32_t* p, simd_float v) {
+    *p = static_cast<int32_t>(v);
+}
+inline simd_float simd_madd(simd_float a, simd_float b, simd_float c) {
+    return a * b + c;
+}
+inline simd_float simd_gather(const float* base, const int32_t* indices) {
+    return base[indices[0]];
+}
+
+#endif
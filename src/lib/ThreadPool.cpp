@@ -0,0 +1,128 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::
+ThreadPool(unsigned threadCount) :
+        _job(nullptr),
+        _count(0),
+        _grain(1),
+        _next(0),
+        _generation(0),
+        _busy(0),
+        _stopping(false) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned i = 1; i < threadCount; i++) {
+        _threads.emplace_back(&ThreadPool::work, this);
+    }
+}
+
+ThreadPool::
+~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _wake.notify_all();
+    for (auto& thread: _threads) {
+        thread.join();
+    }
+}
+
+ThreadPool& ThreadPool::
+shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+unsigned ThreadPool::
+getThreadCount() const {
+    return static_cast<unsigned>(_threads.size()) + 1;
+}
+
+void ThreadPool::
+parallelFor(size_t count, size_t grain,
+            const function<void(size_t, size_t)>& job) {
+    if (count == 0) {
+        return;
+    }
+    grain = std::max<size_t>(grain, 1);
+    if (_threads.empty() || count <= grain) {
+        job(0, count);
+        return;
+    }
+
+    std::lock_guard<std::mutex> batch(_batchMutex);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _job = &job;
+        _count = count;
+        _grain = grain;
+        _next = 0;
+        _error = nullptr;
+        _busy = static_cast<unsigned>(_threads.size());
+        _generation++;
+    }
+    _wake.notify_all();
+
+    runRanges();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _done.wait(lock, [this] { return _busy == 0; });
+    _job = nullptr;
+    if (_error) {
+        std::rethrow_exception(_error);
+    }
+}
+
+void ThreadPool::
+work() {
+    unsigned long seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wake.wait(lock, [&] {
+                return _stopping || _generation != seen;
+            });
+            if (_stopping) {
+                return;
+            }
+            seen = _generation;
+        }
+        runRanges();
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _busy--;
+        }
+        _done.notify_one();
+    }
+}
+
+void ThreadPool::
+runRanges() {
+    for (;;) {
+        size_t begin;
+        size_t end;
+        const function<void(size_t, size_t)>* job;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_next >= _count || _error) {
+                return;
+            }
+            begin = _next;
+            end = std::min(_count, begin + _grain);
+            _next = end;
+            job = _job;
+        }
+        try {
+            (*job)(begin, end);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_error) {
+                _error = std::current_exception();
+            }
+        }
+    }
+}
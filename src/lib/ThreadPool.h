@@ -0,0 +1,89 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using std::function;
+using std::vector;
+
+/**
+  * A fixed set of worker threads that split ranges of work between them.
+  */
+class ThreadPool {
+public:
+    /**
+      * Constructor, starts the workers.
+      *
+      * @param threadCount Amount of threads that run jobs, including the
+      *                    calling thread. Zero uses one per hardware thread.
+      */
+    explicit ThreadPool(unsigned threadCount = 0);
+
+    /**
+      * Destructor, stops and joins the workers.
+      */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+      * Get the pool shared by everything that doesn't need its own.
+      */
+    static ThreadPool& shared();
+
+    /**
+      * Get the amount of threads that run jobs, including the caller.
+      */
+    unsigned getThreadCount() const;
+
+    /**
+      * Split [0, count) into ranges of at most grain items and call
+      * job(begin, end) for each of them across the pool. The calling thread
+      * helps out and the call returns once every range is done. If a job
+      * throws, the first exception is rethrown here.
+      */
+    void parallelFor(size_t count, size_t grain,
+                     const function<void(size_t, size_t)>& job);
+
+private:
+    /**
+      * Worker thread body.
+      */
+    void work();
+
+    /**
+      * Claim and run ranges of the current batch until none are left.
+      */
+    void runRanges();
+
+    /** The workers. The calling thread is not in here. */
+    vector<std::thread> _threads;
+    /** Guards everything below. */
+    std::mutex _mutex;
+    /** Signalled when a batch starts or the pool stops. */
+    std::condition_variable _wake;
+    /** Signalled when a worker finishes with a batch. */
+    std::condition_variable _done;
+    /** Serializes parallelFor calls from different threads. */
+    std::mutex _batchMutex;
+    /** Job of the current batch. */
+    const function<void(size_t, size_t)>* _job;
+    /** Total items in the current batch. */
+    size_t _count;
+    /** Items per range in the current batch. */
+    size_t _grain;
+    /** First item not yet claimed. */
+    size_t _next;
+    /** Incremented for every batch so workers can tell them apart. */
+    unsigned long _generation;
+    /** Workers still busy with the current batch. */
+    unsigned _busy;
+    /** First exception thrown by the current batch. */
+    std::exception_ptr _error;
+    /** Set when the pool is being destroyed. */
+    bool _stopping;
+};
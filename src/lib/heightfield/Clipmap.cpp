@@ -0,0 +1,133 @@
+#include "Clipmap.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+
+using std::runtime_error;
+
+/**
+  * Get a modulo b in [0, b), also for negative a.
+  */
+static unsigned
+wrap(int a, unsigned b) {
+    const int m = a % static_cast<int>(b);
+    return static_cast<unsigned>(m < 0 ? m + static_cast<int>(b) : m);
+}
+
+Clipmap::
+Clipmap(shared_ptr<const FractalNoise> noise, float heightScale,
+        unsigned levelCount, unsigned size) :
+        _noise(noise),
+        _heightScale(heightScale),
+        _size(size),
+        _originX(levelCount),
+        _originZ(levelCount),
+        _placed(false) {
+    if (levelCount == 0) {
+        throw runtime_error("Clipmap has no levels.");
+    }
+    if ((size == 0) || (size % 4 != 0)) {
+        throw runtime_error("Clipmap size must be a multiple of 4.");
+    }
+}
+
+vector<Clipmap::Region> Clipmap::
+move(float x, float z) {
+    vector<Region> regions;
+    const int size = static_cast<int>(getTextureSize());
+    for (unsigned l = 0; l < getLevelCount(); l++) {
+        /* NOTE(jan): Snapped to the spacing of the level above, which is
+         * twice this level's. */
+        const float above = static_cast<float>(2u << l);
+        const int ox =
+            2 * static_cast<int>(std::floor(x / above)) - int(_size / 2);
+        const int oz =
+            2 * static_cast<int>(std::floor(z / above)) - int(_size / 2);
+        const int dx = ox - _originX[l];
+        const int dz = oz - _originZ[l];
+        if (!_placed || (std::abs(dx) >= size) || (std::abs(dz) >= size)) {
+            addRegions(l, ox, oz, size, size, regions);
+        } else {
+            /* NOTE(jan): Columns that scrolled in cover every row of the
+             * window, rows that scrolled in only the columns that were
+             * already there. */
+            if (dx > 0) {
+                addRegions(l, _originX[l] + size, oz, dx, size, regions);
+            } else if (dx < 0) {
+                addRegions(l, ox, oz, -dx, size, regions);
+            }
+            const int kept = dx > 0 ? ox : _originX[l];
+            const unsigned width = size - std::abs(dx);
+            if (dz > 0) {
+                addRegions(l, kept, _originZ[l] + size, width, dz, regions);
+            } else if (dz < 0) {
+                addRegions(l, kept, oz, width, -dz, regions);
+            }
+        }
+        _originX[l] = ox;
+        _originZ[l] = oz;
+    }
+    _placed = true;
+    return regions;
+}
+
+void Clipmap::
+writeRegion(float* dst, const Region& region) const {
+    /* NOTE(jan): Scaled on the way out rather than in place, since dst
+     * may be write-combined staging memory. */
+    const int spacing = 1 << region.level;
+    vector<float> row(region.width);
+    for (unsigned z = 0; z < region.depth; z++) {
+        _noise->evaluate(region.x0 * spacing,
+                         (region.z0 + int(z)) * spacing, region.width, 1,
+                         row.data(), spacing);
+        for (unsigned x = 0; x < region.width; x++) {
+            *dst++ = row[x] * _heightScale;
+        }
+    }
+}
+
+unsigned Clipmap::
+getLevelCount() const {
+    return static_cast<unsigned>(_originX.size());
+}
+
+unsigned Clipmap::
+getSize() const {
+    return _size;
+}
+
+unsigned Clipmap::
+getTextureSize() const {
+    return _size + 1;
+}
+
+int Clipmap::
+getOriginX(unsigned level) const {
+    return _originX[level];
+}
+
+int Clipmap::
+getOriginZ(unsigned level) const {
+    return _originZ[level];
+}
+
+void Clipmap::
+addRegions(unsigned level, int x0, int z0, unsigned width, unsigned depth,
+           vector<Region>& regions) const {
+    const unsigned size = getTextureSize();
+    const unsigned tx = wrap(x0, size);
+    const unsigned tz = wrap(z0, size);
+    if (tx + width > size) {
+        const unsigned left = size - tx;
+        addRegions(level, x0, z0, left, depth, regions);
+        addRegions(level, x0 + int(left), z0, width - left, depth, regions);
+    } else if (tz + depth > size) {
+        const unsigned top = size - tz;
+        addRegions(level, x0, z0, width, top, regions);
+        addRegions(level, x0, z0 + int(top), width, depth - top, regions);
+    } else {
+        regions.push_back({level, x0, z0, width, depth, tx, tz});
+    }
+}
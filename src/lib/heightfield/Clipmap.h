@@ -0,0 +1,132 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "FractalNoise.h"
+
+using std::shared_ptr;
+using std::vector;
+
+/**
+  * The heights of a geometry clipmap: a stack of square windows onto a
+  * FractalNoise field, one per level, that follow the camera. Level l has
+  * samples 2^l apart, so every level covers twice the ground of the one
+  * below at the same cost, and the amount of samples does not depend on
+  * how big the field is.
+  *
+  * Each level has a tile of getTextureSize() squared samples that it
+  * stores its window in toroidally: the sample at x, z, counted in the
+  * level's spacing from the origin of the field, lives at texel
+  * x mod getTextureSize(), z mod getTextureSize() of the tile. When the
+  * camera moves, the samples that stay in a window stay where they are,
+  * and only the rows and columns that scrolled in have to be written.
+  *
+  * Windows snap to twice their spacing, so that each one lines up with
+  * the grid of the level above, and sits in the middle of the level above
+  * give or take one of that level's quads. Based on Losasso and Hoppe,
+  * "Geometry Clipmaps", and Asirvatham and Hoppe, "Terrain Rendering
+  * Using GPU-Based Geometry Clipmaps".
+  */
+class Clipmap {
+public:
+    /**
+      * A rectangle of samples of one level to write, that lands in its
+      * tile without wrapping around.
+      */
+    struct Region {
+        /** The level. */
+        unsigned level;
+        /** First sample along x, in the level's spacing. */
+        int x0;
+        /** First sample along z, in the level's spacing. */
+        int z0;
+        /** Amount of samples per row. */
+        unsigned width;
+        /** Amount of rows. */
+        unsigned depth;
+        /** Texel of the tile the first sample goes to along x. */
+        unsigned textureX;
+        /** Texel of the tile the first sample goes to along z. */
+        unsigned textureZ;
+    };
+
+    /**
+      * Constructor. The windows are placed by the first move().
+      *
+      * @param noise The field.
+      * @param heightScale Height of a sample of 1 from the field.
+      * @param levelCount Amount of levels.
+      * @param size Quads along each side of a window, a multiple of 4.
+      */
+    Clipmap(shared_ptr<const FractalNoise> noise, float heightScale,
+            unsigned levelCount, unsigned size);
+
+    /**
+      * Centre the windows on a position, and get what they need written.
+      *
+      * @param x World x to centre on.
+      * @param z World z to centre on.
+      * @return Regions that scrolled into the windows, or the whole
+      *         windows the first time.
+      */
+    vector<Region> move(float x, float z);
+
+    /**
+      * Write the heights of a region.
+      *
+      * @param dst Receives region.width * region.depth heights, row after
+      *            row.
+      * @param region Region to write, from move().
+      */
+    void writeRegion(float* dst, const Region& region) const;
+
+    /**
+      * Get the amount of levels.
+      */
+    unsigned getLevelCount() const;
+
+    /**
+      * Get the amount of quads along each side of a window.
+      */
+    unsigned getSize() const;
+
+    /**
+      * Get the amount of samples along each side of a tile, one more
+      * than getSize().
+      */
+    unsigned getTextureSize() const;
+
+    /**
+      * Get the first sample along x of a level's window, in the level's
+      * spacing.
+      */
+    int getOriginX(unsigned level) const;
+
+    /**
+      * Get the first sample along z of a level's window, in the level's
+      * spacing.
+      */
+    int getOriginZ(unsigned level) const;
+
+private:
+    /**
+      * Add a rectangle of a level to regions, split where it wraps around
+      * the tile.
+      */
+    void addRegions(unsigned level, int x0, int z0, unsigned width,
+                    unsigned depth, vector<Region>& regions) const;
+
+    /** The field. */
+    shared_ptr<const FractalNoise> _noise;
+    /** Height of a sample of 1. */
+    float _heightScale;
+    /** Quads along each side of a window. */
+    unsigned _size;
+    /** First sample of each window along x. */
+    vector<int> _originX;
+    /** First sample of each window along z. */
+    vector<int> _originZ;
+    /** Whether the windows have been placed yet. */
+    bool _placed;
+};
@@ -0,0 +1,341 @@
+#include "Erosion.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+
+#include "../Simd.h"
+#include "../ThreadPool.h"
+
+using std::min;
+using std::runtime_error;
+using std::swap;
+
+/** Rows handed to a worker at once. */
+static const size_t BAND_ROWS = 16;
+/** Shallowest water velocities are worked out for, thinner films would
+  * make them blow up. */
+static const float WATER_EPSILON = 1e-3f;
+/** Offset of each lane from the first cell of a block. */
+static const float LANES[8] = {0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f};
+
+/** Indices of the four pipes out of a cell. */
+enum Pipe {
+    LEFT = 0,
+    RIGHT = 1,
+    UP = 2,
+    DOWN = 3,
+};
+
+/**
+  * Call step(i, x, z) for every block of SIMD_WIDTH cells of the grid
+  * across the shared pool, where i is the index of the block's first cell
+  * in the bordered grid. The last block of a row is moved back to end the
+  * row, so steps must not read what they write.
+  */
+template <typename Step>
+static void
+sweep(unsigned width, unsigned depth, unsigned stride, const Step& step) {
+    ThreadPool::shared().parallelFor(
+        depth, BAND_ROWS,
+        [&](size_t z0, size_t z1) {
+            for (size_t z = z0; z < z1; z++) {
+                for (unsigned x = 0; x < width; x += SIMD_WIDTH) {
+                    const unsigned start = min(x, width - SIMD_WIDTH);
+                    step((z + 1) * stride + start + 1, start,
+                         static_cast<unsigned>(z));
+                }
+            }
+        }
+    );
+}
+
+/**
+  * Get the amount by which a height difference exceeds the talus, or zero.
+  */
+static simd_float
+getExcess(simd_float difference, simd_float talus) {
+    return simd_max(simd_sub(difference, talus), simd_zero());
+}
+
+Erosion::
+Erosion(const float* heights, unsigned width, unsigned depth,
+        const ErosionParameters& parameters) :
+        _width(width),
+        _depth(depth),
+        _stride(width + 2),
+        _parameters(parameters) {
+    if ((width < SIMD_WIDTH) || (width < 2) || (depth < 2)) {
+        throw runtime_error("Height grid is too small to erode.");
+    }
+    const size_t size = static_cast<size_t>(_stride) * (depth + 2);
+    for (unsigned copy = 0; copy < 2; copy++) {
+        _ground[copy].assign(size, 0.f);
+        _water[copy].assign(size, 0.f);
+        _sediment[copy].assign(size, 0.f);
+        for (auto& flux: _flux[copy]) {
+            flux.assign(size, 0.f);
+        }
+    }
+    _velocityX.assign(size, 0.f);
+    _velocityZ.assign(size, 0.f);
+    for (unsigned z = 0; z < depth; z++) {
+        std::copy(heights + static_cast<size_t>(z) * width,
+                  heights + static_cast<size_t>(z + 1) * width,
+                  _ground[0].begin() + (z + 1) * _stride + 1);
+    }
+}
+
+void Erosion::
+runHydraulic(unsigned iterations) {
+    const ErosionParameters& p = _parameters;
+    const simd_float zero = simd_zero();
+    const simd_float half = simd_set1(0.5f);
+    const simd_float one = simd_set1(1.f);
+    const simd_float dt = simd_set1(p.timeStep);
+    const simd_float pressure = simd_set1(p.timeStep * p.gravity);
+    const simd_float epsilon = simd_set1(WATER_EPSILON);
+    const simd_float rain = simd_set1(p.rain * p.timeStep);
+    const simd_float dryness =
+        simd_set1(std::max(0.f, 1.f - p.evaporation * p.timeStep));
+    const simd_float capacity = simd_set1(p.capacity);
+    const simd_float dissolving = simd_set1(p.dissolving * p.timeStep);
+    const simd_float deposition = simd_set1(p.deposition * p.timeStep);
+    const simd_float deepest = simd_set1(p.carryingDepth);
+    const simd_float inertia = simd_set1(p.inertia);
+    const simd_float minimumTilt = simd_set1(p.minimumTilt);
+    const simd_float maxX = simd_set1(static_cast<float>(_width - 1));
+    const simd_float maxZ = simd_set1(static_cast<float>(_depth - 1));
+    const simd_float lastColumn = simd_set1(static_cast<float>(_width - 2));
+    const simd_float lastRow = simd_set1(static_cast<float>(_depth - 2));
+    const int32_t stride = static_cast<int32_t>(_stride);
+    const simd_float fastest = simd_set1(1.f / p.timeStep);
+    const simd_float slowest = simd_set1(-1.f / p.timeStep);
+    const ptrdiff_t up = -static_cast<ptrdiff_t>(_stride);
+    const ptrdiff_t down = _stride;
+    const ptrdiff_t offsets[4] = {-1, 1, up, down};
+
+    for (unsigned iteration = 0; iteration < iterations; iteration++) {
+        /* NOTE(jan): Pipes accelerate with the difference in water level,
+         * and are scaled down together where they would drain more water
+         * than the cell holds. */
+        fillBorder(_ground[0]);
+        fillBorder(_water[0]);
+        sweep(_width, _depth, _stride, [&](size_t i, unsigned, unsigned) {
+            const float* b = _ground[0].data() + i;
+            const float* d = _water[0].data() + i;
+            const simd_float level = simd_add(simd_load(b), simd_load(d));
+            simd_float outflow[4];
+            simd_float total = zero;
+            for (unsigned pipe = 0; pipe < 4; pipe++) {
+                const ptrdiff_t o = offsets[pipe];
+                const simd_float drop = simd_sub(
+                    level, simd_add(simd_load(b + o), simd_load(d + o))
+                );
+                const simd_float kept =
+                    simd_mul(simd_load(_flux[0][pipe].data() + i), inertia);
+                outflow[pipe] = simd_max(simd_madd(drop, pressure, kept), zero);
+                total = simd_add(total, outflow[pipe]);
+            }
+            const simd_float scale = simd_min(
+                one,
+                simd_div(simd_load(d),
+                         simd_max(simd_mul(total, dt), simd_set1(1e-12f)))
+            );
+            for (unsigned pipe = 0; pipe < 4; pipe++) {
+                simd_store(_flux[1][pipe].data() + i,
+                           simd_mul(outflow[pipe], scale));
+            }
+        });
+        for (unsigned pipe = 0; pipe < 4; pipe++) {
+            swap(_flux[0][pipe], _flux[1][pipe]);
+        }
+
+        /* NOTE(jan): The border's pipes stay empty, so nothing flows in
+         * from outside the grid. */
+        sweep(_width, _depth, _stride, [&](size_t i, unsigned, unsigned) {
+            const float* left = _flux[0][LEFT].data() + i;
+            const float* right = _flux[0][RIGHT].data() + i;
+            const float* upper = _flux[0][UP].data() + i;
+            const float* lower = _flux[0][DOWN].data() + i;
+            const simd_float inflow = simd_add(
+                simd_add(simd_load(right - 1), simd_load(left + 1)),
+                simd_add(simd_load(lower + up), simd_load(upper + down))
+            );
+            const simd_float outflow = simd_add(
+                simd_add(simd_load(left), simd_load(right)),
+                simd_add(simd_load(upper), simd_load(lower))
+            );
+            const simd_float water = simd_load(_water[0].data() + i);
+            const simd_float flowed = simd_max(
+                simd_madd(simd_sub(inflow, outflow), dt, water), zero
+            );
+            const simd_float mean =
+                simd_max(simd_mul(simd_add(water, flowed), half), epsilon);
+            const simd_float throughX = simd_mul(half, simd_add(
+                simd_sub(simd_load(right - 1), simd_load(left)),
+                simd_sub(simd_load(right), simd_load(left + 1))
+            ));
+            const simd_float throughZ = simd_mul(half, simd_add(
+                simd_sub(simd_load(lower + up), simd_load(upper)),
+                simd_sub(simd_load(lower), simd_load(upper + down))
+            ));
+            /* NOTE(jan): Thin films of water would move impossibly fast, so
+             * sediment is kept from travelling more than a cell per
+             * iteration. */
+            simd_store(_velocityX.data() + i, simd_min(simd_max(
+                simd_div(throughX, mean), slowest
+            ), fastest));
+            simd_store(_velocityZ.data() + i, simd_min(simd_max(
+                simd_div(throughZ, mean), slowest
+            ), fastest));
+            simd_store(_water[1].data() + i,
+                       simd_mul(simd_add(flowed, rain), dryness));
+        });
+        swap(_water[0], _water[1]);
+
+        /* NOTE(jan): Water carries more sediment the faster it flows down
+         * steeper ground. Below that capacity it dissolves ground, above
+         * it sediment settles. The slope is taken from the differences to
+         * each neighbour rather than across the cell, which would miss
+         * ripples a cell wide and let them grow. */
+        sweep(_width, _depth, _stride, [&](size_t i, unsigned, unsigned) {
+            const float* b = _ground[0].data() + i;
+            const simd_float height = simd_load(b);
+            simd_float slope = zero;
+            for (const ptrdiff_t o: offsets) {
+                const simd_float step = simd_sub(simd_load(b + o), height);
+                slope = simd_madd(step, step, slope);
+            }
+            slope = simd_mul(slope, half);
+            const simd_float tilt = simd_max(
+                simd_sqrt(simd_div(slope, simd_add(one, slope))), minimumTilt
+            );
+            const simd_float u = simd_load(_velocityX.data() + i);
+            const simd_float v = simd_load(_velocityZ.data() + i);
+            const simd_float flow = simd_mul(
+                simd_sqrt(simd_madd(u, u, simd_mul(v, v))),
+                simd_min(simd_load(_water[0].data() + i), deepest)
+            );
+            const simd_float carried = simd_load(_sediment[0].data() + i);
+            const simd_float room = simd_sub(
+                simd_mul(simd_mul(capacity, tilt), flow), carried
+            );
+            const simd_float change = simd_sub(
+                simd_mul(simd_max(room, zero), dissolving),
+                simd_mul(simd_max(simd_sub(zero, room), zero), deposition)
+            );
+            simd_store(_ground[1].data() + i, simd_sub(simd_load(b), change));
+            simd_store(_sediment[1].data() + i, simd_add(carried, change));
+        });
+        swap(_ground[0], _ground[1]);
+
+        /* NOTE(jan): Sediment is carried along by looking upstream for
+         * where it came from and interpolating there. */
+        sweep(_width, _depth, _stride, [&](size_t i, unsigned x, unsigned z) {
+            const simd_float cellX =
+                simd_add(simd_set1(static_cast<float>(x)), simd_load(LANES));
+            const simd_float cellZ = simd_set1(static_cast<float>(z));
+            const simd_float fromX = simd_min(simd_max(
+                simd_sub(cellX, simd_mul(simd_load(_velocityX.data() + i),
+                                         dt)),
+                zero
+            ), maxX);
+            const simd_float fromZ = simd_min(simd_max(
+                simd_sub(cellZ, simd_mul(simd_load(_velocityZ.data() + i),
+                                         dt)),
+                zero
+            ), maxZ);
+            const simd_float column = simd_min(simd_floor(fromX), lastColumn);
+            const simd_float row = simd_min(simd_floor(fromZ), lastRow);
+            const simd_float tx = simd_sub(fromX, column);
+            const simd_float tz = simd_sub(fromZ, row);
+
+            /* NOTE(jan): Indices are put together in integers, floats
+             * skip whole cells past 2^24 of them. */
+            int32_t columns[SIMD_WIDTH];
+            int32_t rows[SIMD_WIDTH];
+            int32_t corners[SIMD_WIDTH];
+            simd_store_int(columns, column);
+            simd_store_int(rows, row);
+            for (unsigned k = 0; k < SIMD_WIDTH; k++) {
+                corners[k] = (rows[k] + 1) * stride + columns[k] + 1;
+            }
+            const float* s = _sediment[1].data();
+            const simd_float s00 = simd_gather(s, corners);
+            const simd_float s10 = simd_gather(s + 1, corners);
+            const simd_float s01 = simd_gather(s + _stride, corners);
+            const simd_float s11 = simd_gather(s + _stride + 1, corners);
+            const simd_float front = simd_madd(tx, simd_sub(s10, s00), s00);
+            const simd_float back = simd_madd(tx, simd_sub(s11, s01), s01);
+            simd_store(_sediment[0].data() + i,
+                       simd_madd(tz, simd_sub(back, front), front));
+        });
+    }
+}
+
+void Erosion::
+runThermal(unsigned iterations) {
+    const simd_float talus = simd_set1(_parameters.talus);
+    const simd_float rate =
+        simd_set1(min(_parameters.thermalRate, 0.25f));
+    const ptrdiff_t offsets[4] = {
+        -1, 1, -static_cast<ptrdiff_t>(_stride), _stride
+    };
+    for (unsigned iteration = 0; iteration < iterations; iteration++) {
+        /* NOTE(jan): Each pair of neighbours trades the same amount in
+         * opposite directions, so no material is lost. */
+        fillBorder(_ground[0]);
+        sweep(_width, _depth, _stride, [&](size_t i, unsigned, unsigned) {
+            const float* b = _ground[0].data() + i;
+            const simd_float height = simd_load(b);
+            simd_float gain = simd_zero();
+            for (const ptrdiff_t o: offsets) {
+                const simd_float difference =
+                    simd_sub(simd_load(b + o), height);
+                gain = simd_add(gain, simd_sub(
+                    getExcess(difference, talus),
+                    getExcess(simd_sub(simd_zero(), difference), talus)
+                ));
+            }
+            simd_store(_ground[1].data() + i, simd_madd(gain, rate, height));
+        });
+        swap(_ground[0], _ground[1]);
+    }
+}
+
+void Erosion::
+writeHeights(float* dst) const {
+    for (unsigned z = 0; z < _depth; z++) {
+        const size_t row = (z + 1) * static_cast<size_t>(_stride) + 1;
+        for (unsigned x = 0; x < _width; x++) {
+            *dst++ = _ground[0][row + x] + _sediment[0][row + x];
+        }
+    }
+}
+
+double Erosion::
+getWater() const {
+    double total = 0.0;
+    for (unsigned z = 0; z < _depth; z++) {
+        const size_t row = (z + 1) * static_cast<size_t>(_stride) + 1;
+        for (unsigned x = 0; x < _width; x++) {
+            total += _water[0][row + x];
+        }
+    }
+    return total;
+}
+
+void Erosion::
+fillBorder(vector<float>& grid) const {
+    const size_t last = static_cast<size_t>(_depth + 1) * _stride;
+    std::copy(grid.begin() + _stride, grid.begin() + 2 * _stride,
+              grid.begin());
+    std::copy(grid.begin() + last - _stride, grid.begin() + last,
+              grid.begin() + last);
+    for (unsigned z = 0; z < _depth + 2; z++) {
+        float* row = grid.data() + static_cast<size_t>(z) * _stride;
+        row[0] = row[1];
+        row[_width + 1] = row[_width];
+    }
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <vector>
+
+using std::vector;
+
+/**
+  * Rates and thresholds of an Erosion, in cells and simulation seconds.
+  */
+struct ErosionParameters {
+    /** Simulated time per iteration. */
+    float timeStep = 0.02f;
+    /** Water rained onto every cell per unit of time. */
+    float rain = 0.02f;
+    /** Gravity, drives the water down slopes. */
+    float gravity = 9.81f;
+    /** Share of its flow a pipe keeps from one iteration to the next. Less
+      * than 1 damps water sloshing to and fro on flat ground. */
+    float inertia = 0.5f;
+    /** Sediment a unit of water depth carries per unit of speed and
+      * slope. */
+    float capacity = 4.f;
+    /** Depth beyond which water carries no more sediment, so that pools
+      * do not dig themselves deeper. */
+    float carryingDepth = 0.05f;
+    /** Rate at which ground is dissolved while water carries less than
+      * it could. */
+    float dissolving = 0.5f;
+    /** Rate at which sediment settles while water carries more than it
+      * can. */
+    float deposition = 1.f;
+    /** Share of the water that evaporates per unit of time. */
+    float evaporation = 0.015f;
+    /** Sine of the slope flat ground is treated as having, so that still
+      * water on it keeps some capacity. */
+    float minimumTilt = 0.05f;
+    /** Steepest height difference between neighbours that thermal
+      * erosion leaves standing. */
+    float talus = 0.8f;
+    /** Share of the difference beyond talus that slides down per thermal
+      * iteration. At most 0.25. */
+    float thermalRate = 0.2f;
+};
+
+/**
+  * Erodes a grid of heights, one cell per sample.
+  *
+  * Hydraulic erosion follows the virtual pipe model: rain fills the cells,
+  * water flows to neighbours through pipes driven by the difference in
+  * water level, and flowing water dissolves ground or drops sediment
+  * depending on how much its speed and the slope let it carry. Sediment
+  * drifts with the water and evaporation slowly drains it. Thermal erosion
+  * slides material down wherever neighbours differ by more than the talus
+  * height.
+  *
+  * Every step only reads the state left by the one before and writes to a
+  * second copy, so each step is a sweep over rows split across the shared
+  * pool and run SIMD_WIDTH cells at a time. Results do not depend on the
+  * amount of threads.
+  */
+class Erosion {
+public:
+    /**
+      * Constructor, starts from dry ground.
+      *
+      * @param heights Row-major heights to erode.
+      * @param width Amount of samples per row, at least SIMD_WIDTH and 2.
+      * @param depth Amount of rows, at least 2.
+      * @param parameters Rates and thresholds.
+      */
+    Erosion(const float* heights, unsigned width, unsigned depth,
+            const ErosionParameters& parameters = ErosionParameters());
+
+    /**
+      * Run iterations of hydraulic erosion.
+      */
+    void runHydraulic(unsigned iterations);
+
+    /**
+      * Run iterations of thermal erosion.
+      */
+    void runThermal(unsigned iterations);
+
+    /**
+      * Write the eroded heights, with the sediment still in the water
+      * settled where it is.
+      *
+      * @param dst Receives width * depth heights, row after row.
+      */
+    void writeHeights(float* dst) const;
+
+    /**
+      * Get the amount of water on the ground in total.
+      */
+    double getWater() const;
+
+private:
+    /**
+      * Copy the outermost cells of a grid into the border around it, so
+      * that the edges neither lose nor gain anything to the outside.
+      */
+    void fillBorder(vector<float>& grid) const;
+
+    /** Amount of samples per row. */
+    unsigned _width;
+    /** Amount of rows. */
+    unsigned _depth;
+    /** Samples per row including a border cell on either side. */
+    unsigned _stride;
+    /** Rates and thresholds. */
+    ErosionParameters _parameters;
+    /** Ground height, and the copy the next step writes. */
+    vector<float> _ground[2];
+    /** Water height. */
+    vector<float> _water[2];
+    /** Dissolved sediment. */
+    vector<float> _sediment[2];
+    /** Outflow through the left, right, up and down pipes of each cell. */
+    vector<float> _flux[2][4];
+    /** Velocity of the water along x. */
+    vector<float> _velocityX;
+    /** Velocity of the water along z. */
+    vector<float> _velocityZ;
+};
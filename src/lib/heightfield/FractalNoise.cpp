@@ -0,0 +1,212 @@
+#include "FractalNoise.h"
+
+#include <algorithm>
+#include <random>
+
+#include "../Hash.h"
+
+using std::min;
+
+/** Period of the lattice, in cells. */
+static const float PERIOD = 256.f;
+/** Scales the normalized sum, which rarely strays beyond +-0.4, to about
+  * [-0.5, 0.5]. */
+static const float CONTRAST = 1.2f;
+/** Gradients a lattice point can have, spread evenly around the circle. */
+static const float GRADIENTS[8][2] = {
+    {1.f, 0.f}, {0.70710678f, 0.70710678f},
+    {0.f, 1.f}, {-0.70710678f, 0.70710678f},
+    {-1.f, 0.f}, {-0.70710678f, -0.70710678f},
+    {0.f, -1.f}, {0.70710678f, -0.70710678f},
+};
+
+FractalNoise::
+FractalNoise(uint32_t seed, const FractalParameters& parameters) :
+        _seed(seed),
+        _parameters(parameters),
+        _permutation(TABLE_SIZE),
+        _gradientX(TABLE_SIZE),
+        _gradientZ(TABLE_SIZE) {
+    /* NOTE(jan): The engine's output is fixed by the standard, unlike the
+     * distributions and std::shuffle, so draws are taken from it directly
+     * to keep the field the same everywhere. */
+    std::mt19937 random(seed);
+    const unsigned period = static_cast<unsigned>(PERIOD);
+    vector<unsigned> permutation(period);
+    for (unsigned i = 0; i < period; i++) {
+        permutation[i] = i;
+    }
+    for (unsigned i = period - 1; i > 0; i--) {
+        std::swap(permutation[i], permutation[random() % (i + 1)]);
+    }
+    for (unsigned i = 0; i < TABLE_SIZE; i++) {
+        const unsigned p = permutation[i % period];
+        _permutation[i] = static_cast<float>(p);
+        /* NOTE(jan): A second shuffle picks the gradients, so that they
+         * are not correlated with the columns. */
+        const unsigned g = permutation[(p * 7 + 3) % period] & 7;
+        _gradientX[i] = GRADIENTS[g][0];
+        _gradientZ[i] = GRADIENTS[g][1];
+    }
+
+    const unsigned octaves =
+        parameters.octaves + 2 * parameters.warpOctaves;
+    _offsets.resize(octaves * 2);
+    for (float& offset: _offsets) {
+        offset = static_cast<float>(random() % 65536) / 256.f;
+    }
+}
+
+uint32_t FractalNoise::
+getSeed() const {
+    return _seed;
+}
+
+const FractalParameters& FractalNoise::
+getParameters() const {
+    return _parameters;
+}
+
+uint64_t FractalNoise::
+hash(uint64_t seed) const {
+    uint64_t hash = hashValue(_seed, seed);
+    hash = hashValue(_parameters.octaves, hash);
+    hash = hashValue(_parameters.frequency, hash);
+    hash = hashValue(_parameters.lacunarity, hash);
+    hash = hashValue(_parameters.gain, hash);
+    hash = hashValue(_parameters.warpOctaves, hash);
+    hash = hashValue(_parameters.warpFrequency, hash);
+    hash = hashValue(_parameters.warpAmount, hash);
+    return hashValue(CONTRAST, hash);
+}
+
+void FractalNoise::
+evaluate(int x0, int z0, unsigned width, unsigned depth, float* out,
+         unsigned step) const {
+    const int stride = static_cast<int>(step);
+    float xs[SIMD_WIDTH];
+    float block[SIMD_WIDTH];
+    for (unsigned z = 0; z < depth; z++) {
+        const simd_float zs =
+            simd_set1(static_cast<float>(z0 + int(z) * stride));
+        float* row = out + static_cast<size_t>(z) * width;
+        /* NOTE(jan): A short last block is moved back to end the row,
+         * evaluating a few samples twice rather than falling back to
+         * scalar code. */
+        for (unsigned x = 0; x < width; x += SIMD_WIDTH) {
+            const unsigned start = (x + SIMD_WIDTH > width) &&
+                                   (width >= SIMD_WIDTH)
+                ? width - SIMD_WIDTH
+                : x;
+            for (unsigned i = 0; i < SIMD_WIDTH; i++) {
+                xs[i] = static_cast<float>(x0 + int(start + i) * stride);
+            }
+            simd_store(block, evaluateBlock(simd_load(xs), zs));
+            const unsigned end = min(start + SIMD_WIDTH, width);
+            std::copy(block + (x - start), block + (end - start), row + x);
+        }
+    }
+}
+
+simd_float FractalNoise::
+evaluateBlock(simd_float x, simd_float z) const {
+    const FractalParameters& p = _parameters;
+    if ((p.warpAmount != 0.f) && (p.warpOctaves > 0)) {
+        const float* offsets = _offsets.data() + 2 * p.octaves;
+        const simd_float warpX = sumOctaves(
+            x, z, p.warpOctaves, p.warpFrequency, offsets
+        );
+        const simd_float warpZ = sumOctaves(
+            x, z, p.warpOctaves, p.warpFrequency,
+            offsets + 2 * p.warpOctaves
+        );
+        const simd_float amount = simd_set1(p.warpAmount);
+        x = simd_madd(warpX, amount, x);
+        z = simd_madd(warpZ, amount, z);
+    }
+    const simd_float sum = sumOctaves(
+        x, z, p.octaves, p.frequency, _offsets.data()
+    );
+    const simd_float height =
+        simd_madd(sum, simd_set1(CONTRAST), simd_set1(0.5f));
+    return simd_min(simd_max(height, simd_zero()), simd_set1(1.f));
+}
+
+simd_float FractalNoise::
+sumOctaves(simd_float x, simd_float z, unsigned octaves, float frequency,
+           const float* offsets) const {
+    simd_float sum = simd_zero();
+    float amplitude = 1.f;
+    float total = 0.f;
+    for (unsigned octave = 0; octave < octaves; octave++) {
+        const simd_float scale = simd_set1(frequency);
+        const simd_float noise = gradientNoise(
+            simd_madd(x, scale, simd_set1(offsets[octave * 2])),
+            simd_madd(z, scale, simd_set1(offsets[octave * 2 + 1]))
+        );
+        sum = simd_madd(noise, simd_set1(amplitude), sum);
+        total += amplitude;
+        amplitude *= _parameters.gain;
+        frequency *= _parameters.lacunarity;
+    }
+    return total > 0.f ? simd_mul(sum, simd_set1(1.f / total)) : sum;
+}
+
+simd_float FractalNoise::
+gradientNoise(simd_float x, simd_float z) const {
+    const simd_float one = simd_set1(1.f);
+    const simd_float period = simd_set1(PERIOD);
+    const simd_float inversePeriod = simd_set1(1.f / PERIOD);
+
+    /* NOTE(jan): Lattice coordinates stay in floats, wrapped into the
+     * period. They are whole numbers well below 2^24, so the arithmetic on
+     * them is exact. */
+    const simd_float cellX = simd_floor(x);
+    const simd_float cellZ = simd_floor(z);
+    const simd_float tx = simd_sub(x, cellX);
+    const simd_float tz = simd_sub(z, cellZ);
+    const simd_float ix = simd_sub(
+        cellX, simd_mul(simd_floor(simd_mul(cellX, inversePeriod)), period)
+    );
+    const simd_float iz = simd_sub(
+        cellZ, simd_mul(simd_floor(simd_mul(cellZ, inversePeriod)), period)
+    );
+
+    int32_t indices[SIMD_WIDTH];
+    simd_store_int(indices, ix);
+    const simd_float columnA = simd_gather(_permutation.data(), indices);
+    simd_store_int(indices, simd_add(ix, one));
+    const simd_float columnB = simd_gather(_permutation.data(), indices);
+
+    /* NOTE(jan): Dot product of a corner's gradient with the offset from
+     * the corner to the point. */
+    auto corner = [&](simd_float column, simd_float dx, simd_float dz) {
+        simd_store_int(indices, column);
+        const simd_float gx = simd_gather(_gradientX.data(), indices);
+        const simd_float gz = simd_gather(_gradientZ.data(), indices);
+        return simd_madd(gx, dx, simd_mul(gz, dz));
+    };
+    const simd_float rowA = simd_add(columnA, iz);
+    const simd_float rowB = simd_add(columnB, iz);
+    const simd_float sx = simd_sub(tx, one);
+    const simd_float sz = simd_sub(tz, one);
+    const simd_float n00 = corner(rowA, tx, tz);
+    const simd_float n01 = corner(simd_add(rowA, one), tx, sz);
+    const simd_float n10 = corner(rowB, sx, tz);
+    const simd_float n11 = corner(simd_add(rowB, one), sx, sz);
+
+    /* NOTE(jan): Quintic fade, 6t^5 - 15t^4 + 10t^3, so that the heights
+     * are smooth up to the second derivative across cells. */
+    auto fade = [&](simd_float t) {
+        const simd_float inner = simd_madd(
+            t, simd_madd(t, simd_set1(6.f), simd_set1(-15.f)),
+            simd_set1(10.f)
+        );
+        return simd_mul(simd_mul(simd_mul(t, t), t), inner);
+    };
+    const simd_float u = fade(tx);
+    const simd_float v = fade(tz);
+    const simd_float front = simd_madd(u, simd_sub(n10, n00), n00);
+    const simd_float back = simd_madd(u, simd_sub(n11, n01), n01);
+    return simd_madd(v, simd_sub(back, front), front);
+}
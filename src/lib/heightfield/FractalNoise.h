@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "../Simd.h"
+
+using std::vector;
+
+/**
+  * Shape of the noise summed by FractalNoise.
+  */
+struct FractalParameters {
+    /** Octaves of noise summed into the heights. */
+    unsigned octaves = 7;
+    /** Lattice cells per sample of the first octave. */
+    float frequency = 1.f / 256.f;
+    /** Frequency multiplier from one octave to the next. */
+    float lacunarity = 2.f;
+    /** Amplitude multiplier from one octave to the next. */
+    float gain = 0.5f;
+    /** Octaves of the noise that warps the domain. */
+    unsigned warpOctaves = 3;
+    /** Lattice cells per sample of the first warp octave. */
+    float warpFrequency = 1.f / 512.f;
+    /** Furthest the domain is pushed, in samples. Zero turns warping off. */
+    float warpAmount = 64.f;
+};
+
+/**
+  * An endless field of heights, fractal Brownian motion over gradient
+  * noise with its domain warped by more of the same.
+  *
+  * Samples lie on the integer grid of world coordinates and each one only
+  * depends on its own coordinates and the seed, so any rectangle can be
+  * evaluated on its own and agrees exactly with its neighbours. Rows are
+  * evaluated SIMD_WIDTH samples at a time, looking the lattice up in
+  * small seeded tables, and the same seed gives the same heights on every
+  * run. The lattice repeats every 256 cells of each octave, which for the
+  * default frequency is 65536 samples.
+  */
+class FractalNoise {
+public:
+    /**
+      * Constructor.
+      *
+      * @param seed Picks the field.
+      * @param parameters Shape of the noise.
+      */
+    explicit FractalNoise(uint32_t seed,
+                          const FractalParameters& parameters =
+                              FractalParameters());
+
+    /**
+      * Get the seed the field was made with.
+      */
+    uint32_t getSeed() const;
+
+    /**
+      * Get the shape of the noise.
+      */
+    const FractalParameters& getParameters() const;
+
+    /**
+      * Hash the seed and parameters.
+      *
+      * @param seed Hash to continue from.
+      */
+    uint64_t hash(uint64_t seed) const;
+
+    /**
+      * Evaluate a rectangle of samples. Heights are in [0, 1]. Safe to
+      * call from many threads at once.
+      *
+      * @param x0 World x of the first sample of each row.
+      * @param z0 World z of the first row.
+      * @param width Amount of samples per row.
+      * @param depth Amount of rows.
+      * @param out Receives width * depth heights, row after row.
+      * @param step World distance between neighbouring samples, for
+      *             coarser views of the field.
+      */
+    void evaluate(int x0, int z0, unsigned width, unsigned depth,
+                  float* out, unsigned step = 1) const;
+
+private:
+    /** Size of the lattice tables, twice the period so that a cell's
+      * corners never have to wrap. */
+    static constexpr unsigned TABLE_SIZE = 512;
+
+    /**
+      * Sum octaves of gradient noise at SIMD_WIDTH points.
+      *
+      * @param offsets Lattice offset of each octave, x then z.
+      * @return The sum, normalized by the total amplitude.
+      */
+    simd_float sumOctaves(simd_float x, simd_float z, unsigned octaves,
+                          float frequency, const float* offsets) const;
+
+    /**
+      * Evaluate gradient noise at SIMD_WIDTH points in lattice coordinates.
+      */
+    simd_float gradientNoise(simd_float x, simd_float z) const;
+
+    /**
+      * Evaluate SIMD_WIDTH samples at world coordinates.
+      */
+    simd_float evaluateBlock(simd_float x, simd_float z) const;
+
+    /** The seed. */
+    uint32_t _seed;
+    /** Shape of the noise. */
+    FractalParameters _parameters;
+    /** Seeded permutation of the lattice columns, repeated once, stored
+      * as floats so that indices can be added up in vector registers. */
+    vector<float> _permutation;
+    /** Gradient x of each lattice point, indexed by the column's
+      * permutation plus the row. */
+    vector<float> _gradientX;
+    /** Gradient z of each lattice point, indexed like _gradientX. */
+    vector<float> _gradientZ;
+    /** Lattice offsets of the height octaves, then of the x and the z warp
+      * octaves, two floats each. */
+    vector<float> _offsets;
+};
@@ -0,0 +1,307 @@
+#include "HeightFilter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "../Simd.h"
+
+using std::min;
+
+/** How many rows the box filter's vertical running sums may drift over. */
+static const unsigned BOX_RESEED_INTERVAL = 64;
+
+Kernel::
+Kernel() :
+        _weights(1, 1.f) {}
+
+Kernel::
+Kernel(vector<float> weights) :
+        _weights(std::move(weights)) {}
+
+Kernel Kernel::
+box(unsigned radius) {
+    const unsigned taps = 2 * radius + 1;
+    return Kernel(vector<float>(taps, 1.f / taps));
+}
+
+Kernel Kernel::
+gaussian(float sigma, unsigned radius) {
+    if (radius == 0) {
+        radius = static_cast<unsigned>(std::ceil(3.f * sigma));
+    }
+    vector<float> weights(2 * radius + 1);
+    float total = 0.f;
+    for (unsigned i = 0; i < weights.size(); i++) {
+        const float d = static_cast<float>(i) - radius;
+        weights[i] = std::exp(-(d * d) / (2.f * sigma * sigma));
+        total += weights[i];
+    }
+    for (float& weight: weights) {
+        weight /= total;
+    }
+    return Kernel(weights);
+}
+
+Kernel Kernel::
+convolve(const Kernel& rhs) const {
+    vector<float> weights(_weights.size() + rhs._weights.size() - 1, 0.f);
+    for (size_t i = 0; i < _weights.size(); i++) {
+        for (size_t j = 0; j < rhs._weights.size(); j++) {
+            weights[i + j] += _weights[i] * rhs._weights[j];
+        }
+    }
+    return Kernel(weights);
+}
+
+Kernel Kernel::
+repeat(unsigned count) const {
+    Kernel result;
+    for (unsigned i = 0; i < count; i++) {
+        result = result.convolve(*this);
+    }
+    return result;
+}
+
+unsigned Kernel::
+getRadius() const {
+    return static_cast<unsigned>(_weights.size() / 2);
+}
+
+const float* Kernel::
+getWeights() const {
+    return _weights.data();
+}
+
+HeightFilter::
+HeightFilter(unsigned width, unsigned depth) :
+        _width(width),
+        _depth(depth) {}
+
+void HeightFilter::
+convolve(const float* src, float* dst, const Kernel& kernel) {
+    convolve(src, dst, kernel, 0, _depth);
+}
+
+void HeightFilter::
+convolve(const float* src, float* dst, const Kernel& kernel,
+         unsigned z0, unsigned z1) {
+    convolve(src, dst, kernel, 0, z0, _width, z1);
+}
+
+void HeightFilter::
+convolve(const float* src, float* dst, const Kernel& kernel,
+         unsigned x0, unsigned z0, unsigned x1, unsigned z1) {
+    const unsigned radius = kernel.getRadius();
+    const unsigned ringRows = 2 * radius + 1;
+    const unsigned span = x1 - x0;
+    const float* weights = kernel.getWeights();
+    _ring.resize(static_cast<size_t>(ringRows) * span);
+
+    auto ringRow = [&](unsigned row) {
+        return _ring.data() + static_cast<size_t>(row % ringRows) * span;
+    };
+    auto clampRow = [&](int row) {
+        return static_cast<unsigned>(
+            std::max(0, std::min(row, static_cast<int>(_depth) - 1))
+        );
+    };
+
+    vector<const float*> rows(ringRows);
+    unsigned loaded = z0 > radius ? z0 - radius : 0;
+    for (unsigned z = z0; z < z1; z++) {
+        const unsigned last = min(z + radius, _depth - 1);
+        for (; loaded <= last; loaded++) {
+            convolveRow(
+                src + static_cast<size_t>(loaded) * _width,
+                ringRow(loaded),
+                kernel, x0, x1
+            );
+        }
+        for (unsigned k = 0; k < ringRows; k++) {
+            rows[k] = ringRow(clampRow(static_cast<int>(z + k) - radius));
+        }
+
+        /* NOTE(jan): The kernel is symmetric, so pair up rows that share
+         * a weight. */
+        float* out = dst + static_cast<size_t>(z) * _width + x0;
+        unsigned x = 0;
+        for (; x + SIMD_WIDTH <= span; x += SIMD_WIDTH) {
+            simd_float acc = simd_mul(
+                simd_set1(weights[radius]), simd_load(rows[radius] + x)
+            );
+            for (unsigned k = 0; k < radius; k++) {
+                simd_float pair = simd_add(
+                    simd_load(rows[k] + x),
+                    simd_load(rows[ringRows - 1 - k] + x)
+                );
+                acc = simd_madd(simd_set1(weights[k]), pair, acc);
+            }
+            simd_store(out + x, acc);
+        }
+        for (; x < span; x++) {
+            float acc = weights[radius] * rows[radius][x];
+            for (unsigned k = 0; k < radius; k++) {
+                acc += weights[k] * (rows[k][x] + rows[ringRows - 1 - k][x]);
+            }
+            out[x] = acc;
+        }
+    }
+}
+
+void HeightFilter::
+convolveRow(const float* src, float* dst, const Kernel& kernel,
+            unsigned x0, unsigned x1) {
+    const int radius = static_cast<int>(kernel.getRadius());
+    const int width = static_cast<int>(_width);
+    const int span = static_cast<int>(x1 - x0);
+    const float* weights = kernel.getWeights();
+    _padded.resize(span + 2 * radius);
+    float* padded = _padded.data();
+
+    /* NOTE(jan): padded[0] holds sample x0 - radius. Whatever falls off
+     * either edge of the row is clamped to it. */
+    const int first = static_cast<int>(x0) - radius;
+    const int lo = std::max(0, first);
+    const int hi = std::min(width, first + span + 2 * radius);
+    int i = 0;
+    for (; i < lo - first; i++) {
+        padded[i] = src[0];
+    }
+    memcpy(padded + i, src + lo, (hi - lo) * sizeof(float));
+    for (i += hi - lo; i < span + 2 * radius; i++) {
+        padded[i] = src[width - 1];
+    }
+
+    int x = 0;
+    for (; x + static_cast<int>(SIMD_WIDTH) <= span; x += SIMD_WIDTH) {
+        simd_float acc = simd_mul(
+            simd_set1(weights[radius]), simd_load(padded + x + radius)
+        );
+        for (int k = 0; k < radius; k++) {
+            simd_float pair = simd_add(
+                simd_load(padded + x + k),
+                simd_load(padded + x + 2 * radius - k)
+            );
+            acc = simd_madd(simd_set1(weights[k]), pair, acc);
+        }
+        simd_store(dst + x, acc);
+    }
+    for (; x < span; x++) {
+        float acc = weights[radius] * padded[x + radius];
+        for (int k = 0; k < radius; k++) {
+            acc += weights[k] * (padded[x + k] + padded[x + 2 * radius - k]);
+        }
+        dst[x] = acc;
+    }
+}
+
+void HeightFilter::
+box(const float* src, float* dst, unsigned radius) {
+    /* NOTE(jan): One extra row so the row leaving the window is still
+     * around when the row entering it is loaded. */
+    const unsigned ringRows = 2 * radius + 2;
+    const float taps = static_cast<float>(2 * radius + 1);
+    const simd_float scale = simd_set1(1.f / (taps * taps));
+    _ring.resize(static_cast<size_t>(ringRows) * _width);
+    _columns.resize(_width);
+    float* columns = _columns.data();
+
+    auto ringRow = [&](int row) {
+        row = std::max(0, std::min(row, static_cast<int>(_depth) - 1));
+        return _ring.data() + static_cast<size_t>(row % ringRows) * _width;
+    };
+    unsigned loaded = 0;
+    auto load = [&](int last) {
+        last = std::min(last, static_cast<int>(_depth) - 1);
+        for (; static_cast<int>(loaded) <= last; loaded++) {
+            boxRow(
+                src + static_cast<size_t>(loaded) * _width,
+                ringRow(loaded),
+                radius
+            );
+        }
+    };
+
+    for (unsigned z = 0; z < _depth; z++) {
+        const int zi = static_cast<int>(z);
+        const int r = static_cast<int>(radius);
+        if (z % BOX_RESEED_INTERVAL == 0) {
+            load(zi + r);
+            memset(columns, 0, _width * sizeof(float));
+            for (int k = -r; k <= r; k++) {
+                const float* row = ringRow(zi + k);
+                for (unsigned x = 0; x < _width; x++) {
+                    columns[x] += row[x];
+                }
+            }
+        }
+
+        float* out = dst + static_cast<size_t>(z) * _width;
+        unsigned x = 0;
+        for (; x + SIMD_WIDTH <= _width; x += SIMD_WIDTH) {
+            simd_store(out + x, simd_mul(simd_load(columns + x), scale));
+        }
+        for (; x < _width; x++) {
+            out[x] = columns[x] / (taps * taps);
+        }
+
+        if (z + 1 < _depth) {
+            load(zi + 1 + r);
+            const float* entering = ringRow(zi + 1 + r);
+            const float* leaving = ringRow(zi - r);
+            x = 0;
+            for (; x + SIMD_WIDTH <= _width; x += SIMD_WIDTH) {
+                simd_float delta = simd_sub(
+                    simd_load(entering + x), simd_load(leaving + x)
+                );
+                simd_store(columns + x, simd_add(simd_load(columns + x), delta));
+            }
+            for (; x < _width; x++) {
+                columns[x] += entering[x] - leaving[x];
+            }
+        }
+    }
+}
+
+void HeightFilter::
+boxRow(const float* src, float* dst, unsigned radius) {
+    /* NOTE(jan): Running sums are inherently serial, so this stays scalar.
+     * Doubles keep wide rows from drifting. */
+    const int r = static_cast<int>(radius);
+    const int width = static_cast<int>(_width);
+    _prefix.resize(_width + 2 * radius + 1);
+    double* prefix = _prefix.data();
+    prefix[0] = 0.0;
+    for (int i = 0; i < width + 2 * r; i++) {
+        const int x = std::max(0, std::min(i - r, width - 1));
+        prefix[i + 1] = prefix[i] + src[x];
+    }
+    for (int x = 0; x < width; x++) {
+        dst[x] = static_cast<float>(prefix[x + 2 * r + 1] - prefix[x]);
+    }
+}
+
+void HeightFilter::
+gaussian(const float* src, float* dst, float sigma) {
+    /* NOTE(jan): Box sizes from Kovesi, "Fast Almost-Gaussian Filtering". */
+    const unsigned PASSES = 3;
+    const float variance = 12.f * sigma * sigma;
+    int lower = static_cast<int>(std::floor(std::sqrt(variance / PASSES + 1)));
+    if (lower % 2 == 0) lower--;
+    const int upper = lower + 2;
+    const float ideal = (variance - PASSES * lower * lower - 4.f * PASSES * lower
+                         - 3.f * PASSES) / (-4.f * lower - 4.f);
+    const int lowerCount = static_cast<int>(std::round(ideal));
+
+    unsigned radii[PASSES];
+    for (int i = 0; i < static_cast<int>(PASSES); i++) {
+        const int size = i < lowerCount ? lower : upper;
+        radii[i] = static_cast<unsigned>(std::max(0, (size - 1) / 2));
+    }
+
+    _pingPong.resize(static_cast<size_t>(_width) * _depth);
+    box(src, dst, radii[0]);
+    box(dst, _pingPong.data(), radii[1]);
+    box(_pingPong.data(), dst, radii[2]);
+}
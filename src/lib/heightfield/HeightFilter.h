@@ -0,0 +1,151 @@
+#pragma once
+
+#include <vector>
+
+using std::vector;
+
+/**
+  * A symmetric one dimensional convolution kernel. Two dimensional filters
+  * are built by applying it along both axes.
+  */
+class Kernel {
+public:
+    /**
+      * Constructor, creates the identity kernel.
+      */
+    Kernel();
+
+    /**
+      * Create a box kernel.
+      *
+      * @param radius Amount of taps on either side of the centre tap.
+      */
+    static Kernel box(unsigned radius);
+
+    /**
+      * Create a normalized gaussian kernel.
+      *
+      * @param sigma Standard deviation in samples.
+      * @param radius Amount of taps on either side of the centre tap. Zero
+      *               selects a radius of three standard deviations.
+      */
+    static Kernel gaussian(float sigma, unsigned radius = 0);
+
+    /**
+      * Get the kernel equivalent to applying this kernel and then rhs.
+      */
+    Kernel convolve(const Kernel& rhs) const;
+
+    /**
+      * Get the kernel equivalent to applying this kernel count times.
+      */
+    Kernel repeat(unsigned count) const;
+
+    /**
+      * Get the amount of taps on either side of the centre tap.
+      */
+    unsigned getRadius() const;
+
+    /**
+      * Get the 2 * radius + 1 weights, starting at the leftmost tap.
+      */
+    const float* getWeights() const;
+
+private:
+    /**
+      * Constructor.
+      *
+      * @param weights An odd amount of weights.
+      */
+    explicit Kernel(vector<float> weights);
+
+    /** The weights, centre tap at index radius. */
+    vector<float> _weights;
+};
+
+/**
+  * Filters a contiguous, row-major plane of heights. Samples outside the
+  * plane are clamped to the nearest edge.
+  *
+  * Every filter keeps the rows it still needs in its own scratch buffers,
+  * so src and dst may point to the same plane.
+  */
+class HeightFilter {
+public:
+    /**
+      * Constructor.
+      *
+      * @param width Amount of samples per row.
+      * @param depth Amount of rows.
+      */
+    HeightFilter(unsigned width, unsigned depth);
+
+    /**
+      * Apply a kernel along both axes. The horizontal pass feeds a ring of
+      * 2 * radius + 1 rows which the vertical pass consumes as soon as it
+      * is full, so the plane is read and written once regardless of the
+      * radius. Compose repeated filters into one kernel with
+      * Kernel::repeat() rather than calling this several times.
+      */
+    void convolve(const float* src, float* dst, const Kernel& kernel);
+
+    /**
+      * Apply a kernel along both axes, writing only rows [z0, z1) of dst.
+      * Up to radius rows on either side of the band are read as a halo, so
+      * bands may be filtered concurrently (each with its own HeightFilter)
+      * as long as src and dst are different planes.
+      */
+    void convolve(const float* src, float* dst, const Kernel& kernel,
+                  unsigned z0, unsigned z1);
+
+    /**
+      * Apply a kernel along both axes, writing only the samples in
+      * [x0, x1) x [z0, z1) of dst. Reads a halo of radius samples around
+      * the rectangle, so work is proportional to its area rather than to
+      * the plane. src and dst must be different planes.
+      */
+    void convolve(const float* src, float* dst, const Kernel& kernel,
+                  unsigned x0, unsigned z0, unsigned x1, unsigned z1);
+
+    /**
+      * Apply a box filter of any radius in constant time per sample, using
+      * running sums along each axis (a separable summed-area table).
+      */
+    void box(const float* src, float* dst, unsigned radius);
+
+    /**
+      * Approximate a gaussian with three box filters. The passes ping-pong
+      * between dst and an internal plane.
+      *
+      * @param sigma Standard deviation in samples.
+      */
+    void gaussian(const float* src, float* dst, float sigma);
+
+private:
+    /**
+      * Convolve samples [x0, x1) of a single row with a kernel, clamping
+      * at the edges. Writes x1 - x0 samples to dst.
+      */
+    void convolveRow(const float* src, float* dst, const Kernel& kernel,
+                     unsigned x0, unsigned x1);
+
+    /**
+      * Box filter a single row, clamping at the edges.
+      */
+    void boxRow(const float* src, float* dst, unsigned radius);
+
+    /** Amount of samples per row. */
+    unsigned _width;
+    /** Amount of rows. */
+    unsigned _depth;
+    /** One row padded with clamped samples on either side. */
+    vector<float> _padded;
+    /** Running sums along one row. */
+    vector<double> _prefix;
+    /** Horizontally filtered rows waiting for the vertical pass. */
+    vector<float> _ring;
+    /** Vertical running sums for the box filter. */
+    vector<float> _columns;
+    /** Second plane for multi-pass filters. */
+    vector<float> _pingPong;
+};
@@ -0,0 +1,101 @@
+#include "HeightPlane.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "../Simd.h"
+
+HeightPlane::
+HeightPlane(const float* heights, unsigned width, unsigned depth) :
+        _heights(heights),
+        _width(width),
+        _depth(depth) {}
+
+unsigned HeightPlane::
+getWidth() const {
+    return _width;
+}
+
+unsigned HeightPlane::
+getDepth() const {
+    return _depth;
+}
+
+const float* HeightPlane::
+getData() const {
+    return _heights;
+}
+
+float HeightPlane::
+getHeightAt(unsigned x, unsigned z) const {
+    return _heights[static_cast<size_t>(z) * _width + x];
+}
+
+float HeightPlane::
+sampleHeight(float x, float z) const {
+    float result;
+    sampleHeights(&x, &z, &result, 1);
+    return result;
+}
+
+void HeightPlane::
+sampleHeights(const float* xs, const float* zs, float* out, size_t n) const {
+    /* NOTE(jan): Clamping to one short of the last row and column keeps
+     * the far corner of every cell inside the plane. A point on the far
+     * edge lands in the last cell with a fraction of one. */
+    const float maxX = static_cast<float>(_width - 1);
+    const float maxZ = static_cast<float>(_depth - 1);
+    const float maxCellX = static_cast<float>(_width - 2);
+    const float maxCellZ = static_cast<float>(_depth - 2);
+    const float* below = _heights + _width;
+    const int32_t width = static_cast<int32_t>(_width);
+
+    const simd_float zero = simd_zero();
+    float cellXs[SIMD_WIDTH];
+    float cellZs[SIMD_WIDTH];
+    int32_t indices[SIMD_WIDTH];
+    size_t i = 0;
+    for (; i + SIMD_WIDTH <= n; i += SIMD_WIDTH) {
+        simd_float x = simd_min(simd_max(simd_load(xs + i), zero),
+                                simd_set1(maxX));
+        simd_float z = simd_min(simd_max(simd_load(zs + i), zero),
+                                simd_set1(maxZ));
+        simd_float cellX = simd_min(simd_floor(x), simd_set1(maxCellX));
+        simd_float cellZ = simd_min(simd_floor(z), simd_set1(maxCellZ));
+        simd_float fx = simd_sub(x, cellX);
+        simd_float fz = simd_sub(z, cellZ);
+
+        simd_store(cellXs, cellX);
+        simd_store(cellZs, cellZ);
+        for (unsigned k = 0; k < SIMD_WIDTH; k++) {
+            indices[k] = static_cast<int32_t>(cellZs[k]) * width +
+                         static_cast<int32_t>(cellXs[k]);
+        }
+        simd_float h00 = simd_gather(_heights, indices);
+        simd_float h10 = simd_gather(_heights + 1, indices);
+        simd_float h01 = simd_gather(below, indices);
+        simd_float h11 = simd_gather(below + 1, indices);
+
+        simd_float top = simd_madd(fx, simd_sub(h10, h00), h00);
+        simd_float bottom = simd_madd(fx, simd_sub(h11, h01), h01);
+        simd_store(out + i, simd_madd(fz, simd_sub(bottom, top), top));
+    }
+    for (; i < n; i++) {
+        const float x = std::min(std::max(xs[i], 0.f), maxX);
+        const float z = std::min(std::max(zs[i], 0.f), maxZ);
+        const float cellX = std::min(std::floor(x), maxCellX);
+        const float cellZ = std::min(std::floor(z), maxCellZ);
+        const float fx = x - cellX;
+        const float fz = z - cellZ;
+        const size_t index = static_cast<size_t>(cellZ) * _width +
+                             static_cast<size_t>(cellX);
+        const float h00 = _heights[index];
+        const float h10 = _heights[index + 1];
+        const float h01 = below[index];
+        const float h11 = below[index + 1];
+        const float top = fx * (h10 - h00) + h00;
+        const float bottom = fx * (h11 - h01) + h01;
+        out[i] = fz * (bottom - top) + top;
+    }
+}
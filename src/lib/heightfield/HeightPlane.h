@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+  * A read-only view of a contiguous, row-major plane of heights, one per
+  * unit of heightmap coordinates. The view does not own the heights, so
+  * it is only valid for as long as whatever it was taken from.
+  *
+  * Sampling between grid points interpolates bilinearly. Coordinates
+  * outside the plane are clamped to the nearest edge.
+  */
+class HeightPlane {
+public:
+    /**
+      * Constructor.
+      *
+      * @param heights First height of the plane.
+      * @param width Amount of heights per row, at least 2.
+      * @param depth Amount of rows, at least 2.
+      */
+    HeightPlane(const float* heights, unsigned width, unsigned depth);
+
+    /**
+      * Get the amount of heights per row.
+      */
+    unsigned getWidth() const;
+
+    /**
+      * Get the amount of rows.
+      */
+    unsigned getDepth() const;
+
+    /**
+      * Get the first height of the plane.
+      */
+    const float* getData() const;
+
+    /**
+      * Get the height at a grid point.
+      */
+    float getHeightAt(unsigned x, unsigned z) const;
+
+    /**
+      * Get the bilinearly interpolated height at any point.
+      */
+    float sampleHeight(float x, float z) const;
+
+    /**
+      * Get the bilinearly interpolated heights at many points at once.
+      * Points are processed a vector register at a time, so prefer one
+      * large batch over many small ones.
+      *
+      * @param xs Coordinates along x.
+      * @param zs Coordinates along z.
+      * @param out Receives one height per point. May alias xs or zs.
+      * @param n Amount of points.
+      */
+    void sampleHeights(const float* xs, const float* zs, float* out,
+                       size_t n) const;
+
+private:
+    /** First height of the plane. */
+    const float* _heights;
+    /** Amount of heights per row. */
+    unsigned _width;
+    /** Amount of rows. */
+    unsigned _depth;
+};
@@ -0,0 +1,348 @@
+#include "HeightPyramid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "../Simd.h"
+#include "../ThreadPool.h"
+
+using std::max;
+using std::min;
+
+/** Rays handed to a worker at once by castRays(). */
+static const size_t RAY_GRAIN = 64;
+/** Cells handed to a worker at once while building a level. */
+static const size_t CELL_GRAIN = 1 << 14;
+/** Slack allowed when deciding whether a hit lies inside a triangle. */
+static const float HIT_EPSILON = 1e-5f;
+
+/**
+  * Get the cell a ray is in along one axis. A ray sitting exactly on a
+  * boundary is in the cell it is about to enter.
+  */
+static unsigned
+getCell(float position, float direction, float size, unsigned count) {
+    const float cell = direction < 0.f
+        ? std::ceil(position / size) - 1.f
+        : std::floor(position / size);
+    return static_cast<unsigned>(
+        max(0.f, min(cell, static_cast<float>(count - 1)))
+    );
+}
+
+/**
+  * Get the distance at which a ray leaves a cell along one axis.
+  */
+static float
+getCellExit(float origin, float direction, unsigned cell, float size) {
+    if (direction > 0.f) {
+        return ((cell + 1) * size - origin) / direction;
+    } else if (direction < 0.f) {
+        return (cell * size - origin) / direction;
+    }
+    return std::numeric_limits<float>::infinity();
+}
+
+/**
+  * Narrow [t0, t1] to where a ray is between lo and hi along one axis.
+  *
+  * @return Whether anything is left.
+  */
+static bool
+clipSlab(float origin, float direction, float lo, float hi,
+         float& t0, float& t1) {
+    if (direction == 0.f) {
+        return (origin >= lo) && (origin <= hi);
+    }
+    float a = (lo - origin) / direction;
+    float b = (hi - origin) / direction;
+    if (a > b) std::swap(a, b);
+    t0 = max(t0, a);
+    t1 = min(t1, b);
+    return t0 <= t1;
+}
+
+/**
+  * Intersect a ray with a triangle from either side (Moller-Trumbore).
+  *
+  * @return Distance along the ray, or a negative number on a miss.
+  */
+static float
+intersectTriangle(const vec3& origin, const vec3& direction,
+                  const vec3& a, const vec3& b, const vec3& c) {
+    const vec3 e1 = b - a;
+    const vec3 e2 = c - a;
+    const vec3 p = glm::cross(direction, e2);
+    const float det = glm::dot(e1, p);
+    if (std::fabs(det) < 1e-12f) {
+        return -1.f;
+    }
+    const float inverse = 1.f / det;
+    const vec3 s = origin - a;
+    const float u = glm::dot(s, p) * inverse;
+    if ((u < -HIT_EPSILON) || (u > 1.f + HIT_EPSILON)) {
+        return -1.f;
+    }
+    const vec3 q = glm::cross(s, e1);
+    const float v = glm::dot(direction, q) * inverse;
+    if ((v < -HIT_EPSILON) || (u + v > 1.f + HIT_EPSILON)) {
+        return -1.f;
+    }
+    return glm::dot(e2, q) * inverse;
+}
+
+HeightPyramid::
+HeightPyramid(const HeightPlane& plane) :
+        _plane(plane) {
+    unsigned width = max(1u, plane.getWidth() - 1);
+    unsigned depth = max(1u, plane.getDepth() - 1);
+    while (true) {
+        Level level;
+        level.width = width;
+        level.depth = depth;
+        level.mins.resize(static_cast<size_t>(width) * depth);
+        level.maxs.resize(static_cast<size_t>(width) * depth);
+        _levels.push_back(std::move(level));
+        if ((width == 1) && (depth == 1)) {
+            break;
+        }
+        width = (width + 1) / 2;
+        depth = (depth + 1) / 2;
+    }
+
+    ThreadPool& pool = ThreadPool::shared();
+    for (unsigned l = 0; l < _levels.size(); l++) {
+        const unsigned levelWidth = _levels[l].width;
+        const size_t grain = max<size_t>(1, CELL_GRAIN / levelWidth);
+        pool.parallelFor(_levels[l].depth, grain, [&](size_t z0, size_t z1) {
+            const unsigned zb = static_cast<unsigned>(z0);
+            const unsigned ze = static_cast<unsigned>(z1);
+            if (l == 0) {
+                buildBase(0, zb, levelWidth, ze);
+            } else {
+                buildLevel(l, 0, zb, levelWidth, ze);
+            }
+        });
+    }
+}
+
+HeightPyramid::
+HeightPyramid(const HeightPyramid& rhs, const HeightPlane& plane) :
+        _plane(plane),
+        _levels(rhs._levels) {
+}
+
+void HeightPyramid::
+update(unsigned x0, unsigned z0, unsigned x1, unsigned z1) {
+    /* NOTE(jan): A sample belongs to the quads on either side of it. */
+    unsigned cx0 = x0 > 0 ? x0 - 1 : 0;
+    unsigned cz0 = z0 > 0 ? z0 - 1 : 0;
+    unsigned cx1 = min(x1, _levels[0].width);
+    unsigned cz1 = min(z1, _levels[0].depth);
+    buildBase(cx0, cz0, cx1, cz1);
+    for (unsigned l = 1; l < _levels.size(); l++) {
+        cx0 /= 2;
+        cz0 /= 2;
+        cx1 = min((cx1 + 1) / 2, _levels[l].width);
+        cz1 = min((cz1 + 1) / 2, _levels[l].depth);
+        buildLevel(l, cx0, cz0, cx1, cz1);
+    }
+}
+
+const HeightPlane& HeightPyramid::
+getPlane() const {
+    return _plane;
+}
+
+unsigned HeightPyramid::
+getLevelCount() const {
+    return static_cast<unsigned>(_levels.size());
+}
+
+unsigned HeightPyramid::
+getLevelWidth(unsigned level) const {
+    return _levels[level].width;
+}
+
+unsigned HeightPyramid::
+getLevelDepth(unsigned level) const {
+    return _levels[level].depth;
+}
+
+size_t HeightPyramid::
+getCellOffset(unsigned level) const {
+    size_t offset = 0;
+    for (unsigned l = 0; l < level; l++) {
+        offset += _levels[l].mins.size();
+    }
+    return offset;
+}
+
+void HeightPyramid::
+writeBounds(float* dst, unsigned level, unsigned x0, unsigned z0,
+            unsigned x1, unsigned z1) const {
+    const Level& current = _levels[level];
+    for (unsigned z = z0; z < z1; z++) {
+        const size_t row = static_cast<size_t>(z) * current.width;
+        for (unsigned x = x0; x < x1; x++) {
+            *dst++ = current.mins[row + x];
+            *dst++ = current.maxs[row + x];
+        }
+    }
+}
+
+float HeightPyramid::
+getMinHeight() const {
+    return _levels.back().mins[0];
+}
+
+float HeightPyramid::
+getMaxHeight() const {
+    return _levels.back().maxs[0];
+}
+
+HeightHit HeightPyramid::
+castRay(const HeightRay& ray) const {
+    HeightHit result = {};
+    const vec3& o = ray.origin;
+    const vec3& d = ray.direction;
+
+    float t = 0.f;
+    float tExit = ray.maxDistance;
+    const float maxX = static_cast<float>(_plane.getWidth() - 1);
+    const float maxZ = static_cast<float>(_plane.getDepth() - 1);
+    if (!clipSlab(o.x, d.x, 0.f, maxX, t, tExit) ||
+        !clipSlab(o.z, d.z, 0.f, maxZ, t, tExit) ||
+        !clipSlab(o.y, d.y, getMinHeight(), getMaxHeight(), t, tExit)) {
+        return result;
+    }
+
+    /* NOTE(jan): Start at the top. Whenever the stretch of ray over a cell
+     * misses the cell's height range, skip to the end of the stretch and
+     * try a level up. Otherwise look closer, one level down, until there
+     * is a single quad left to test. */
+    const unsigned top = static_cast<unsigned>(_levels.size() - 1);
+    unsigned l = top;
+    while (t < tExit) {
+        const Level& level = _levels[l];
+        const float size = static_cast<float>(1u << l);
+        const vec3 p = o + d * t;
+        const unsigned cx = getCell(p.x, d.x, size, level.width);
+        const unsigned cz = getCell(p.z, d.z, size, level.depth);
+        const float tEnd = min(
+            min(getCellExit(o.x, d.x, cx, size),
+                getCellExit(o.z, d.z, cz, size)),
+            tExit
+        );
+
+        const float y0 = o.y + d.y * t;
+        const float y1 = o.y + d.y * tEnd;
+        const size_t cell = static_cast<size_t>(cz) * level.width + cx;
+        const bool missed = (max(y0, y1) < level.mins[cell]) ||
+                            (min(y0, y1) > level.maxs[cell]);
+        if (!missed) {
+            if (l > 0) {
+                l--;
+                continue;
+            }
+            const float hit = intersectQuad(ray, cx, cz, t, tEnd);
+            if (hit >= 0.f) {
+                result.hit = true;
+                result.distance = hit;
+                result.position = o + d * hit;
+                return result;
+            }
+        }
+        t = tEnd > t ? tEnd : std::nextafter(t, tExit);
+        l = min(l + 1, top);
+    }
+    return result;
+}
+
+void HeightPyramid::
+castRays(const HeightRay* rays, HeightHit* hits, size_t count) const {
+    ThreadPool::shared().parallelFor(
+        count, RAY_GRAIN,
+        [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                hits[i] = castRay(rays[i]);
+            }
+        }
+    );
+}
+
+void HeightPyramid::
+buildBase(unsigned x0, unsigned z0, unsigned x1, unsigned z1) {
+    Level& level = _levels[0];
+    const unsigned planeWidth = _plane.getWidth();
+    for (unsigned z = z0; z < z1; z++) {
+        const float* row = _plane.getData() + static_cast<size_t>(z) * planeWidth;
+        const float* below = row + planeWidth;
+        float* mins = level.mins.data() + static_cast<size_t>(z) * level.width;
+        float* maxs = level.maxs.data() + static_cast<size_t>(z) * level.width;
+        unsigned x = x0;
+        for (; x + SIMD_WIDTH <= x1; x += SIMD_WIDTH) {
+            const simd_float a = simd_load(row + x);
+            const simd_float b = simd_load(row + x + 1);
+            const simd_float c = simd_load(below + x);
+            const simd_float e = simd_load(below + x + 1);
+            simd_store(mins + x, simd_min(simd_min(a, b), simd_min(c, e)));
+            simd_store(maxs + x, simd_max(simd_max(a, b), simd_max(c, e)));
+        }
+        for (; x < x1; x++) {
+            mins[x] = min(min(row[x], row[x + 1]), min(below[x], below[x + 1]));
+            maxs[x] = max(max(row[x], row[x + 1]), max(below[x], below[x + 1]));
+        }
+    }
+}
+
+void HeightPyramid::
+buildLevel(unsigned l, unsigned x0, unsigned z0, unsigned x1, unsigned z1) {
+    Level& level = _levels[l];
+    const Level& child = _levels[l - 1];
+    for (unsigned z = z0; z < z1; z++) {
+        const unsigned cz0 = 2 * z;
+        const unsigned cz1 = min(2 * z + 1, child.depth - 1);
+        for (unsigned x = x0; x < x1; x++) {
+            const unsigned cx0 = 2 * x;
+            const unsigned cx1 = min(2 * x + 1, child.width - 1);
+            const size_t a = static_cast<size_t>(cz0) * child.width + cx0;
+            const size_t b = static_cast<size_t>(cz0) * child.width + cx1;
+            const size_t c = static_cast<size_t>(cz1) * child.width + cx0;
+            const size_t e = static_cast<size_t>(cz1) * child.width + cx1;
+            const size_t cell = static_cast<size_t>(z) * level.width + x;
+            level.mins[cell] = min(min(child.mins[a], child.mins[b]),
+                                   min(child.mins[c], child.mins[e]));
+            level.maxs[cell] = max(max(child.maxs[a], child.maxs[b]),
+                                   max(child.maxs[c], child.maxs[e]));
+        }
+    }
+}
+
+float HeightPyramid::
+intersectQuad(const HeightRay& ray, unsigned x, unsigned z,
+              float t0, float t1) const {
+    /* NOTE(jan): Same split as Terrain's index buffer, along the diagonal
+     * from (x + 1, z) to (x, z + 1). */
+    const float fx = static_cast<float>(x);
+    const float fz = static_cast<float>(z);
+    const vec3 p00(fx, _plane.getHeightAt(x, z), fz);
+    const vec3 p10(fx + 1.f, _plane.getHeightAt(x + 1, z), fz);
+    const vec3 p01(fx, _plane.getHeightAt(x, z + 1), fz + 1.f);
+    const vec3 p11(fx + 1.f, _plane.getHeightAt(x + 1, z + 1), fz + 1.f);
+
+    const float slack = HIT_EPSILON * (1.f + t1);
+    float result = -1.f;
+    const float hits[2] = {
+        intersectTriangle(ray.origin, ray.direction, p00, p01, p10),
+        intersectTriangle(ray.origin, ray.direction, p10, p01, p11),
+    };
+    for (float hit: hits) {
+        if ((hit >= t0 - slack) && (hit <= t1 + slack) &&
+            ((result < 0.f) || (hit < result))) {
+            result = max(hit, 0.f);
+        }
+    }
+    return result;
+}
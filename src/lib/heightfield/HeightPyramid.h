@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#ifndef NOMINMAX
+# define NOMINMAX
+#endif
+#include <glm/glm.hpp>
+
+#include "HeightPlane.h"
+
+using std::vector;
+
+using glm::vec3;
+
+/**
+  * A ray in heightmap coordinates, where the height plane spans
+  * [0, width - 1] along x and [0, depth - 1] along z and y is height.
+  */
+struct HeightRay {
+    /** Start of the ray. */
+    vec3 origin;
+    /** Direction of the ray, distances are measured in multiples of it. */
+    vec3 direction;
+    /** Distance beyond which hits are ignored. */
+    float maxDistance;
+};
+
+/**
+  * Where a HeightRay met the height plane.
+  */
+struct HeightHit {
+    /** Whether the ray hit at all. The fields below are only set if so. */
+    bool hit;
+    /** Distance along the ray, in multiples of its direction. */
+    float distance;
+    /** Point that was hit. */
+    vec3 position;
+};
+
+/**
+  * A pyramid of the lowest and highest heights over ever larger cells of a
+  * HeightPlane. Level 0 has one cell per quad of the plane, every level
+  * above merges 2x2 cells of the one below.
+  *
+  * Rays are cast against the two triangles per quad that Terrain renders.
+  * They step through the coarsest cells they can prove they pass over or
+  * under and only descend where they might hit, so a ray costs roughly
+  * logarithmic rather than linear time in the size of the plane.
+  */
+class HeightPyramid {
+public:
+    /**
+      * Constructor, builds the pyramid over a plane. The pyramid keeps the
+      * view, so the plane must outlive it.
+      */
+    explicit HeightPyramid(const HeightPlane& plane);
+
+    /**
+      * Constructor, copies a pyramid onto a plane that holds the same
+      * heights as the one it was built over, such as a copy of it.
+      */
+    HeightPyramid(const HeightPyramid& rhs, const HeightPlane& plane);
+
+    /**
+      * Refresh the cells touching the samples in [x0, x1) x [z0, z1),
+      * after they changed.
+      */
+    void update(unsigned x0, unsigned z0, unsigned x1, unsigned z1);
+
+    /**
+      * Get the plane the pyramid is over.
+      */
+    const HeightPlane& getPlane() const;
+
+    /**
+      * Get the amount of levels.
+      */
+    unsigned getLevelCount() const;
+
+    /**
+      * Get the amount of cells along x of a level.
+      */
+    unsigned getLevelWidth(unsigned level) const;
+
+    /**
+      * Get the amount of cells along z of a level.
+      */
+    unsigned getLevelDepth(unsigned level) const;
+
+    /**
+      * Get the amount of cells in the levels below a level, which is
+      * where the level starts in the layout of writeBounds(). With
+      * getLevelCount() it is the amount of cells in the pyramid.
+      */
+    size_t getCellOffset(unsigned level) const;
+
+    /**
+      * Write the lowest and highest height of the cells of a level in
+      * [x0, x1) x [z0, z1), one pair per cell, row after row.
+      */
+    void writeBounds(float* dst, unsigned level, unsigned x0, unsigned z0,
+                     unsigned x1, unsigned z1) const;
+
+    /**
+      * Get the lowest height on the plane.
+      */
+    float getMinHeight() const;
+
+    /**
+      * Get the highest height on the plane.
+      */
+    float getMaxHeight() const;
+
+    /**
+      * Find the nearest point where a ray meets the plane.
+      */
+    HeightHit castRay(const HeightRay& ray) const;
+
+    /**
+      * Cast many rays, spread over the workers of the shared pool.
+      *
+      * @param rays Rays to cast.
+      * @param hits Receives one hit per ray.
+      * @param count Amount of rays.
+      */
+    void castRays(const HeightRay* rays, HeightHit* hits,
+                  size_t count) const;
+
+private:
+    /**
+      * Lowest and highest heights over the cells of one level.
+      */
+    struct Level {
+        /** Cells per row. */
+        unsigned width;
+        /** Rows of cells. */
+        unsigned depth;
+        /** Lowest height per cell, row-major. */
+        vector<float> mins;
+        /** Highest height per cell, row-major. */
+        vector<float> maxs;
+    };
+
+    /**
+      * Compute level 0 cells in [x0, x1) x [z0, z1) from the plane.
+      */
+    void buildBase(unsigned x0, unsigned z0, unsigned x1, unsigned z1);
+
+    /**
+      * Compute cells in [x0, x1) x [z0, z1) of a level from the one below.
+      */
+    void buildLevel(unsigned level, unsigned x0, unsigned z0,
+                    unsigned x1, unsigned z1);
+
+    /**
+      * Intersect a ray with the two triangles of a quad.
+      *
+      * @return The nearest distance in [t0, t1], or a negative number.
+      */
+    float intersectQuad(const HeightRay& ray, unsigned x, unsigned z,
+                        float t0, float t1) const;
+
+    /** The heights. */
+    HeightPlane _plane;
+    /** Levels, finest first. The last has a single cell. */
+    vector<Level> _levels;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+  * Anything a Terrain can be built from: a grid of heights, read a row at
+  * a time. Rows may be read concurrently.
+  */
+class HeightSource {
+public:
+    /**
+      * Destructor.
+      */
+    virtual ~HeightSource() = default;
+
+    /**
+      * Get the amount of samples per row.
+      */
+    virtual unsigned getWidth() const = 0;
+
+    /**
+      * Get the amount of rows.
+      */
+    virtual unsigned getDepth() const = 0;
+
+    /**
+      * Read a row of heights, normally in [0, 1].
+      *
+      * @param z The row.
+      * @param out Receives getWidth() heights.
+      */
+    virtual void readRow(unsigned z, float* out) const = 0;
+
+    /**
+      * Hash what the heights are made from, so that cooked copies can tell
+      * when they have gone stale. Sources that generate their heights can
+      * hash their parameters instead of reading them all.
+      *
+      * @param seed Hash to continue from.
+      */
+    virtual uint64_t hashSource(uint64_t seed) const = 0;
+};
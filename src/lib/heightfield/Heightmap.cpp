@@ -0,0 +1,278 @@
+#include "Heightmap.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include <stb_image.h>
+
+#include "../Hash.h"
+
+using std::runtime_error;
+
+const char Heightmap::HEADER_MAGIC[4] = {'H', 'M', 'A', 'P'};
+
+/**
+  * Get the size of one sample in bytes.
+  */
+static size_t
+getSampleSize(Heightmap::Format format) {
+    switch (format) {
+        case Heightmap::Format::U8: return 1;
+        case Heightmap::Format::U16: return 2;
+        case Heightmap::Format::U16BE: return 2;
+        case Heightmap::Format::F32: return 4;
+    }
+    throw runtime_error("Unknown heightmap format.");
+}
+
+/**
+  * Get the lower case extension of a path, including the dot.
+  */
+static string
+getExtension(const string& path) {
+    const size_t dot = path.rfind('.');
+    if (dot == string::npos) {
+        return "";
+    }
+    string result = path.substr(dot);
+    std::transform(result.begin(), result.end(), result.begin(), ::tolower);
+    return result;
+}
+
+Heightmap::
+Heightmap(const string& path) :
+        _file(path),
+        _format(Format::U8),
+        _width(0),
+        _depth(0),
+        _scale(1.f),
+        _samples(nullptr),
+        _decoded(nullptr) {
+    const string extension = getExtension(path);
+    if ((extension == ".r16") || (extension == ".r32")) {
+        _format = extension == ".r16" ? Format::U16 : Format::F32;
+        const size_t count = _file.getSize() / getSampleSize(_format);
+        _width = static_cast<unsigned>(std::sqrt(static_cast<double>(count)));
+        _depth = _width;
+        if (static_cast<size_t>(_width) * _depth != count) {
+            throw runtime_error(
+                path + " is not square, give its dimensions explicitly."
+            );
+        }
+        if (_format == Format::U16) _scale = 1.f / 65535.f;
+        setSamples(0);
+    } else if (extension == ".pgm") {
+        openPGM();
+    } else if (extension == ".hmap") {
+        openHMAP();
+    } else {
+        openImage();
+    }
+}
+
+Heightmap::
+Heightmap(const string& path, Format format,
+          unsigned width, unsigned depth) :
+        _file(path),
+        _format(format),
+        _width(width),
+        _depth(depth),
+        _scale(1.f),
+        _samples(nullptr),
+        _decoded(nullptr) {
+    if (format == Format::U8) _scale = 1.f / 255.f;
+    if (format == Format::U16 || format == Format::U16BE) {
+        _scale = 1.f / 65535.f;
+    }
+    setSamples(0);
+}
+
+Heightmap::
+~Heightmap() {
+    if (_decoded) {
+        stbi_image_free(_decoded);
+    }
+}
+
+void Heightmap::
+write(const string& path, unsigned width, unsigned depth,
+      const float* heights) {
+    Header header = {};
+    memcpy(header.magic, HEADER_MAGIC, sizeof(header.magic));
+    header.version = HEADER_VERSION;
+    header.width = width;
+    header.depth = depth;
+    header.format = Format::F32;
+    header.dataOffset = sizeof(header);
+    const size_t count = static_cast<size_t>(width) * depth;
+    MappedFile file = MappedFile::create(
+        path, header.dataOffset + count * sizeof(float)
+    );
+    unsigned char* data = file.getWritableData();
+    memcpy(data, &header, sizeof(header));
+    memcpy(data + header.dataOffset, heights, count * sizeof(float));
+}
+
+unsigned Heightmap::
+getWidth() const {
+    return _width;
+}
+
+unsigned Heightmap::
+getDepth() const {
+    return _depth;
+}
+
+Heightmap::Format Heightmap::
+getFormat() const {
+    return _format;
+}
+
+const void* Heightmap::
+getData() const {
+    return _samples;
+}
+
+void Heightmap::
+readRow(unsigned z, float* out) const {
+    const size_t sampleSize = getSampleSize(_format);
+    const unsigned char* row =
+        _samples + static_cast<size_t>(z) * _width * sampleSize;
+    switch (_format) {
+        case Format::U8:
+            for (unsigned x = 0; x < _width; x++) {
+                out[x] = row[x] * _scale;
+            }
+            break;
+        case Format::U16:
+            for (unsigned x = 0; x < _width; x++) {
+                /* NOTE(jan): PGM and .hmap data need not be aligned. */
+                uint16_t sample;
+                memcpy(&sample, row + x * 2, sizeof(sample));
+                out[x] = sample * _scale;
+            }
+            break;
+        case Format::U16BE:
+            for (unsigned x = 0; x < _width; x++) {
+                const unsigned sample = (row[x * 2] << 8) | row[x * 2 + 1];
+                out[x] = sample * _scale;
+            }
+            break;
+        case Format::F32:
+            memcpy(out, row, _width * sizeof(float));
+            break;
+    }
+}
+
+uint64_t Heightmap::
+hashSource(uint64_t seed) const {
+    uint64_t hash = hashBytes(_file.getData(), _file.getSize(), seed);
+    hash = hashValue(_width, hash);
+    hash = hashValue(_depth, hash);
+    return hashValue(_format, hash);
+}
+
+void Heightmap::
+setSamples(size_t offset) {
+    const size_t size =
+        static_cast<size_t>(_width) * _depth * getSampleSize(_format);
+    if ((_width == 0) || (_depth == 0) ||
+        (offset + size > _file.getSize())) {
+        throw runtime_error("Heightmap is smaller than its dimensions.");
+    }
+    _samples = _file.getData() + offset;
+}
+
+void Heightmap::
+openPGM() {
+    const unsigned char* data = _file.getData();
+    const size_t size = _file.getSize();
+    size_t at = 0;
+    auto skipSpace = [&]() {
+        while (at < size) {
+            if (data[at] == '#') {
+                while ((at < size) && (data[at] != '\n')) at++;
+            } else if (isspace(data[at])) {
+                at++;
+            } else {
+                break;
+            }
+        }
+    };
+    auto readNumber = [&]() {
+        skipSpace();
+        unsigned result = 0;
+        if ((at >= size) || !isdigit(data[at])) {
+            throw runtime_error("Malformed PGM header.");
+        }
+        while ((at < size) && isdigit(data[at])) {
+            result = result * 10 + (data[at++] - '0');
+        }
+        return result;
+    };
+
+    if ((size < 2) || (data[0] != 'P') || (data[1] != '5')) {
+        throw runtime_error("Only binary (P5) PGM files are supported.");
+    }
+    at = 2;
+    _width = readNumber();
+    _depth = readNumber();
+    const unsigned maxValue = readNumber();
+    if ((maxValue == 0) || (maxValue > 65535)) {
+        throw runtime_error("Malformed PGM header.");
+    }
+    /* NOTE(jan): Exactly one whitespace character precedes the samples. */
+    at++;
+    _format = maxValue < 256 ? Format::U8 : Format::U16BE;
+    _scale = 1.f / maxValue;
+    setSamples(at);
+}
+
+void Heightmap::
+openHMAP() {
+    Header header;
+    if (_file.getSize() < sizeof(header)) {
+        throw runtime_error("Truncated heightmap header.");
+    }
+    memcpy(&header, _file.getData(), sizeof(header));
+    if (memcmp(header.magic, HEADER_MAGIC, sizeof(header.magic)) != 0) {
+        throw runtime_error("Not a heightmap file.");
+    }
+    if (header.version != HEADER_VERSION) {
+        throw runtime_error("Unsupported heightmap version.");
+    }
+    if ((header.format != Format::U16) && (header.format != Format::F32)) {
+        throw runtime_error("Unsupported heightmap sample format.");
+    }
+    _width = header.width;
+    _depth = header.depth;
+    _format = header.format;
+    _scale = _format == Format::U16 ? 1.f / 65535.f : 1.f;
+    setSamples(header.dataOffset);
+}
+
+void Heightmap::
+openImage() {
+    const stbi_uc* data = _file.getData();
+    const int size = static_cast<int>(_file.getSize());
+    int width = 0;
+    int height = 0;
+    int channelsInFile = 0;
+    const int desiredChannels = 1;
+    /* NOTE(jan): 8-bit images are widened exactly (v * 257), so one path
+     * keeps 16-bit images from being quantized. */
+    _decoded = stbi_load_16_from_memory(
+        data, size, &width, &height, &channelsInFile, desiredChannels
+    );
+    _format = Format::U16;
+    _scale = 1.f / 65535.f;
+    if (_decoded == nullptr) {
+        throw runtime_error(stbi_failure_reason());
+    }
+    _width = static_cast<unsigned>(width);
+    _depth = static_cast<unsigned>(height);
+    _samples = static_cast<const unsigned char*>(_decoded);
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "../MappedFile.h"
+#include "HeightSource.h"
+
+using std::string;
+
+/**
+  * A read-only grid of heights backed by a file.
+  *
+  * Raw heightfields are read straight out of a memory mapping, so loading
+  * costs nothing up front and each row is only paged in when it is read.
+  * The following formats are recognised by extension:
+  *
+  *  - .r16 Square grid of little-endian unsigned 16-bit samples.
+  *  - .r32 Square grid of little-endian 32-bit floats.
+  *  - .pgm Binary (P5) greymap with 8 or 16-bit samples.
+  *  - .hmap HeightmapHeader followed by 16-bit or float samples.
+  *
+  * Anything else is decoded with stb_image to 16 bits per sample, so
+  * 16-bit images keep their precision.
+  */
+class Heightmap : public HeightSource {
+public:
+    /**
+      * How samples are stored.
+      */
+    enum class Format : uint32_t {
+        U8 = 0,
+        U16 = 1,
+        F32 = 2,
+        /** Big-endian 16-bit, as used by PGM. */
+        U16BE = 3,
+    };
+
+    /**
+      * Layout of the header of a .hmap file. Samples follow at dataOffset,
+      * row-major, without padding.
+      */
+    struct Header {
+        /** Set to HEADER_MAGIC. */
+        char magic[4];
+        /** Set to HEADER_VERSION. */
+        uint32_t version;
+        /** Amount of samples per row. */
+        uint32_t width;
+        /** Amount of rows. */
+        uint32_t depth;
+        /** Format of the samples, either U16 or F32. */
+        Format format;
+        /** Offset of the first sample from the start of the file. */
+        uint32_t dataOffset;
+    };
+
+    /** Magic bytes at the start of a .hmap file. */
+    static const char HEADER_MAGIC[4];
+    /** Version of the .hmap header. */
+    static const uint32_t HEADER_VERSION = 1;
+
+    /**
+      * Constructor, opens a height map and detects its format.
+      *
+      * @param path Path to the height map.
+      */
+    explicit Heightmap(const string& path);
+
+    /**
+      * Constructor, opens a headerless raw height map.
+      *
+      * @param path Path to the height map.
+      * @param format Format of the samples.
+      * @param width Amount of samples per row.
+      * @param depth Amount of rows.
+      */
+    Heightmap(const string& path, Format format,
+              unsigned width, unsigned depth);
+
+    /**
+      * Destructor.
+      */
+    ~Heightmap() override;
+
+    /**
+      * Write heights to a .hmap file as floats.
+      *
+      * @param path Path of the file, replaced if it exists.
+      * @param width Amount of samples per row.
+      * @param depth Amount of rows.
+      * @param heights Row-major heights, in [0, 1] to match other formats.
+      */
+    static void write(const string& path, unsigned width, unsigned depth,
+                      const float* heights);
+
+    Heightmap(const Heightmap&) = delete;
+    Heightmap& operator=(const Heightmap&) = delete;
+
+    /**
+      * Get the amount of samples per row.
+      */
+    unsigned getWidth() const override;
+
+    /**
+      * Get the amount of rows.
+      */
+    unsigned getDepth() const override;
+
+    /**
+      * Get the format of the samples.
+      */
+    Format getFormat() const;
+
+    /**
+      * Get a pointer to the first sample. Rows are tightly packed.
+      */
+    const void* getData() const;
+
+    /**
+      * Convert a row to floats. Integer samples are normalized to [0, 1],
+      * float samples are returned as stored.
+      *
+      * @param z The row.
+      * @param out Receives getWidth() heights.
+      */
+    void readRow(unsigned z, float* out) const override;
+
+    /**
+      * Hash the whole file along with the shape and format it is read
+      * with, so that any edit to the heights goes stale.
+      */
+    uint64_t hashSource(uint64_t seed) const override;
+
+private:
+    /**
+      * Point at the samples in the mapping, checking that they fit.
+      */
+    void setSamples(size_t offset);
+
+    /**
+      * Parse a PGM header.
+      */
+    void openPGM();
+
+    /**
+      * Parse a .hmap header.
+      */
+    void openHMAP();
+
+    /**
+      * Decode an image with stb_image.
+      */
+    void openImage();
+
+    /** The mapped file. */
+    MappedFile _file;
+    /** Format of the samples. */
+    Format _format;
+    /** Amount of samples per row. */
+    unsigned _width;
+    /** Amount of rows. */
+    unsigned _depth;
+    /** Multiplier that normalizes integer samples. */
+    float _scale;
+    /** First sample, in the mapping or in _decoded. */
+    const unsigned char* _samples;
+    /** Pixels decoded by stb_image, if the file needed decoding. */
+    void* _decoded;
+};
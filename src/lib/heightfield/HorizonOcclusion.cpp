@@ -0,0 +1,126 @@
+#include "HorizonOcclusion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "../Simd.h"
+
+using std::max;
+using std::min;
+using std::vector;
+
+/** Steps along x and z of each direction, axes and diagonals in turn. */
+static const int DIRECTIONS[HorizonOcclusion::DIRECTION_COUNT][2] = {
+    {1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1},
+};
+
+HorizonOcclusion::
+HorizonOcclusion(unsigned radius) :
+        _radius(max(1u, radius)) {}
+
+unsigned HorizonOcclusion::
+getRadius() const {
+    return _radius;
+}
+
+void HorizonOcclusion::
+bake(const HeightPlane& window, unsigned firstRow, unsigned depth,
+     float* out, unsigned x0, unsigned z0, unsigned x1, unsigned z1) const {
+    if ((x0 >= x1) || (z0 >= z1)) {
+        return;
+    }
+
+    /* NOTE(jan): Copy the rectangle and radius samples around it into a
+     * tile, clamping at the plane edges, so that the sweeps below can
+     * read whole rows without checking where they are. */
+    const int radius = static_cast<int>(_radius);
+    const int width = static_cast<int>(window.getWidth());
+    const unsigned span = x1 - x0;
+    const size_t tileWidth = span + 2 * _radius;
+    const size_t tileDepth = (z1 - z0) + 2 * _radius;
+    vector<float> tile(tileWidth * tileDepth);
+    for (size_t tz = 0; tz < tileDepth; tz++) {
+        const int z = min(
+            max(static_cast<int>(z0 + tz) - radius, 0),
+            static_cast<int>(depth) - 1
+        );
+        const float* row = window.getData() +
+            static_cast<size_t>(z - static_cast<int>(firstRow)) * width;
+        float* dst = tile.data() + tz * tileWidth;
+        for (size_t tx = 0; tx < tileWidth; tx++) {
+            const int x = min(
+                max(static_cast<int>(x0 + tx) - radius, 0), width - 1
+            );
+            dst[tx] = row[x];
+        }
+    }
+
+    /* NOTE(jan): The slopes are swept a row at a time, one direction and
+     * one step at a time, so the inner loops run along contiguous
+     * memory. */
+    vector<float> steepest(span);
+    vector<float> hidden(span);
+    const float weight = 1.f / DIRECTION_COUNT;
+    for (unsigned z = z0; z < z1; z++) {
+        const float* centre =
+            tile.data() + (z - z0 + _radius) * tileWidth + _radius;
+        std::fill(hidden.begin(), hidden.end(), 0.f);
+
+        for (const auto& direction: DIRECTIONS) {
+            const int dx = direction[0];
+            const int dz = direction[1];
+            const float length =
+                std::sqrt(static_cast<float>(dx * dx + dz * dz));
+            std::fill(steepest.begin(), steepest.end(), 0.f);
+
+            for (int step = 1; step <= radius; step++) {
+                const float* sample = centre +
+                    static_cast<ptrdiff_t>(dz * step) *
+                        static_cast<ptrdiff_t>(tileWidth) +
+                    dx * step;
+                const float inverse = 1.f / (step * length);
+                const simd_float inverses = simd_set1(inverse);
+                unsigned x = 0;
+                for (; x + SIMD_WIDTH <= span; x += SIMD_WIDTH) {
+                    const simd_float rise = simd_sub(
+                        simd_load(sample + x), simd_load(centre + x)
+                    );
+                    simd_store(
+                        steepest.data() + x,
+                        simd_max(simd_load(steepest.data() + x),
+                                 simd_mul(rise, inverses))
+                    );
+                }
+                for (; x < span; x++) {
+                    steepest[x] = max(
+                        steepest[x], (sample[x] - centre[x]) * inverse
+                    );
+                }
+            }
+
+            /* NOTE(jan): sin(atan(s)) = s / sqrt(1 + s^2). */
+            const simd_float ones = simd_set1(1.f);
+            const simd_float weights = simd_set1(weight);
+            unsigned x = 0;
+            for (; x + SIMD_WIDTH <= span; x += SIMD_WIDTH) {
+                const simd_float s = simd_load(steepest.data() + x);
+                const simd_float sine =
+                    simd_div(s, simd_sqrt(simd_madd(s, s, ones)));
+                simd_store(
+                    hidden.data() + x,
+                    simd_madd(sine, weights, simd_load(hidden.data() + x))
+                );
+            }
+            for (; x < span; x++) {
+                const float s = steepest[x];
+                hidden[x] += s / std::sqrt(s * s + 1.f) * weight;
+            }
+        }
+
+        float* dst = out + static_cast<size_t>(z - firstRow) * width + x0;
+        for (unsigned x = 0; x < span; x++) {
+            dst[x] = 1.f - hidden[x];
+        }
+    }
+}
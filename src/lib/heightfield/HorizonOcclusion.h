@@ -0,0 +1,60 @@
+#pragma once
+
+#include "HeightPlane.h"
+
+/**
+  * Bakes an ambient occlusion term for every point of a height plane from
+  * the horizon around it.
+  *
+  * From each point the plane is walked outwards in DIRECTION_COUNT evenly
+  * spread directions, up to radius samples away, keeping the steepest
+  * slope up to any sample seen. The sine of that horizon angle is how much
+  * of the sky is hidden in that direction. Averaged over the directions
+  * and taken from one, what is left is 1 on open ground and drops towards
+  * 0 at the bottom of narrow valleys.
+  *
+  * Directions lie on the grid axes and diagonals, so every sample read is
+  * a grid point and a whole row of points is swept a vector register at a
+  * time. Outside the plane the edge heights are taken to carry on, as in
+  * HeightFilter.
+  */
+class HorizonOcclusion {
+public:
+    /** Directions swept around each point. */
+    static constexpr unsigned DIRECTION_COUNT = 8;
+    /** Samples walked in each direction, unless told otherwise. */
+    static constexpr unsigned DEFAULT_RADIUS = 32;
+
+    /**
+      * Constructor.
+      *
+      * @param radius Samples walked in each direction.
+      */
+    explicit HorizonOcclusion(unsigned radius = DEFAULT_RADIUS);
+
+    /**
+      * Get the amount of samples walked in each direction. This is also
+      * how far the term of a point is changed by a change in height.
+      */
+    unsigned getRadius() const;
+
+    /**
+      * Bake the points in [x0, x1) x [z0, z1) of a plane of which only a
+      * window of rows is at hand. Rectangles that do not overlap may be
+      * baked concurrently.
+      *
+      * @param window Heights of the plane rows starting at firstRow. Must
+      *               include the rows within radius of the rectangle,
+      *               where the plane has them.
+      * @param firstRow Plane row of the first row of window.
+      * @param depth Amount of rows of the whole plane.
+      * @param out Receives the terms, laid out like window.
+      */
+    void bake(const HeightPlane& window, unsigned firstRow, unsigned depth,
+              float* out, unsigned x0, unsigned z0,
+              unsigned x1, unsigned z1) const;
+
+private:
+    /** Samples walked in each direction. */
+    unsigned _radius;
+};
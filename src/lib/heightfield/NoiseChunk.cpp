@@ -0,0 +1,44 @@
+#include "NoiseChunk.h"
+
+#include <stdexcept>
+
+#include "../Hash.h"
+
+using std::runtime_error;
+
+NoiseChunk::
+NoiseChunk(shared_ptr<const FractalNoise> noise, int x0, int z0,
+           unsigned width, unsigned depth) :
+        _noise(noise),
+        _x0(x0),
+        _z0(z0),
+        _width(width),
+        _depth(depth) {
+    if ((width == 0) || (depth == 0)) {
+        throw runtime_error("Noise chunk is empty.");
+    }
+}
+
+unsigned NoiseChunk::
+getWidth() const {
+    return _width;
+}
+
+unsigned NoiseChunk::
+getDepth() const {
+    return _depth;
+}
+
+void NoiseChunk::
+readRow(unsigned z, float* out) const {
+    _noise->evaluate(_x0, _z0 + static_cast<int>(z), _width, 1, out);
+}
+
+uint64_t NoiseChunk::
+hashSource(uint64_t seed) const {
+    uint64_t hash = _noise->hash(seed);
+    hash = hashValue(_x0, hash);
+    hash = hashValue(_z0, hash);
+    hash = hashValue(_width, hash);
+    return hashValue(_depth, hash);
+}
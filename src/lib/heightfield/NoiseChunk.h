@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "FractalNoise.h"
+#include "HeightSource.h"
+
+using std::shared_ptr;
+
+/**
+  * A rectangle of a FractalNoise field, to build a Terrain from. Rows are
+  * generated when they are read, so chunks of an endless world can be
+  * built on demand and only cost memory once meshed.
+  */
+class NoiseChunk : public HeightSource {
+public:
+    /**
+      * Constructor.
+      *
+      * @param noise The field.
+      * @param x0 World x of the first sample of each row.
+      * @param z0 World z of the first row.
+      * @param width Amount of samples per row.
+      * @param depth Amount of rows.
+      */
+    NoiseChunk(shared_ptr<const FractalNoise> noise, int x0, int z0,
+               unsigned width, unsigned depth);
+
+    unsigned getWidth() const override;
+
+    unsigned getDepth() const override;
+
+    void readRow(unsigned z, float* out) const override;
+
+    uint64_t hashSource(uint64_t seed) const override;
+
+private:
+    /** The field. */
+    shared_ptr<const FractalNoise> _noise;
+    /** World x of the first sample of each row. */
+    int _x0;
+    /** World z of the first row. */
+    int _z0;
+    /** Amount of samples per row. */
+    unsigned _width;
+    /** Amount of rows. */
+    unsigned _depth;
+};
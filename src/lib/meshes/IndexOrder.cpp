@@ -0,0 +1,154 @@
+#include "IndexOrder.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+using std::vector;
+
+/** Marks a vertex that is not in the cache. */
+static const size_t NOT_CACHED = std::numeric_limits<size_t>::max();
+
+/**
+  * Pick the vertex to fan around next.
+  *
+  * Prefers the candidate that went into the cache longest ago but will
+  * still be in it after its remaining triangles are emitted. Failing
+  * that, backtracks through recently used vertices, and finally scans
+  * forward for any vertex with triangles left.
+  *
+  * @return The vertex, or vertexCount once every triangle is out.
+  */
+static size_t
+getNextVertex(const vector<uint32_t>& candidates,
+              const vector<uint32_t>& live, const vector<size_t>& stamps,
+              size_t time, unsigned cacheSize, vector<uint32_t>& deadEnds,
+              size_t& cursor) {
+    size_t best = live.size();
+    long bestPriority = -1;
+    for (uint32_t v: candidates) {
+        if (live[v] == 0) {
+            continue;
+        }
+        long priority = 0;
+        if (time - stamps[v] + 2 * live[v] <= cacheSize) {
+            priority = static_cast<long>(time - stamps[v]);
+        }
+        if (priority > bestPriority) {
+            bestPriority = priority;
+            best = v;
+        }
+    }
+    if (best != live.size()) {
+        return best;
+    }
+
+    while (!deadEnds.empty()) {
+        const uint32_t v = deadEnds.back();
+        deadEnds.pop_back();
+        if (live[v] > 0) {
+            return v;
+        }
+    }
+    for (; cursor < live.size(); cursor++) {
+        if (live[cursor] > 0) {
+            return cursor;
+        }
+    }
+    return live.size();
+}
+
+void
+optimizeVertexCache(uint32_t* indices, size_t indexCount,
+                    size_t vertexCount, unsigned cacheSize) {
+    const size_t triangleCount = indexCount / 3;
+
+    /* NOTE(jan): Triangles around each vertex, packed one vertex after the
+     * other. live counts the ones that have not been emitted yet. */
+    vector<uint32_t> live(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++) {
+        live[indices[i]]++;
+    }
+    vector<size_t> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) {
+        offsets[v + 1] = offsets[v] + live[v];
+    }
+    vector<uint32_t> adjacency(offsets[vertexCount]);
+    {
+        vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++) {
+            for (unsigned corner = 0; corner < 3; corner++) {
+                adjacency[fill[indices[t * 3 + corner]]++] =
+                    static_cast<uint32_t>(t);
+            }
+        }
+    }
+
+    /* NOTE(jan): time counts cache misses. A vertex is still cached while
+     * fewer than cacheSize misses happened since it went in. */
+    vector<size_t> stamps(vertexCount, 0);
+    size_t time = cacheSize + 1;
+    vector<bool> emitted(triangleCount, false);
+    vector<uint32_t> output;
+    output.reserve(triangleCount * 3);
+    vector<uint32_t> deadEnds;
+    vector<uint32_t> candidates;
+    size_t cursor = 0;
+
+    size_t fan = getNextVertex(candidates, live, stamps, time, cacheSize,
+                               deadEnds, cursor);
+    while (fan < vertexCount) {
+        candidates.clear();
+        for (size_t a = offsets[fan]; a < offsets[fan + 1]; a++) {
+            const uint32_t t = adjacency[a];
+            if (emitted[t]) {
+                continue;
+            }
+            for (unsigned corner = 0; corner < 3; corner++) {
+                const uint32_t v = indices[t * 3 + corner];
+                output.push_back(v);
+                deadEnds.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - stamps[v] > cacheSize) {
+                    stamps[v] = time++;
+                }
+            }
+            emitted[t] = true;
+        }
+        fan = getNextVertex(candidates, live, stamps, time, cacheSize,
+                            deadEnds, cursor);
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+float
+getAcmr(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+        IndexOrder order, unsigned cacheSize) {
+    vector<size_t> stamps(vertexCount, NOT_CACHED);
+    size_t misses = 0;
+    size_t triangles = 0;
+    size_t run = 0;
+    for (size_t i = 0; i < indexCount; i++) {
+        const uint32_t v = indices[i];
+        if ((order == IndexOrder::STRIPS) && (v == PRIMITIVE_RESTART_INDEX)) {
+            run = 0;
+            continue;
+        }
+        if ((stamps[v] == NOT_CACHED) || (misses - stamps[v] >= cacheSize)) {
+            stamps[v] = misses++;
+        }
+        if (order == IndexOrder::STRIPS) {
+            if (++run >= 3) {
+                triangles++;
+            }
+        } else if (i % 3 == 2) {
+            triangles++;
+        }
+    }
+    if (triangles == 0) {
+        return 0.f;
+    }
+    return static_cast<float>(misses) / static_cast<float>(triangles);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+  * How a mesh lays out its indices.
+  */
+enum class IndexOrder {
+    /** Triangle list, quad after quad in row-major order. */
+    ROWS,
+    /** Triangle list, reordered by optimizeVertexCache(). */
+    CACHE_OPTIMIZED,
+    /**
+      * Triangle strips, one per row of quads, separated by
+      * PRIMITIVE_RESTART_INDEX.
+      */
+    STRIPS,
+};
+
+/** Index that restarts a strip when primitive restart is enabled. */
+static const uint32_t PRIMITIVE_RESTART_INDEX = 0xFFFFFFFF;
+
+/**
+  * Vertices assumed to fit in the post-transform cache. Real caches vary
+  * from around 16 to 32 entries, and orders tuned for a smaller cache
+  * lose little on a bigger one.
+  */
+static const unsigned VERTEX_CACHE_SIZE = 16;
+
+/**
+  * Reorder the triangles of a triangle list so that consecutive triangles
+  * share vertices while they are still in the post-transform cache. The
+  * winding of every triangle is kept.
+  *
+  * Uses Tipsify (Sander et al., "Fast triangle reordering for vertex
+  * locality and reduced overdraw"), which runs in linear time: it fans
+  * out around one vertex at a time and picks the next vertex to fan
+  * around among those that are likely still cached.
+  *
+  * @param indices Triangle list to reorder in place.
+  * @param indexCount Amount of indices, a multiple of three.
+  * @param vertexCount Amount of vertices the indices refer to.
+  * @param cacheSize Amount of vertices to assume the cache holds.
+  */
+void optimizeVertexCache(uint32_t* indices, size_t indexCount,
+                         size_t vertexCount,
+                         unsigned cacheSize = VERTEX_CACHE_SIZE);
+
+/**
+  * Get the average cache miss ratio of an index buffer: the amount of
+  * vertices transformed per triangle drawn, assuming a FIFO post-transform
+  * cache. 0.5 is the best a large regular grid can do, 3 is no reuse at
+  * all.
+  *
+  * @param indices Indices to measure.
+  * @param indexCount Amount of indices.
+  * @param vertexCount Amount of vertices the indices refer to.
+  * @param order How the indices are laid out. Any triangle list order is
+  *              measured the same.
+  * @param cacheSize Amount of vertices to assume the cache holds.
+  */
+float getAcmr(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+              IndexOrder order, unsigned cacheSize = VERTEX_CACHE_SIZE);
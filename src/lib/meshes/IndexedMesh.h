@@ -10,9 +10,9 @@ public:
     virtual unsigned getIndexCount() const;
 
     /**
-     * Get a pointer to the indices.
+     * Write getIndexCount() indices to dst.
      */
-    virtual const unsigned* getIndices() const = 0;
+    virtual void writeIndices(unsigned* dst) const = 0;
 
 protected:
     /**
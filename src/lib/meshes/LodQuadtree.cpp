@@ -0,0 +1,189 @@
+#include "LodQuadtree.h"
+
+#include <algorithm>
+#include <limits>
+
+using std::max;
+using std::min;
+
+/** Share of the way from the range of the level below to its own range
+  * at which a level starts to morph. */
+static const float MORPH_START_RATIO = 0.66f;
+
+LodQuadtree::
+LodQuadtree(const HeightPlane& heights, float range) :
+        _width(heights.getWidth()),
+        _depth(heights.getDepth()) {
+    unsigned width = max(1u, (_width - 1 + LEAF_SIZE - 1) / LEAF_SIZE);
+    unsigned depth = max(1u, (_depth - 1 + LEAF_SIZE - 1) / LEAF_SIZE);
+    while (true) {
+        Level level;
+        level.width = width;
+        level.depth = depth;
+        level.mins.resize(static_cast<size_t>(width) * depth);
+        level.maxs.resize(static_cast<size_t>(width) * depth);
+        _levels.push_back(std::move(level));
+        _ranges.push_back(range);
+        if ((width == 1) && (depth == 1)) {
+            break;
+        }
+        width = (width + 1) / 2;
+        depth = (depth + 1) / 2;
+        range *= 2.f;
+    }
+    for (unsigned l = 0; l < _levels.size(); l++) {
+        buildLevel(heights, l, 0, 0, _levels[l].width, _levels[l].depth);
+    }
+}
+
+void LodQuadtree::
+update(const HeightPlane& heights, unsigned x0, unsigned z0, unsigned x1,
+       unsigned z1) {
+    if ((x0 >= x1) || (z0 >= z1)) {
+        return;
+    }
+    /* NOTE(jan): Neighbouring leaves share the samples on their common
+     * edge, so a sample on one touches both. */
+    x0 = x0 > 0 ? (x0 - 1) / LEAF_SIZE : 0;
+    z0 = z0 > 0 ? (z0 - 1) / LEAF_SIZE : 0;
+    x1 = (x1 - 1) / LEAF_SIZE + 1;
+    z1 = (z1 - 1) / LEAF_SIZE + 1;
+    for (unsigned l = 0; l < _levels.size(); l++) {
+        buildLevel(heights, l, x0, z0, min(x1, _levels[l].width),
+                   min(z1, _levels[l].depth));
+        x0 /= 2;
+        z0 /= 2;
+        x1 = (x1 + 1) / 2;
+        z1 = (z1 + 1) / 2;
+    }
+}
+
+unsigned LodQuadtree::
+getLevelCount() const {
+    return static_cast<unsigned>(_levels.size());
+}
+
+float LodQuadtree::
+getRange(unsigned level) const {
+    if (level + 1 == _levels.size()) {
+        return std::numeric_limits<float>::max();
+    }
+    return _ranges[level];
+}
+
+float LodQuadtree::
+getMorphStart(unsigned level) const {
+    const float below = level > 0 ? _ranges[level - 1] : 0.f;
+    return below + (_ranges[level] - below) * MORPH_START_RATIO;
+}
+
+float LodQuadtree::
+getMorphEnd(unsigned level) const {
+    /* NOTE(jan): The coarsest level is drawn at any distance, and still
+     * morphs at the range it would have had, so that distant ground
+     * stays as coarse as it would be under a bigger tree. */
+    return _ranges[level];
+}
+
+size_t LodQuadtree::
+getMaxSelectionSize() const {
+    /* NOTE(jan): Selected squares do not overlap and are at least as big
+     * as a leaf, quarters included, so there are no more of them than
+     * there are leaves. */
+    return _levels[0].mins.size();
+}
+
+void LodQuadtree::
+select(const vec3& eye, vector<Node>& nodes, vector<Node>& quarters,
+       float maxDistance) const {
+    selectNode(getLevelCount() - 1, 0, 0, eye, maxDistance, nodes, quarters);
+}
+
+void LodQuadtree::
+buildLevel(const HeightPlane& heights, unsigned level, unsigned x0,
+           unsigned z0, unsigned x1, unsigned z1) {
+    Level& current = _levels[level];
+    for (unsigned z = z0; z < z1; z++) {
+        for (unsigned x = x0; x < x1; x++) {
+            float lo = std::numeric_limits<float>::max();
+            float hi = std::numeric_limits<float>::lowest();
+            if (level == 0) {
+                const unsigned sx0 = x * LEAF_SIZE;
+                const unsigned sz0 = z * LEAF_SIZE;
+                const unsigned sx1 = min(sx0 + LEAF_SIZE, _width - 1);
+                const unsigned sz1 = min(sz0 + LEAF_SIZE, _depth - 1);
+                for (unsigned sz = sz0; sz <= sz1; sz++) {
+                    const float* row =
+                        heights.getData() + static_cast<size_t>(sz) * _width;
+                    for (unsigned sx = sx0; sx <= sx1; sx++) {
+                        lo = min(lo, row[sx]);
+                        hi = max(hi, row[sx]);
+                    }
+                }
+            } else {
+                const Level& below = _levels[level - 1];
+                const unsigned cx1 = min(x * 2 + 2, below.width);
+                const unsigned cz1 = min(z * 2 + 2, below.depth);
+                for (unsigned cz = z * 2; cz < cz1; cz++) {
+                    for (unsigned cx = x * 2; cx < cx1; cx++) {
+                        const size_t i =
+                            static_cast<size_t>(cz) * below.width + cx;
+                        lo = min(lo, below.mins[i]);
+                        hi = max(hi, below.maxs[i]);
+                    }
+                }
+            }
+            const size_t i = static_cast<size_t>(z) * current.width + x;
+            current.mins[i] = lo;
+            current.maxs[i] = hi;
+        }
+    }
+}
+
+bool LodQuadtree::
+isInRange(unsigned level, unsigned x, unsigned z, const vec3& eye,
+          float range) const {
+    const Level& current = _levels[level];
+    const size_t i = static_cast<size_t>(z) * current.width + x;
+    const float size = static_cast<float>(LEAF_SIZE << level);
+    const vec3 lo(x * size, current.mins[i], z * size);
+    const vec3 hi(
+        min((x + 1) * size, static_cast<float>(_width - 1)),
+        current.maxs[i],
+        min((z + 1) * size, static_cast<float>(_depth - 1))
+    );
+    const vec3 offset = glm::max(glm::max(lo - eye, eye - hi), vec3(0.f));
+    return glm::dot(offset, offset) <= range * range;
+}
+
+bool LodQuadtree::
+selectNode(unsigned level, unsigned x, unsigned z, const vec3& eye,
+           float maxDistance, vector<Node>& nodes,
+           vector<Node>& quarters) const {
+    /* NOTE(jan): Counts as selected, so no parent draws it instead. */
+    if (!isInRange(level, x, z, eye, maxDistance)) {
+        return true;
+    }
+    if ((level + 1 < _levels.size()) &&
+        !isInRange(level, x, z, eye, _ranges[level])) {
+        return false;
+    }
+    const unsigned size = LEAF_SIZE << level;
+    if ((level == 0) || !isInRange(level, x, z, eye, _ranges[level - 1])) {
+        nodes.push_back({x * size, z * size, size, level});
+        return true;
+    }
+    /* NOTE(jan): Children out of their own range are covered by this
+     * node, as quarters drawn at its level. */
+    const Level& below = _levels[level - 1];
+    const unsigned half = size / 2;
+    for (unsigned cz = z * 2; cz < min(z * 2 + 2, below.depth); cz++) {
+        for (unsigned cx = x * 2; cx < min(x * 2 + 2, below.width); cx++) {
+            if (!selectNode(level - 1, cx, cz, eye, maxDistance, nodes,
+                            quarters)) {
+                quarters.push_back({cx * half, cz * half, half, level});
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <limits>
+#include <vector>
+
+#ifndef NOMINMAX
+# define NOMINMAX
+#endif
+#include <glm/glm.hpp>
+
+#include "../heightfield/HeightPlane.h"
+
+using std::vector;
+
+using glm::vec3;
+
+/**
+  * A quadtree over a plane of heights for continuous distance-dependent
+  * level of detail (CDLOD). Every node is drawn with the same square grid
+  * of LEAF_SIZE quads, so a node one level up has quads twice as wide.
+  * Each level has a range around the camera it is drawn within, twice
+  * that of the level below, so the amount of nodes drawn per level stays
+  * about the same and the amount of triangles grows with the logarithm
+  * of the size of the plane rather than with its area.
+  *
+  * Near the end of its range, a shader slides the odd vertices of a
+  * node's grid onto the grid of the level above, so that a node meets
+  * its coarser neighbours without cracks and the switch between levels
+  * does not pop. getMorphStart() and getMorphEnd() give the distances it
+  * does that between.
+  *
+  * Only the lowest and highest height under each node are kept. Based on
+  * Strugar, "Continuous Distance-Dependent Level of Detail for Rendering
+  * Heightmaps".
+  */
+class LodQuadtree {
+public:
+    /**
+      * A square of the plane selected for drawing.
+      */
+    struct Node {
+        /** Sample the square starts at along x. */
+        unsigned x;
+        /** Sample the square starts at along z. */
+        unsigned z;
+        /** Width of the square, in samples. */
+        unsigned size;
+        /** Level the square is drawn at, 0 being the finest. Quads are
+          * 2^level samples wide. */
+        unsigned level;
+    };
+
+    /** Quads along each side of the grid a node is drawn with. Set to 32,
+      * so that a node of the finest level covers 32x32 samples. */
+    static constexpr unsigned LEAF_SIZE = 32;
+
+    /**
+      * Constructor, builds the tree over a plane. The tree does not keep
+      * the plane.
+      *
+      * @param heights Heights to build over, at least 2x2.
+      * @param range Distance within which the finest level is drawn.
+      *              Should be at least three times LEAF_SIZE, or nodes
+      *              may start to morph next to finer ones.
+      */
+    LodQuadtree(const HeightPlane& heights, float range);
+
+    /**
+      * Refresh the bounds of the nodes over the samples in
+      * [x0, x1) x [z0, z1), after they changed.
+      *
+      * @param heights Heights the tree was built over, as they are now.
+      */
+    void update(const HeightPlane& heights, unsigned x0, unsigned z0,
+                unsigned x1, unsigned z1);
+
+    /**
+      * Get the amount of levels.
+      */
+    unsigned getLevelCount() const;
+
+    /**
+      * Get the distance from the camera within which a level is drawn. The
+      * coarsest level is drawn at any distance.
+      */
+    float getRange(unsigned level) const;
+
+    /**
+      * Get the distance from the camera at which a level starts to morph
+      * into the one above.
+      */
+    float getMorphStart(unsigned level) const;
+
+    /**
+      * Get the distance from the camera at which a level has morphed into
+      * the one above completely.
+      */
+    float getMorphEnd(unsigned level) const;
+
+    /**
+      * Get the most squares select() can return in total.
+      */
+    size_t getMaxSelectionSize() const;
+
+    /**
+      * Select the squares to draw around a camera. Together they cover
+      * the plane without overlapping.
+      *
+      * @param eye Position of the camera, in heightmap coordinates.
+      * @param nodes Receives whole nodes, to draw with a grid of
+      *              LEAF_SIZE quads per side.
+      * @param quarters Receives quarters of nodes whose other quarters
+      *                 are drawn at a finer level, to draw with a grid of
+      *                 LEAF_SIZE / 2 quads per side.
+      * @param maxDistance Squares entirely further than this from the
+      *                    camera are left out, for when something else
+      *                    draws the distant ground.
+      */
+    void select(const vec3& eye, vector<Node>& nodes,
+                vector<Node>& quarters,
+                float maxDistance =
+                    std::numeric_limits<float>::infinity()) const;
+
+private:
+    /**
+      * Lowest and highest heights under the nodes of one level.
+      */
+    struct Level {
+        /** Nodes per row. */
+        unsigned width;
+        /** Rows of nodes. */
+        unsigned depth;
+        /** Lowest height per node, row-major. */
+        vector<float> mins;
+        /** Highest height per node, row-major. */
+        vector<float> maxs;
+    };
+
+    /**
+      * Compute the bounds of the nodes in [x0, x1) x [z0, z1) of a level,
+      * from the heights for the finest level and from the level below
+      * for the others.
+      */
+    void buildLevel(const HeightPlane& heights, unsigned level,
+                    unsigned x0, unsigned z0, unsigned x1, unsigned z1);
+
+    /**
+      * Get whether any of a node is within a distance of a point.
+      */
+    bool isInRange(unsigned level, unsigned x, unsigned z, const vec3& eye,
+                   float range) const;
+
+    /**
+      * Select a node, or the parts of it that are within the ranges of
+      * finer levels at those levels.
+      *
+      * @return Whether the node is within the range of its level. If not,
+      *         its parent covers it.
+      */
+    bool selectNode(unsigned level, unsigned x, unsigned z, const vec3& eye,
+                    float maxDistance, vector<Node>& nodes,
+                    vector<Node>& quarters) const;
+
+    /** Samples per row of the plane. */
+    unsigned _width;
+    /** Rows of the plane. */
+    unsigned _depth;
+    /** Levels, finest first. The last has a single node. */
+    vector<Level> _levels;
+    /** Range of each level. */
+    vector<float> _ranges;
+};
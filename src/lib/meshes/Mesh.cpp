@@ -7,3 +7,8 @@ Mesh(): _vertexCount(0) {}
 
 Mesh::
 ~Mesh() {}
+
+size_t Mesh::
+getVertexCount() const {
+    return _vertexCount;
+}
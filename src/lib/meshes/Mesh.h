@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+
 class Mesh {
 public:
     /**
@@ -7,6 +9,11 @@ public:
       */
     virtual ~Mesh();
 
+    /**
+      * Get vertex count.
+      */
+    size_t getVertexCount() const;
+
 protected:
     /**
       * Constructor. Protected to prevent instantiation except via subclass.
@@ -0,0 +1,178 @@
+#include "RtinMesher.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using std::max;
+using std::min;
+
+/**
+  * How a triangle lies relative to the plane.
+  */
+enum class Coverage {
+    INSIDE,
+    STRADDLING,
+    OUTSIDE,
+};
+
+/**
+  * Get how a triangle lies relative to a plane of width x depth samples.
+  */
+static Coverage
+getCoverage(unsigned ax, unsigned ay, unsigned bx, unsigned by,
+            unsigned cx, unsigned cy, unsigned width, unsigned depth) {
+    const unsigned lastX = width - 1;
+    const unsigned lastY = depth - 1;
+    if ((max(max(ax, bx), cx) <= lastX) && (max(max(ay, by), cy) <= lastY)) {
+        return Coverage::INSIDE;
+    }
+    if ((min(min(ax, bx), cx) >= lastX) || (min(min(ay, by), cy) >= lastY)) {
+        return Coverage::OUTSIDE;
+    }
+    return Coverage::STRADDLING;
+}
+
+RtinMesher::
+RtinMesher(const HeightPlane& plane, bool lockEdges) :
+        _plane(plane),
+        _lockEdges(lockEdges),
+        _gridSize(3) {
+    const unsigned extent = max(plane.getWidth(), plane.getDepth());
+    while (_gridSize < extent) {
+        _gridSize = 2 * _gridSize - 1;
+    }
+    computeErrors();
+}
+
+unsigned RtinMesher::
+getGridSize() const {
+    return _gridSize;
+}
+
+vector<uint32_t> RtinMesher::
+triangulate(float maxError) const {
+    const unsigned tile = _gridSize - 1;
+    vector<uint32_t> indices;
+    emit(0, 0, tile, tile, tile, 0, maxError, indices);
+    emit(tile, tile, 0, 0, 0, tile, maxError, indices);
+    return indices;
+}
+
+void RtinMesher::
+computeErrors() {
+    const unsigned size = _gridSize;
+    const unsigned tile = size - 1;
+    const size_t triangleCount = static_cast<size_t>(tile) * tile * 2 - 2;
+    const size_t parentCount = triangleCount - static_cast<size_t>(tile) * tile;
+    const unsigned width = _plane.getWidth();
+    const unsigned depth = _plane.getDepth();
+    _errors.assign(static_cast<size_t>(size) * size, 0.f);
+
+    /* NOTE(jan): Triangles are numbered like a binary heap, the two roots
+     * are 2 and 3 and the children of n are 2n and 2n + 1. Walking the
+     * numbers backwards visits every level before the one above it, so
+     * the errors of both triangles sharing a hypotenuse are in before
+     * their parents read them. Each bit of a number below the top one
+     * picks a half on the way down, lowest bit first. */
+    for (size_t i = triangleCount; i-- > 0;) {
+        size_t id = i + 2;
+        unsigned ax = 0, ay = 0, bx = 0, by = 0, cx = 0, cy = 0;
+        if (id & 1) {
+            bx = by = cx = tile;
+        } else {
+            ax = ay = cy = tile;
+        }
+        while ((id >>= 1) > 1) {
+            const unsigned mx = (ax + bx) / 2;
+            const unsigned my = (ay + by) / 2;
+            if (id & 1) {
+                bx = ax; by = ay;
+                ax = cx; ay = cy;
+            } else {
+                ax = bx; ay = by;
+                bx = cx; by = cy;
+            }
+            cx = mx;
+            cy = my;
+        }
+
+        const unsigned mx = (ax + bx) / 2;
+        const unsigned my = (ay + by) / 2;
+        const size_t middle = static_cast<size_t>(my) * size + mx;
+        const Coverage coverage =
+            getCoverage(ax, ay, bx, by, cx, cy, width, depth);
+        if (coverage == Coverage::OUTSIDE) {
+            continue;
+        }
+        if (coverage == Coverage::STRADDLING) {
+            _errors[middle] = std::numeric_limits<float>::infinity();
+            continue;
+        }
+
+        /* NOTE(jan): Every vertex on an edge halves a hypotenuse lying
+         * along that edge. Splitting all of those keeps them, and the
+         * error carries the splits up to the roots. */
+        const bool onEdge =
+            ((ax == bx) && ((ax == 0) || (ax == width - 1))) ||
+            ((ay == by) && ((ay == 0) || (ay == depth - 1)));
+        if (_lockEdges && onEdge) {
+            _errors[middle] = std::numeric_limits<float>::infinity();
+            continue;
+        }
+
+        const float interpolated =
+            (_plane.getHeightAt(ax, ay) + _plane.getHeightAt(bx, by)) / 2.f;
+        float error = std::fabs(interpolated - _plane.getHeightAt(mx, my));
+        if (i < parentCount) {
+            const size_t left =
+                static_cast<size_t>((ay + cy) / 2) * size + (ax + cx) / 2;
+            const size_t right =
+                static_cast<size_t>((by + cy) / 2) * size + (bx + cx) / 2;
+            error = max(error, max(_errors[left], _errors[right]));
+        }
+        _errors[middle] = max(_errors[middle], error);
+    }
+}
+
+void RtinMesher::
+emit(unsigned ax, unsigned ay, unsigned bx, unsigned by,
+     unsigned cx, unsigned cy, float maxError,
+     vector<uint32_t>& indices) const {
+    const unsigned width = _plane.getWidth();
+    const unsigned depth = _plane.getDepth();
+    if (getCoverage(ax, ay, bx, by, cx, cy, width, depth) ==
+            Coverage::OUTSIDE) {
+        return;
+    }
+
+    const unsigned mx = (ax + bx) / 2;
+    const unsigned my = (ay + by) / 2;
+    const unsigned leg = (ax > cx ? ax - cx : cx - ax) +
+                         (ay > cy ? ay - cy : cy - ay);
+    if ((leg > 1) &&
+        (_errors[static_cast<size_t>(my) * _gridSize + mx] > maxError)) {
+        emit(cx, cy, ax, ay, mx, my, maxError, indices);
+        emit(bx, by, cx, cy, mx, my, maxError, indices);
+        return;
+    }
+
+    /* NOTE(jan): Terrain winds (x, z), (x, z + 1), (x + 1, z), which turns
+     * clockwise in the xz plane. */
+    const int cross =
+        (static_cast<int>(bx) - static_cast<int>(ax)) *
+            (static_cast<int>(cy) - static_cast<int>(ay)) -
+        (static_cast<int>(by) - static_cast<int>(ay)) *
+            (static_cast<int>(cx) - static_cast<int>(ax));
+    const uint32_t a = ay * width + ax;
+    const uint32_t b = by * width + bx;
+    const uint32_t c = cy * width + cx;
+    indices.push_back(a);
+    if (cross < 0) {
+        indices.push_back(b);
+        indices.push_back(c);
+    } else {
+        indices.push_back(c);
+        indices.push_back(b);
+    }
+}
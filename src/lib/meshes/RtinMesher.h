@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "../heightfield/HeightPlane.h"
+
+using std::vector;
+
+/**
+  * Triangulates a height plane adaptively as a right-triangulated
+  * irregular network (RTIN): starting from two triangles over the whole
+  * plane, a triangle is split in half across its hypotenuse only while
+  * leaving it whole would be off by more than a given height. Flat areas
+  * end up with a few large triangles and rough ones with small triangles.
+  * The result never has cracks, since every split is mirrored by the
+  * neighbour sharing the hypotenuse.
+  *
+  * The hierarchy is laid over the smallest 2^k + 1 square grid that covers
+  * the plane. Triangles that stick out over the edge of the plane are
+  * always split and those left outside it are dropped, so planes of any
+  * size work. Indices refer to the row-major vertices Terrain writes, so
+  * the vertex buffer stays as it is.
+  *
+  * Based on Mapbox's Martini, which follows Evans et al., "Right-
+  * triangulated irregular networks".
+  */
+class RtinMesher {
+public:
+    /**
+      * Constructor, computes the error of every triangle in the hierarchy.
+      * The mesher keeps the view, so the plane must outlive it.
+      *
+      * @param plane Heights to triangulate, at least 2x2.
+      * @param lockEdges Whether to keep every vertex along the edges of
+      *                  the plane, so that meshes of neighbouring planes
+      *                  that share an edge meet without cracks.
+      */
+    explicit RtinMesher(const HeightPlane& plane, bool lockEdges = false);
+
+    /**
+      * Get the side of the square grid the hierarchy is laid over.
+      */
+    unsigned getGridSize() const;
+
+    /**
+      * Triangulate the plane.
+      *
+      * @param maxError Largest height difference allowed between the
+      *                 triangles and the plane, in height units. Zero
+      *                 keeps every detail of the plane.
+      * @return Triangle list indices, wound like Terrain's.
+      */
+    vector<uint32_t> triangulate(float maxError) const;
+
+private:
+    /**
+      * Fill _errors, finest triangles first so that every triangle can
+      * fold in the errors of its children.
+      */
+    void computeErrors();
+
+    /**
+      * Emit a triangle, or recurse into its two halves if it is too far
+      * off. a and b are the ends of the hypotenuse, c the right angle.
+      */
+    void emit(unsigned ax, unsigned ay, unsigned bx, unsigned by,
+              unsigned cx, unsigned cy, float maxError,
+              vector<uint32_t>& indices) const;
+
+    /** The heights. */
+    HeightPlane _plane;
+    /** Whether the edges of the plane are kept at full resolution. */
+    bool _lockEdges;
+    /** Side of the grid, 2^k + 1. */
+    unsigned _gridSize;
+    /**
+      * Row-major over the grid. For each point, the largest error of the
+      * triangles whose hypotenuse it halves, or of any of their
+      * descendants.
+      */
+    vector<float> _errors;
+};
@@ -1,92 +1,387 @@
 #include "Terrain.h"
 
-Terrain::
-Terrain(string path) :
-        IndexedMesh(),
-        COMPONENTS(3),
-        SMOOTH_PAS_COUNT(5),
-        _vertices(nullptr),
-        _normals(nullptr),
-        _indices(nullptr),
-        _width(0),
-        _depth(0),
-        _maxHeight(0),
-        _terrainWidth(0),
-        _terrainDepth(0),
-        _heightMap(nullptr) {
-    FILE* fp;
-    errno_t fopenCode = fopen_s(&fp, path.c_str(), "rb");
-    if (fopenCode != 0) {
-        char buffer[256];
-        errno_t strerrorCode = strerror_s(buffer, fopenCode);
-        if (strerrorCode != 0) {
-            throw runtime_error(buffer);
-        } else {
-            throw runtime_error("Could not load heightmap at " + path);
+#include <cmath>
+#include <cstring>
+#include <mutex>
+
+#include "../Hash.h"
+#include "../ThreadPool.h"
+
+/** Distance between neighbouring vertices along x. */
+static const float X_DELTA = 1.0f;
+/** Distance between neighbouring vertices along z. */
+static const float Z_DELTA = 1.0f;
+/** Smallest band of rows handed to a worker while building the mesh. */
+static const size_t MIN_BAND_ROWS = 32;
+
+/**
+  * Get how many rows to hand each worker of the pool at once.
+  */
+static size_t
+getBandRows(unsigned depth) {
+    const ThreadPool& pool = ThreadPool::shared();
+    return max<size_t>(MIN_BAND_ROWS, depth / (pool.getThreadCount() * 4));
+}
+
+/**
+  * Grow a rectangle by amount on every side, clamped to the terrain.
+  */
+static Terrain::Rect
+grow(const Terrain::Rect& rect, unsigned amount,
+     unsigned width, unsigned depth) {
+    Terrain::Rect result;
+    result.x0 = rect.x0 > amount ? rect.x0 - amount : 0;
+    result.z0 = rect.z0 > amount ? rect.z0 - amount : 0;
+    result.x1 = min(rect.x1 + amount, width);
+    result.z1 = min(rect.z1 + amount, depth);
+    return result;
+}
+
+/**
+  * Whether two rectangles share any sample.
+  */
+static bool
+overlaps(const Terrain::Rect& a, const Terrain::Rect& b) {
+    return (a.x0 < b.x1) && (b.x0 < a.x1) && (a.z0 < b.z1) && (b.z0 < a.z1);
+}
+
+/**
+  * Get the normal at the given heightmap coordinates, averaged over the
+  * four triangles around it.
+  *
+  * @param window Smoothed heights of the terrain rows from firstRow on.
+  * @param depth Amount of rows of the whole terrain.
+  */
+static vec3
+getNormal(const HeightPlane& window, unsigned firstRow, unsigned depth,
+          unsigned x, unsigned z) {
+    const unsigned width = window.getWidth();
+    /* NOTE(jan): Border vertices lack a full neighbourhood, point them up. */
+    if ((x == 0) || (z == 0) || (x == width - 1) || (z == depth - 1)) {
+        return vec3(0.f, 1.f, 0.f);
+    }
+    const float *mid =
+        window.getData() + static_cast<size_t>(z - firstRow) * width + x;
+    const float m = *mid;
+
+    vec3 v0(0.f, mid[width] - m, Z_DELTA);
+    vec3 v1(X_DELTA, mid[1] - m, 0.f);
+    vec3 v2(-X_DELTA, mid[-1] - m, 0.f);
+    vec3 v3(0.f, mid[-static_cast<ptrdiff_t>(width)] - m, -Z_DELTA);
+
+    vec3 n = normalize(cross(v0, v1));
+    n = n + normalize(cross(v2, v0));
+    n = n + normalize(cross(v3, v2));
+    n = n + normalize(cross(v1, v3));
+    n /= 4;
+    return n;
+}
+
+/**
+  * Pack a unit normal with a positive y into two signed bytes. The normal
+  * is projected onto the octahedron |x| + |y| + |z| = 1, whose upper half
+  * flattens onto the xz plane without folding, so y can be recovered as
+  * 1 - |x| - |z| and neighbouring texels filter into sensible normals.
+  */
+static void
+encodeNormal(const vec3& n, int8_t* dst) {
+    const float scale = 127.f / (std::abs(n.x) + std::abs(n.y) + std::abs(n.z));
+    dst[0] = static_cast<int8_t>(std::lround(n.x * scale));
+    dst[1] = static_cast<int8_t>(std::lround(n.z * scale));
+}
+
+/**
+  * Pack an occlusion term in [0, 1] into an unsigned normalized byte.
+  */
+static uint8_t
+packOcclusion(float occlusion) {
+    const float clamped = min(max(occlusion, 0.f), 1.f);
+    return static_cast<uint8_t>(std::lround(clamped * 255.f));
+}
+
+/**
+  * Write the packed normals in a rectangle, packed row after row.
+  *
+  * @param window Smoothed heights of the terrain rows from firstRow on.
+  * @param depth Amount of rows of the whole terrain.
+  */
+static void
+generateNormalMap(int8_t* dst, const HeightPlane& window, unsigned firstRow,
+                  unsigned depth, const Terrain::Rect& rect) {
+    for (unsigned z = rect.z0; z < rect.z1; z++) {
+        for (unsigned x = rect.x0; x < rect.x1; x++) {
+            encodeNormal(getNormal(window, firstRow, depth, x, z), dst);
+            dst += 2;
         }
-    } else {
-        int width = 0;
-        int height = 0;
-        int channelsInFile = 0;
-        int desiredChannels = 1;
-        _heightMap = stbi_load_from_file(
-            fp,
-            &width,
-            &height,
-            &channelsInFile,
-            desiredChannels
-        );
-        if (_heightMap != NULL) {
-            _width = static_cast<unsigned>(width);
-            _depth = static_cast<unsigned>(height);
-            construct();
-        } else {
-            const char* errorMessage = stbi_failure_reason();
-            throw runtime_error(errorMessage);
+    }
+}
+
+/**
+  * Write the vertices in a rectangle, packed row after row. Reads heights
+  * from around the rectangle.
+  *
+  * @param window Smoothed heights of the terrain rows from firstRow on.
+  * @param occlusion Occlusion terms laid out like window.
+  * @param depth Amount of rows of the whole terrain.
+  */
+static void
+generateVertices(unsigned char *dst, const VertexLayout &layout,
+                 const HeightPlane& window, const float* occlusion,
+                 unsigned firstRow, unsigned depth,
+                 const Terrain::Rect& rect) {
+    const unsigned width = window.getWidth();
+    const float texScaleX = 1.f / max(1u, width - 1);
+    const float texScaleZ = 1.f / max(1u, depth - 1);
+    unsigned char *vertex = dst;
+    for (unsigned z = rect.z0; z < rect.z1; z++) {
+        const size_t offset = static_cast<size_t>(z - firstRow) * width;
+        const float* row = window.getData() + offset;
+        for (unsigned x = rect.x0; x < rect.x1; x++) {
+            /* NOTE(jan): Assemble each attribute locally and copy it out
+             * whole, dst may be uncached memory. */
+            if (layout.position != VertexLayout::ABSENT) {
+                const float position[3] = {x * X_DELTA, row[x], z * Z_DELTA};
+                memcpy(vertex + layout.position, position, sizeof(position));
+            }
+            if (layout.normal != VertexLayout::ABSENT) {
+                const vec3 n = getNormal(window, firstRow, depth, x, z);
+                const float normal[3] = {n.x, n.y, n.z};
+                memcpy(vertex + layout.normal, normal, sizeof(normal));
+            }
+            if (layout.tex != VertexLayout::ABSENT) {
+                const float tex[2] = {x * texScaleX, z * texScaleZ};
+                memcpy(vertex + layout.tex, tex, sizeof(tex));
+            }
+            if (layout.occlusion != VertexLayout::ABSENT) {
+                memcpy(vertex + layout.occlusion, occlusion + offset + x,
+                       sizeof(float));
+            }
+            vertex += layout.stride;
         }
     }
 }
 
+/**
+  * Generate triangle list indices for the quads in rows [z0, z1) of a grid
+  * of vertices.
+  */
+static void
+generateIndices(unsigned *dst, unsigned width, size_t z0, size_t z1) {
+    size_t index = z0 * (width - 1) * 6;
+    for (size_t z = z0; z < z1; z++) {
+        for (unsigned x = 0; x < width - 1; x++) {
+            unsigned i = static_cast<unsigned>(z * width + x);
+
+            /* Top left square. */
+            dst[index++] = i;
+            dst[index++] = i + width;
+            dst[index++] = i + 1;
+
+            /* Bottom right square. */
+            dst[index++] = i + 1;
+            dst[index++] = i + width;
+            dst[index++] = i + 1 + width;
+        }
+    }
+}
+
+/**
+  * Generate a strip for each row of quads in [z0, z1) of a grid of
+  * vertices, with a restart index after each but the last row.
+  */
+static void
+generateStrips(unsigned *dst, unsigned width, unsigned depth,
+               size_t z0, size_t z1) {
+    /* NOTE(jan): Zig-zags down and across, so that the first triangle of
+     * each quad is wound like generateIndices() winds it. Odd triangles of
+     * a strip are flipped by the rasterizer, which keeps the second one
+     * right too. */
+    size_t index = z0 * (width * 2 + 1);
+    for (size_t z = z0; z < z1; z++) {
+        for (unsigned x = 0; x < width; x++) {
+            unsigned i = static_cast<unsigned>(z * width + x);
+            dst[index++] = i;
+            dst[index++] = i + width;
+        }
+        if (z + 1 < depth - 1) {
+            dst[index++] = PRIMITIVE_RESTART_INDEX;
+        }
+    }
+}
+
+Terrain::
+Terrain(string path) :
+        Terrain(std::make_shared<const Heightmap>(path)) {}
+
 Terrain::
-Terrain(const Terrain &rhs) :
+Terrain(shared_ptr<const HeightSource> heightMap) :
         IndexedMesh(),
-        COMPONENTS(3),
-        SMOOTH_PAS_COUNT(5),
-        _vertices(NULL),
-        _normals(NULL),
-        _indices(NULL),
-        _width(rhs._width),
-        _depth(rhs._depth),
+        _heightMap(heightMap),
+        _width(heightMap->getWidth()),
+        _depth(heightMap->getDepth()),
         _maxHeight(0),
         _terrainWidth(0),
-        _terrainDepth(0),
-        _heightMap(rhs._heightMap) {
+        _terrainDepth(0) {
     construct();
 }
 
-const Terrain &Terrain::
-operator=(Terrain &rhs) {
-    if (this != &rhs) {
-        delete[] _vertices;
-        delete[] _normals;
-        delete[] _indices;
+uint64_t Terrain::
+hashParameters(uint64_t seed) {
+    uint64_t hash = hashValue(SMOOTH_PAS_COUNT, seed);
+    hash = hashValue(HEIGHT_SCALE, hash);
+    hash = hashValue(X_DELTA, hash);
+    hash = hashValue(Z_DELTA, hash);
+    hash = hashValue(HorizonOcclusion::DIRECTION_COUNT, hash);
+    return hashValue(getHorizonOcclusion().getRadius(), hash);
+}
 
-/* TODO(jan): This is unsafe. */
-        this->_heightMap = rhs._heightMap;
-        construct();
-    }
+Terrain::
+Terrain(const Terrain& rhs) = default;
 
-    return *this;
+Terrain::
+Terrain(Terrain&& rhs) noexcept = default;
+
+Terrain& Terrain::
+operator=(const Terrain& rhs) = default;
+
+Terrain& Terrain::
+operator=(Terrain&& rhs) noexcept = default;
+
+Terrain::Surface::
+Surface(const Surface& rhs) :
+        heights(rhs.heights),
+        occlusion(rhs.occlusion) {
+    /* NOTE(jan): The pyramid views the heights it was built over, so the
+     * copy's pyramid is pointed at the copied heights. */
+    if (rhs.pyramid) {
+        const HeightPlane& plane = rhs.pyramid->getPlane();
+        pyramid.reset(new HeightPyramid(
+            *rhs.pyramid,
+            HeightPlane(heights.data(), plane.getWidth(), plane.getDepth())
+        ));
+    }
 }
 
 float Terrain::
-getHeightAt(unsigned x, unsigned z) {
-    return getCoord(x, z)[Y];
+getHeightAt(unsigned x, unsigned z) const {
+    return _surface->heights[z * _width + x];
 }
 
 void Terrain::
 setHeight(unsigned x, unsigned z, float height) {
-    getCoord(x, z)[Y] = height;
+    editSourceRow(z)[x] = height;
+    markDirty({x, z, x + 1, z + 1});
+}
+
+void Terrain::
+setHeights(const Rect& rect, const float* heights) {
+    const unsigned span = rect.x1 - rect.x0;
+    for (unsigned z = rect.z0; z < rect.z1; z++) {
+        std::copy(heights, heights + span, editSourceRow(z) + rect.x0);
+        heights += span;
+    }
+    markDirty(rect);
+}
+
+void Terrain::
+applyBrush(float x, float z, float radius, float amount) {
+    if (radius <= 0.f) {
+        return;
+    }
+    const int width = static_cast<int>(_width);
+    const int depth = static_cast<int>(_depth);
+    const int x0 = max(0, static_cast<int>(std::ceil(x - radius)));
+    const int z0 = max(0, static_cast<int>(std::ceil(z - radius)));
+    const int x1 = min(width, static_cast<int>(std::floor(x + radius)) + 1);
+    const int z1 = min(depth, static_cast<int>(std::floor(z + radius)) + 1);
+    if ((x0 >= x1) || (z0 >= z1)) {
+        return;
+    }
+
+    for (int zi = z0; zi < z1; zi++) {
+        float* row = editSourceRow(static_cast<unsigned>(zi));
+        const float dz = zi - z;
+        for (int xi = x0; xi < x1; xi++) {
+            const float dx = xi - x;
+            const float distance = std::sqrt(dx * dx + dz * dz);
+            if (distance >= radius) {
+                continue;
+            }
+            /* NOTE(jan): Smoothstep falloff, so the rim blends in. */
+            const float t = 1.f - distance / radius;
+            row[xi] += amount * t * t * (3.f - 2.f * t);
+        }
+    }
+    markDirty({
+        static_cast<unsigned>(x0), static_cast<unsigned>(z0),
+        static_cast<unsigned>(x1), static_cast<unsigned>(z1)
+    });
+}
+
+bool Terrain::
+isDirty() const {
+    return !_dirty.empty();
+}
+
+vector<Terrain::Rect> Terrain::
+update() {
+    /* NOTE(jan): Smoothing reaches radius samples out from each edit and
+     * the normals one sample further. The occlusion reaches further still,
+     * as far as the horizon is searched. _maxHeight can only grow here, it
+     * is an upper bound once the terrain has been lowered. */
+    const unsigned halo = getSmoothingKernel().getRadius();
+    const HorizonOcclusion& occlusion = getHorizonOcclusion();
+    vector<Rect> changed;
+    if (_dirty.empty()) {
+        return changed;
+    }
+    Surface& surface = editSurface();
+    changed.reserve(_dirty.size());
+    for (const Rect& dirty: _dirty) {
+        const Rect smoothed = grow(dirty, halo, _width, _depth);
+        _maxHeight = max(_maxHeight, smoothHeights(smoothed));
+        surface.pyramid->update(
+            smoothed.x0, smoothed.z0, smoothed.x1, smoothed.z1
+        );
+        changed.push_back(
+            grow(smoothed, occlusion.getRadius(), _width, _depth)
+        );
+    }
+    for (const Rect& rect: changed) {
+        occlusion.bake(
+            getHeightPlane(), 0, _depth, surface.occlusion.data(),
+            rect.x0, rect.z0, rect.x1, rect.z1
+        );
+    }
+    _dirty.clear();
+    return changed;
+}
+
+void Terrain::
+markDirty(Rect rect) {
+    /* NOTE(jan): Rectangles close enough for their changed vertices to
+     * overlap are merged, so update() never writes a vertex twice. */
+    const unsigned reach = 2 * (getSmoothingKernel().getRadius() +
+                                getHorizonOcclusion().getRadius());
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        const Rect reached = grow(rect, reach, _width, _depth);
+        for (size_t i = 0; i < _dirty.size(); i++) {
+            const Rect& other = _dirty[i];
+            if (overlaps(reached, other)) {
+                rect.x0 = min(rect.x0, other.x0);
+                rect.z0 = min(rect.z0, other.z0);
+                rect.x1 = max(rect.x1, other.x1);
+                rect.z1 = max(rect.z1, other.z1);
+                _dirty[i] = _dirty.back();
+                _dirty.pop_back();
+                merged = true;
+                break;
+            }
+        }
+    }
+    _dirty.push_back(rect);
 }
 
 float Terrain::
@@ -104,168 +399,450 @@ getDepth() const {
     return _depth;
 }
 
-float *Terrain::
-getHeightArray() {
-    float *result = new float[_vertexCount];
-    float *v = getCoord(0, 0);
+HeightPlane Terrain::
+getHeightPlane() const {
+    return HeightPlane(_surface->heights.data(), _width, _depth);
+}
 
-    for (unsigned i = 0; i < (unsigned) _vertexCount; i++) {
-        result[i] = v[Y];
-        v += COMPONENTS;
-    }
+HeightHit Terrain::
+castRay(const HeightRay& ray) const {
+    return _surface->pyramid->castRay(ray);
+}
 
-    return result;
+void Terrain::
+castRays(const HeightRay* rays, HeightHit* hits, size_t count) const {
+    _surface->pyramid->castRays(rays, hits, count);
 }
 
-const float *Terrain::
-getPositions() const {
-    return _vertices;
+const HeightPyramid& Terrain::
+getPyramid() const {
+    return *_surface->pyramid;
 }
 
-const float *Terrain::
-getNormals() const {
-    return _normals;
+void Terrain::
+writeHeights(float* dst) const {
+    std::copy(_surface->heights.begin(), _surface->heights.end(), dst);
 }
 
-const unsigned *Terrain::
-getIndices() const {
-    return _indices;
+void Terrain::
+writeVertices(void* dst, const VertexLayout& layout) const {
+    unsigned char* bytes = static_cast<unsigned char*>(dst);
+    ThreadPool::shared().parallelFor(
+        _depth, getBandRows(_depth),
+        [&](size_t z0, size_t z1) {
+            const Rect band = {
+                0, static_cast<unsigned>(z0),
+                _width, static_cast<unsigned>(z1)
+            };
+            generateVertices(bytes + z0 * _width * layout.stride, layout,
+                             getHeightPlane(), _surface->occlusion.data(), 0,
+                             _depth, band);
+        }
+    );
 }
 
 void Terrain::
-construct() {
-    _vertexCount = _width * _depth;
+writeVertices(void* dst, const VertexLayout& layout, const Rect& rect) const {
+    generateVertices(static_cast<unsigned char*>(dst), layout,
+                     getHeightPlane(), _surface->occlusion.data(), 0, _depth,
+                     rect);
+}
+
+void Terrain::
+writeVertices(void* dst, const VertexLayout& layout,
+              const HeightPlane& window, const float* occlusion,
+              unsigned firstRow, unsigned depth, const Rect& rect) {
+    generateVertices(static_cast<unsigned char*>(dst), layout,
+                     window, occlusion, firstRow, depth, rect);
+}
+
+void Terrain::
+writeNormalMap(int8_t* dst) const {
+    ThreadPool::shared().parallelFor(
+        _depth, getBandRows(_depth),
+        [&](size_t z0, size_t z1) {
+            const Rect band = {
+                0, static_cast<unsigned>(z0),
+                _width, static_cast<unsigned>(z1)
+            };
+            generateNormalMap(dst + z0 * _width * 2, getHeightPlane(), 0,
+                              _depth, band);
+        }
+    );
+}
 
-    const unsigned SIZE = (unsigned) _vertexCount * COMPONENTS;
-    _vertices = new float[SIZE];
-    _normals = new float[SIZE];
+void Terrain::
+writeNormalMap(int8_t* dst, const Rect& rect) const {
+    generateNormalMap(dst, getHeightPlane(), 0, _depth, rect);
+}
 
-    _indexCount = _vertexCount * 6;
-    _indices = new unsigned[_indexCount];
+void Terrain::
+writeNormalMap(int8_t* dst, const HeightPlane& window, unsigned firstRow,
+               unsigned depth, const Rect& rect) {
+    generateNormalMap(dst, window, firstRow, depth, rect);
+}
+
+void Terrain::
+writeHeightMap(float* dst) const {
+    ThreadPool::shared().parallelFor(
+        _depth, getBandRows(_depth),
+        [&](size_t z0, size_t z1) {
+            const Rect band = {
+                0, static_cast<unsigned>(z0),
+                _width, static_cast<unsigned>(z1)
+            };
+            writeHeightMap(dst + z0 * _width, band);
+        }
+    );
+}
 
-    generateVertices();
-    for (unsigned i = 0; i < SMOOTH_PAS_COUNT; i++) {
-        smoothVertices();
+void Terrain::
+writeHeightMap(float* dst, const Rect& rect) const {
+    const size_t width = rect.x1 - rect.x0;
+    for (unsigned z = rect.z0; z < rect.z1; z++) {
+        const size_t offset = static_cast<size_t>(z) * _width + rect.x0;
+        memcpy(dst, _surface->heights.data() + offset, width * sizeof(float));
+        dst += width;
     }
-    generateNormals();
-    generateIndices();
 }
 
-float *Terrain::
-getCoord(unsigned x, unsigned z) {
-    return _vertices + (z * _width * COMPONENTS) + (x * COMPONENTS);
+void Terrain::
+writeOcclusionMap(uint8_t* dst) const {
+    ThreadPool::shared().parallelFor(
+        _depth, getBandRows(_depth),
+        [&](size_t z0, size_t z1) {
+            const Rect band = {
+                0, static_cast<unsigned>(z0),
+                _width, static_cast<unsigned>(z1)
+            };
+            writeOcclusionMap(dst + z0 * _width, band);
+        }
+    );
 }
 
-float Terrain::
-getPixel(unsigned x, unsigned z) {
-    const unsigned index = z * _width + x;
-    const unsigned char rawPixel = _heightMap[index];
-    const float normalizedPixel = rawPixel / 255.f;
-    return normalizedPixel;
+void Terrain::
+writeOcclusionMap(uint8_t* dst, const Rect& rect) const {
+    for (unsigned z = rect.z0; z < rect.z1; z++) {
+        const size_t offset = static_cast<size_t>(z) * _width;
+        for (unsigned x = rect.x0; x < rect.x1; x++) {
+            *dst++ = packOcclusion(_surface->occlusion[offset + x]);
+        }
+    }
 }
 
 void Terrain::
-generateVertices() {
-    const float Z_DELTA = 1.0f;
-    const float X_DELTA = 1.0f;
-
-    unsigned index = 0;
-    float Zcoord = 0.0f;
-    float Xcoord = 0.0f;
-    for (unsigned z = 0; z < _depth; z++) {
-        Xcoord = 0.0f;
-        for (unsigned x = 0; x < _width; x++) {
-            float height = getPixel(x, z) * 64.f;
-            if (height > _maxHeight) _maxHeight = height;
-            _vertices[index++] = Xcoord;
-            _vertices[index++] = height;
-            _vertices[index++] = Zcoord;
-            Xcoord += X_DELTA;
+copyHeightMap(float* dst, const void* vertices, size_t count,
+              const VertexLayout& layout) {
+    const unsigned char* vertex = static_cast<const unsigned char*>(vertices);
+    for (size_t i = 0; i < count; i++) {
+        memcpy(dst++, vertex + layout.position + sizeof(float),
+               sizeof(float));
+        vertex += layout.stride;
+    }
+}
+
+void Terrain::
+copyOcclusionMap(uint8_t* dst, const void* vertices, size_t count,
+                 const VertexLayout& layout) {
+    const unsigned char* vertex = static_cast<const unsigned char*>(vertices);
+    for (size_t i = 0; i < count; i++) {
+        float occlusion;
+        memcpy(&occlusion, vertex + layout.occlusion, sizeof(float));
+        *dst++ = packOcclusion(occlusion);
+        vertex += layout.stride;
+    }
+}
+
+void Terrain::
+writeIndices(unsigned* dst) const {
+    writeGridIndices(dst, _width, _depth, IndexOrder::ROWS);
+}
+
+unsigned Terrain::
+getIndexCount(IndexOrder order) const {
+    return getGridIndexCount(_width, _depth, order);
+}
+
+void Terrain::
+writeIndices(unsigned* dst, IndexOrder order) const {
+    writeGridIndices(dst, _width, _depth, order);
+}
+
+unsigned Terrain::
+getGridIndexCount(unsigned width, unsigned depth, IndexOrder order) {
+    if (order == IndexOrder::STRIPS) {
+        return (depth - 1) * (width * 2 + 1) - 1;
+    }
+    return (width - 1) * (depth - 1) * 6;
+}
+
+void Terrain::
+writeGridIndices(unsigned* dst, unsigned width, unsigned depth,
+                 IndexOrder order) {
+    ThreadPool& pool = ThreadPool::shared();
+    switch (order) {
+    case IndexOrder::ROWS:
+        pool.parallelFor(
+            depth - 1, getBandRows(depth),
+            [&](size_t z0, size_t z1) {
+                generateIndices(dst, width, z0, z1);
+            }
+        );
+        break;
+    case IndexOrder::CACHE_OPTIMIZED: {
+        /* NOTE(jan): Reordering reads the indices back, which is slow from
+         * write-combined memory. */
+        vector<uint32_t> indices(getGridIndexCount(width, depth, order));
+        writeGridIndices(indices.data(), width, depth, IndexOrder::ROWS);
+        optimizeVertexCache(
+            indices.data(), indices.size(),
+            static_cast<size_t>(width) * depth
+        );
+        memcpy(dst, indices.data(), indices.size() * sizeof(uint32_t));
+        break;
+    }
+    case IndexOrder::STRIPS:
+        pool.parallelFor(
+            depth - 1, getBandRows(depth),
+            [&](size_t z0, size_t z1) {
+                generateStrips(dst, width, depth, z0, z1);
+            }
+        );
+        break;
+    }
+}
+
+vector<Terrain::Chunk> Terrain::
+getChunks() const {
+    return getChunks(getHeightPlane());
+}
+
+vector<Terrain::Chunk> Terrain::
+getChunks(const HeightPlane& heights) {
+    /* NOTE(jan): Chunks overlap by a vertex, so each one spans
+     * CHUNK_SIZE - 1 quads. */
+    const unsigned width = heights.getWidth();
+    const unsigned depth = heights.getDepth();
+    const unsigned span = CHUNK_SIZE - 1;
+    const unsigned countX = max(1u, (width - 1 + span - 1) / span);
+    const unsigned countZ = max(1u, (depth - 1 + span - 1) / span);
+    vector<Chunk> chunks;
+    chunks.reserve(static_cast<size_t>(countX) * countZ);
+    for (unsigned cz = 0; cz < countZ; cz++) {
+        for (unsigned cx = 0; cx < countX; cx++) {
+            Chunk chunk;
+            chunk.rect.x0 = cx * span;
+            chunk.rect.z0 = cz * span;
+            chunk.rect.x1 = min(chunk.rect.x0 + CHUNK_SIZE, width);
+            chunk.rect.z1 = min(chunk.rect.z0 + CHUNK_SIZE, depth);
+            chunk.firstVertex =
+                static_cast<uint32_t>(chunks.size()) * CHUNK_VERTEX_COUNT;
+
+            float low = heights.getHeightAt(chunk.rect.x0, chunk.rect.z0);
+            float high = low;
+            for (unsigned z = chunk.rect.z0; z < chunk.rect.z1; z++) {
+                const float* row =
+                    heights.getData() + static_cast<size_t>(z) * width;
+                for (unsigned x = chunk.rect.x0; x < chunk.rect.x1; x++) {
+                    low = min(low, row[x]);
+                    high = max(high, row[x]);
+                }
+            }
+            chunk.minBounds = vec3(
+                chunk.rect.x0 * X_DELTA, low, chunk.rect.z0 * Z_DELTA
+            );
+            chunk.maxBounds = vec3(
+                (chunk.rect.x1 - 1) * X_DELTA, high,
+                (chunk.rect.z1 - 1) * Z_DELTA
+            );
+            chunks.push_back(chunk);
         }
-        Zcoord += Z_DELTA;
     }
-    _terrainDepth = Zcoord;
-    _terrainWidth = Xcoord;
+    return chunks;
 }
 
 void Terrain::
-generateNormals() {
-    for (unsigned z = 1; z < _depth - 1; z++) {
-        unsigned index = (_width * z + 1) * COMPONENTS;
-        float *mid = _vertices + index;
-        float *top = mid + _width * COMPONENTS;
-        float *left = mid - COMPONENTS;
-        float *right = mid + COMPONENTS;
-        float *bot = mid - _width * COMPONENTS;
-
-        for (unsigned x = 1; x < _width - 1; x++) {
-            vec3 m(mid[X], mid[Y], mid[Z]);
-            vec3 t(top[X], top[Y], top[Z]);
-            vec3 r(right[X], right[Y], right[Z]);
-            vec3 l(left[X], left[Y], left[Z]);
-            vec3 b(bot[X], bot[Y], bot[Z]);
-
-            vec3 v0 = t - m;
-            vec3 v1 = r - m;
-            vec3 n = normalize(cross(v0, v1));
-            vec3 v2 = l - m;
-            n = n + normalize(cross(v2, v0));
-            vec3 v3 = b - m;
-            n = n + normalize(cross(v3, v2));
-            n = n + normalize(cross(v1, v3));
-            n /= 4;
-
-            _normals[index++] = n.x;
-            _normals[index++] = n.y;
-            _normals[index++] = n.z;
-
-            mid += COMPONENTS;
-            top += COMPONENTS;
-            right += COMPONENTS;
-            left += COMPONENTS;
-            bot += COMPONENTS;
+writeChunkHeights(float* dst, const HeightPlane& heights,
+                  const Chunk& chunk) {
+    for (unsigned z = 0; z < CHUNK_SIZE; z++) {
+        const unsigned zi = min(chunk.rect.z0 + z, chunk.rect.z1 - 1);
+        for (unsigned x = 0; x < CHUNK_SIZE; x++) {
+            const unsigned xi = min(chunk.rect.x0 + x, chunk.rect.x1 - 1);
+            *dst++ = heights.getHeightAt(xi, zi);
         }
     }
 }
 
 void Terrain::
-generateIndices() {
-    unsigned index = 0;
-    for (unsigned z = 0; z < _depth - 1; z++) {
-        for (unsigned x = 0; x < _width - 1; x++) {
-            unsigned i = z * _width + x;
+writePackedChunkVertices(PackedVertex* dst, const HeightPlane& heights,
+                         const Chunk& chunk, VertexOrder vertexOrder) {
+    const unsigned width = chunk.rect.x1 - chunk.rect.x0;
+    const unsigned depth = chunk.rect.z1 - chunk.rect.z0;
+    for (uint32_t i: getChunkVertexSequence(vertexOrder)) {
+        const unsigned xi = min(i % CHUNK_SIZE, width - 1);
+        const unsigned zi = min(i / CHUNK_SIZE, depth - 1);
+        PackedVertex vertex;
+        vertex.x = static_cast<uint16_t>(xi);
+        vertex.z = static_cast<uint16_t>(zi);
+        vertex.height =
+            heights.getHeightAt(chunk.rect.x0 + xi, chunk.rect.z0 + zi);
+        *dst++ = vertex;
+    }
+}
 
-            /* Top left square. */
-            _indices[index++] = i;
-            _indices[index++] = i + _width;
-            _indices[index++] = i + 1;
+const vector<uint32_t>& Terrain::
+getChunkVertexSequence(VertexOrder order) {
+    static const vector<uint32_t> rows =
+        getVertexSequence(CHUNK_SIZE, CHUNK_SIZE, VertexOrder::ROWS);
+    static const vector<uint32_t> morton =
+        getVertexSequence(CHUNK_SIZE, CHUNK_SIZE, VertexOrder::MORTON);
+    return order == VertexOrder::MORTON ? morton : rows;
+}
 
-            /* Bottom right square. */
-            _indices[index++] = i + 1;
-            _indices[index++] = i + _width;
-            _indices[index++] = i + 1 + _width;
-        }
+unsigned Terrain::
+getChunkIndexCount(IndexOrder order) {
+    return getGridIndexCount(CHUNK_SIZE, CHUNK_SIZE, order);
+}
+
+void Terrain::
+writeChunkIndices(uint16_t* dst, IndexOrder order, VertexOrder vertexOrder) {
+    vector<uint32_t> indices(getChunkIndexCount(order));
+    writeGridIndices(indices.data(), CHUNK_SIZE, CHUNK_SIZE, order);
+    remapIndices(
+        indices.data(), indices.size(), getChunkVertexSequence(vertexOrder)
+    );
+    for (uint32_t index: indices) {
+        *dst++ = index == PRIMITIVE_RESTART_INDEX
+            ? uint16_t(0xFFFF)
+            : static_cast<uint16_t>(index);
     }
 }
 
 void Terrain::
-smoothVertices() {
-    const unsigned SAMPLE = 4;
-    for (unsigned z = SAMPLE; z < _depth - SAMPLE; z++) {
-        float *t = getCoord(SAMPLE, z + 1);
-        float *m = getCoord(SAMPLE, z);
-        float *b = getCoord(SAMPLE, z - 1);
-
-        for (unsigned x = SAMPLE; x < _width - SAMPLE; x++) {
-            float acc = m[Y] + (m - COMPONENTS)[Y] + (m + COMPONENTS)[Y];
-            acc += t[Y] + (t - COMPONENTS)[Y] + (t + COMPONENTS)[Y];
-            acc += b[Y] + (b - COMPONENTS)[Y] + (b + COMPONENTS)[Y];
-
-            m[Y] = acc / 9;
-
-            t += COMPONENTS;
-            m += COMPONENTS;
-            b += COMPONENTS;
+construct() {
+    _vertexCount = _width * _depth;
+    _indexCount = (_width - 1) * (_depth - 1) * 6;
+
+    _terrainWidth = _width * X_DELTA;
+    _terrainDepth = _depth * Z_DELTA;
+    _maxHeight = 0;
+
+    /* NOTE(jan): The plane is built in bands of rows spread over the pool.
+     * Smoothing reads rows from neighbouring bands, so it waits for the
+     * whole unsmoothed plane. */
+    ThreadPool& pool = ThreadPool::shared();
+    const size_t band = getBandRows(_depth);
+    _source.clear();
+    for (unsigned z = 0; z < _depth; z += SOURCE_BLOCK_ROWS) {
+        const size_t rows = min(SOURCE_BLOCK_ROWS, _depth - z);
+        _source.push_back(std::make_shared<vector<float>>(rows * _width));
+    }
+    _surface = std::make_shared<Surface>();
+    _surface->heights.resize(_vertexCount);
+    _dirty.clear();
+    std::mutex maxHeightMutex;
+
+    pool.parallelFor(_depth, band, [&](size_t z0, size_t z1) {
+        generateHeights(z0, z1);
+    });
+    pool.parallelFor(_depth, band, [&](size_t z0, size_t z1) {
+        const Rect rect = {
+            0, static_cast<unsigned>(z0), _width, static_cast<unsigned>(z1)
+        };
+        float bandMax = smoothHeights(rect);
+        std::lock_guard<std::mutex> lock(maxHeightMutex);
+        _maxHeight = max(_maxHeight, bandMax);
+    });
+
+    _surface->occlusion.resize(_vertexCount);
+    pool.parallelFor(_depth, band, [&](size_t z0, size_t z1) {
+        getHorizonOcclusion().bake(
+            getHeightPlane(), 0, _depth, _surface->occlusion.data(),
+            0, static_cast<unsigned>(z0), _width, static_cast<unsigned>(z1)
+        );
+    });
+
+    _surface->pyramid.reset(new HeightPyramid(getHeightPlane()));
+}
+
+float* Terrain::
+editSourceRow(unsigned z) {
+    shared_ptr<vector<float>>& block = _source[z / SOURCE_BLOCK_ROWS];
+    if (block.use_count() > 1) {
+        block = std::make_shared<vector<float>>(*block);
+    }
+    const size_t row = z % SOURCE_BLOCK_ROWS;
+    return block->data() + row * _width;
+}
+
+const float* Terrain::
+getSourceRow(unsigned z) const {
+    const size_t row = z % SOURCE_BLOCK_ROWS;
+    return _source[z / SOURCE_BLOCK_ROWS]->data() + row * _width;
+}
+
+Terrain::Surface& Terrain::
+editSurface() {
+    if (_surface.use_count() > 1) {
+        _surface = std::make_shared<Surface>(*_surface);
+    }
+    return *_surface;
+}
+
+const Kernel& Terrain::
+getSmoothingKernel() {
+    /* NOTE(jan): SMOOTH_PAS_COUNT 3x3 box filters collapse into a single
+     * separable kernel, so the plane is only swept once. */
+    static const Kernel kernel = Kernel::box(1).repeat(SMOOTH_PAS_COUNT);
+    return kernel;
+}
+
+const HorizonOcclusion& Terrain::
+getHorizonOcclusion() {
+    static const HorizonOcclusion occlusion;
+    return occlusion;
+}
+
+void Terrain::
+generateHeights(size_t z0, size_t z1) {
+    for (size_t z = z0; z < z1; z++) {
+        float *row = editSourceRow(static_cast<unsigned>(z));
+        _heightMap->readRow(static_cast<unsigned>(z), row);
+        for (unsigned x = 0; x < _width; x++) {
+            row[x] *= HEIGHT_SCALE;
+        }
+    }
+}
+
+float Terrain::
+smoothHeights(const Rect& rect) {
+    /* NOTE(jan): The filter reads a contiguous plane, so the rows it
+     * needs are gathered out of their blocks first. The window only stops
+     * short of the halo at the edges of the terrain, where the filter
+     * clamps anyway, so smoothing it matches smoothing the whole plane. */
+    const unsigned radius = getSmoothingKernel().getRadius();
+    const unsigned z0 = rect.z0 > radius ? rect.z0 - radius : 0;
+    const unsigned z1 = min(rect.z1 + radius, _depth);
+    vector<float> window(static_cast<size_t>(z1 - z0) * _width);
+    for (unsigned z = z0; z < z1; z++) {
+        const float* row = getSourceRow(z);
+        std::copy(row, row + _width,
+                  window.begin() + static_cast<size_t>(z - z0) * _width);
+    }
+    HeightFilter filter(_width, z1 - z0);
+    filter.convolve(
+        window.data(),
+        _surface->heights.data() + static_cast<size_t>(z0) * _width,
+        getSmoothingKernel(), rect.x0, rect.z0 - z0, rect.x1, rect.z1 - z0
+    );
+
+    float maxHeight = 0;
+    for (unsigned z = rect.z0; z < rect.z1; z++) {
+        const float* row =
+            _surface->heights.data() + static_cast<size_t>(z) * _width;
+        for (unsigned x = rect.x0; x < rect.x1; x++) {
+            maxHeight = max(maxHeight, row[x]);
         }
     }
+    return maxHeight;
 }
@@ -1,8 +1,9 @@
 #pragma once
 
+#include <cstdint>
+#include <memory>
 #include <string>
-
-#include <stb_image.h>
+#include <vector>
 
 #ifndef NOMINMAX
 # define NOMINMAX
@@ -12,22 +13,103 @@
 #include "easylogging++.h"
 
 #include "../Constants.h"
+#include "../heightfield/HeightFilter.h"
+#include "../heightfield/HeightPlane.h"
+#include "../heightfield/HeightPyramid.h"
+#include "../heightfield/HeightSource.h"
+#include "../heightfield/Heightmap.h"
+#include "../heightfield/HorizonOcclusion.h"
+#include "IndexOrder.h"
 #include "IndexedMesh.h"
+#include "VertexLayout.h"
+#include "VertexOrder.h"
 
 using std::max;
 using std::min;
 using std::string;
 using std::runtime_error;
+using std::shared_ptr;
+using std::unique_ptr;
+using std::vector;
 
 using glm::cross;
 using glm::normalize;
 using glm::vec3;
 
 /**
-  * Encapsulates a terrain mesh generated from a greyscale height map.
+  * Encapsulates a terrain mesh generated from a greyscale height map, see
+  * Heightmap for the supported formats, or from any other HeightSource
+  * such as a NoiseChunk.
+  *
+  * Only the heights are kept, before and after smoothing, along with an
+  * ambient occlusion term per vertex baked from them. Vertices and
+  * indices are produced on demand by writeVertices() and writeIndices(),
+  * normally straight into mapped staging memory, so the mesh never exists
+  * twice on the host.
+  *
+  * Edits go to the unsmoothed heights and mark a rectangle dirty.
+  * update() then re-smooths and re-bakes only the dirty rectangles and
+  * their halo and reports which vertices changed, so that only those have to be written
+  * out again.
+  *
+  * Copies share the heights and everything baked from them until one of
+  * them changes, so copying or passing a terrain by value costs next to
+  * nothing. The first edit of a copy clones only the blocks of
+  * unsmoothed rows it touches, and the first update() after it clones the
+  * smoothed heights and what is baked from them.
   */
 class Terrain : public IndexedMesh {
 public:
+    /**
+      * A half-open rectangle of heightmap coordinates, [x0, x1) x [z0, z1).
+      */
+    struct Rect {
+        unsigned x0;
+        unsigned z0;
+        unsigned x1;
+        unsigned z1;
+    };
+
+    /**
+      * A square piece of the terrain that can be drawn, culled or
+      * triangulated on its own. Neighbouring chunks share the vertices
+      * along their common edge.
+      */
+    struct Chunk {
+        /** Vertices of the terrain the chunk covers, at most CHUNK_SIZE
+          * along each side. */
+        Rect rect;
+        /** Lowest corner of the bounding box, in model space. */
+        vec3 minBounds;
+        /** Highest corner of the bounding box, in model space. */
+        vec3 maxBounds;
+        /** First of the chunk's CHUNK_VERTEX_COUNT vertices in a chunked
+          * vertex buffer. */
+        uint32_t firstVertex;
+    };
+
+    /**
+      * A vertex of a chunk packed for drawing, 8 bytes against the 24 of
+      * a position, texture coordinate and occlusion term in floats. Its
+      * place is counted from the corner of its chunk, and its texture
+      * coordinate follows from that. Normals and occlusion come from the
+      * maps written by writeNormalMap() and writeOcclusionMap().
+      */
+    struct PackedVertex {
+        /** Column within the chunk. */
+        uint16_t x;
+        /** Row within the chunk. */
+        uint16_t z;
+        /** Smoothed height. */
+        float height;
+    };
+
+    /** Vertices along each side of a chunk, 2^6 + 1 so that a chunk has
+      * the shape an RtinMesher works on. */
+    static constexpr unsigned CHUNK_SIZE = 65;
+    /** Vertices each chunk takes up in a chunked vertex buffer. */
+    static constexpr unsigned CHUNK_VERTEX_COUNT = CHUNK_SIZE * CHUNK_SIZE;
+
     /**
       * Constructor, creates the mesh.
       *
@@ -36,30 +118,117 @@ public:
     Terrain(string path);
 
     /**
-      * Copy constructor.
+      * Constructor, creates the mesh from an already opened height map or
+      * another source of heights.
+      *
+      * @param heightMap Source of the heights.
+      */
+    Terrain(shared_ptr<const HeightSource> heightMap);
+
+    /**
+      * Hash everything besides the height map that shapes the mesh, so
+      * that cooked copies can tell when they have gone stale.
+      *
+      * @param seed Hash to continue from.
+      */
+    static uint64_t hashParameters(uint64_t seed);
+
+    /**
+      * Copy constructor, shares the heights of rhs until either changes.
+      */
+    Terrain(const Terrain& rhs);
+
+    /**
+      * Move constructor. rhs may only be assigned to or destroyed after.
+      */
+    Terrain(Terrain&& rhs) noexcept;
+
+    /**
+      * Assignment operator, shares the heights of rhs until either changes.
       */
-    Terrain(const Terrain &rhs);
+    Terrain& operator=(const Terrain& rhs);
 
     /**
-      * Assignment operator.
+      * Move assignment operator. rhs may only be assigned to or destroyed
+      * after.
       */
-    const Terrain &operator=(Terrain &rhs);
+    Terrain& operator=(Terrain&& rhs) noexcept;
 
     /**
       * Get the height at the given heightmap coordinates.
       */
-    float getHeightAt(unsigned x, unsigned z);
+    float getHeightAt(unsigned x, unsigned z) const;
+
+    /**
+      * Get a view of the smoothed heights, for interpolated and batched
+      * queries. Stays valid until the terrain is destroyed or assigned to,
+      * or until the first update() after the terrain was copied.
+      */
+    HeightPlane getHeightPlane() const;
+
+    /**
+      * Find where a ray first meets the terrain mesh. Terrain coordinates
+      * are heightmap coordinates, so the ray is in model space.
+      */
+    HeightHit castRay(const HeightRay& ray) const;
+
+    /**
+      * Cast many rays at the terrain mesh across the shared pool.
+      *
+      * @param rays Rays to cast.
+      * @param hits Receives one hit per ray.
+      * @param count Amount of rays.
+      */
+    void castRays(const HeightRay* rays, HeightHit* hits, size_t count) const;
 
     /**
-      * Get the height field as a one dimensional array.
+      * Get the pyramid castRay() walks, which is kept up to date by
+      * update().
       */
-    float *getHeightArray();
+    const HeightPyramid& getPyramid() const;
 
     /**
-      * Set the height at the given heightmap coordinates.
+      * Set the height at the given heightmap coordinates, before
+      * smoothing. Takes effect on the next update().
       */
     void setHeight(unsigned x, unsigned z, float height);
 
+    /**
+      * Overwrite the heights in a rectangle, before smoothing. Takes
+      * effect on the next update().
+      *
+      * @param rect Rectangle to write, must lie within the terrain.
+      * @param heights Row-major heights for the rectangle.
+      */
+    void setHeights(const Rect& rect, const float* heights);
+
+    /**
+      * Raise (or, with a negative amount, lower) the terrain under a round
+      * brush with a smooth falloff. Takes effect on the next update().
+      *
+      * @param x Centre of the brush along x, in heightmap coordinates.
+      * @param z Centre of the brush along z, in heightmap coordinates.
+      * @param radius Radius of the brush.
+      * @param amount Height added at the centre of the brush.
+      */
+    void applyBrush(float x, float z, float radius, float amount);
+
+    /**
+      * Whether there are edits waiting for update().
+      */
+    bool isDirty() const;
+
+    /**
+      * Re-smooth the dirty rectangles plus the halo the smoothing kernel
+      * reads, refresh the ray casting pyramid over them and re-bake the
+      * occlusion around them, then forget them.
+      *
+      * @return Rectangles of vertices whose position, normal or occlusion
+      *         changed, ready for writeVertices() and writeNormalMap().
+      *         They do not overlap.
+      */
+    vector<Rect> update();
+
     /**
      * Get the highest height on the terrain.
      */
@@ -76,25 +245,297 @@ public:
     unsigned getDepth() const;
 
     /**
-     * Get a pointer to the positions.
-     */
-    const float* getPositions() const;
+      * Write the smoothed heights to dst in row-major order.
+      *
+      * @param dst Receives getVertexCount() heights.
+      */
+    void writeHeights(float* dst) const;
 
     /**
-     * Get a pointer to the normals.
-     */
-    const float* getNormals() const;
+      * Write every vertex to dst in row-major order. Positions are on a
+      * unit grid, normals are derived from the neighbouring heights,
+      * texture coordinates span [0, 1] over the terrain and the occlusion
+      * term comes from getHorizonOcclusion(). Rows are written
+      * front to back by the workers of the shared pool, and dst is never
+      * read, so it may be write-combined memory.
+      *
+      * @param dst Receives getVertexCount() vertices.
+      * @param layout Where each attribute goes within a vertex.
+      */
+    void writeVertices(void* dst, const VertexLayout& layout) const;
 
     /**
-     * Get a pointer to the indices.
-     */
-    virtual const unsigned* getIndices() const;
+      * Write the vertices in a rectangle to dst, packed row after row.
+      *
+      * @param dst Receives the rectangle's vertices.
+      * @param layout Where each attribute goes within a vertex.
+      * @param rect Rectangle to write, usually from update().
+      */
+    void writeVertices(void* dst, const VertexLayout& layout,
+                       const Rect& rect) const;
+
+    /**
+      * Write the normal of every vertex to dst in row-major order, packed
+      * into two signed normalized bytes for a two channel texture. The
+      * bytes hold x and z of the normal projected onto an octahedron, a
+      * shader gets the normal back as normalize(vec3(x, 1 - |x| - |z|, z)).
+      * Rows are written by the workers of the shared pool and dst is never
+      * read.
+      *
+      * @param dst Receives two bytes for each of getVertexCount() vertices.
+      */
+    void writeNormalMap(int8_t* dst) const;
+
+    /**
+      * Write the packed normals in a rectangle to dst, row after row.
+      *
+      * @param dst Receives two bytes for each vertex of the rectangle.
+      * @param rect Rectangle to write, usually from update().
+      */
+    void writeNormalMap(int8_t* dst, const Rect& rect) const;
+
+    /**
+      * Write the smoothed height of every vertex to dst in row-major
+      * order, for a single channel float texture that shaders place
+      * vertices with. Rows are written by the workers of the shared pool
+      * and dst is never read.
+      *
+      * @param dst Receives a float for each of getVertexCount() vertices.
+      */
+    void writeHeightMap(float* dst) const;
+
+    /**
+      * Write the heights in a rectangle to dst, row after row.
+      *
+      * @param dst Receives a float for each vertex of the rectangle.
+      * @param rect Rectangle to write, usually from update().
+      */
+    void writeHeightMap(float* dst, const Rect& rect) const;
+
+    /**
+      * Write the occlusion term of every vertex to dst in row-major order,
+      * as an unsigned normalized byte for a single channel texture. Rows
+      * are written by the workers of the shared pool and dst is never
+      * read.
+      *
+      * @param dst Receives a byte for each of getVertexCount() vertices.
+      */
+    void writeOcclusionMap(uint8_t* dst) const;
+
+    /**
+      * Write the occlusion terms in a rectangle to dst, row after row.
+      *
+      * @param dst Receives a byte for each vertex of the rectangle.
+      * @param rect Rectangle to write, usually from update().
+      */
+    void writeOcclusionMap(uint8_t* dst, const Rect& rect) const;
+
+    using IndexedMesh::getIndexCount;
+
+    /**
+      * Get the amount of indices writeIndices() writes in an order.
+      */
+    unsigned getIndexCount(IndexOrder order) const;
+
+    /**
+      * Write a triangle list covering the grid, two triangles per quad.
+      */
+    virtual void writeIndices(unsigned* dst) const;
+
+    /**
+      * Write indices covering the grid in an order. dst is never read, so
+      * it may be write-combined memory.
+      *
+      * @param dst Receives getIndexCount(order) indices.
+      * @param order Index order to write in.
+      */
+    void writeIndices(unsigned* dst, IndexOrder order) const;
+
+    /**
+      * Write the vertices in a rectangle of a terrain of which only a
+      * window of rows of smoothed heights is at hand, packed row after
+      * row. Used to build terrains too big to hold at once.
+      *
+      * @param dst Receives the rectangle's vertices.
+      * @param layout Where each attribute goes within a vertex.
+      * @param window Smoothed heights of the terrain rows starting at
+      *               firstRow. Must include the row on either side of
+      *               rect, where the terrain has one.
+      * @param occlusion Ambient occlusion terms laid out like window, for
+      *                  the rows of rect. Only read if layout has them.
+      * @param firstRow Terrain row of the first row of window.
+      * @param depth Amount of rows of the whole terrain.
+      * @param rect Rectangle to write, in terrain coordinates.
+      */
+    static void writeVertices(void* dst, const VertexLayout& layout,
+                              const HeightPlane& window,
+                              const float* occlusion, unsigned firstRow,
+                              unsigned depth, const Rect& rect);
+
+    /**
+      * Write the packed normals in a rectangle of a terrain of which only
+      * a window of rows of smoothed heights is at hand, row after row.
+      *
+      * @param dst Receives two bytes for each vertex of the rectangle.
+      * @param window Smoothed heights of the terrain rows starting at
+      *               firstRow. Must include the row on either side of
+      *               rect, where the terrain has one.
+      * @param firstRow Terrain row of the first row of window.
+      * @param depth Amount of rows of the whole terrain.
+      * @param rect Rectangle to write, in terrain coordinates.
+      */
+    static void writeNormalMap(int8_t* dst, const HeightPlane& window,
+                               unsigned firstRow, unsigned depth,
+                               const Rect& rect);
+
+    /**
+      * Copy the heights out of vertices, such as a TerrainCache's, into the
+      * layout writeHeightMap() writes.
+      *
+      * @param dst Receives a float per vertex.
+      * @param vertices Vertices to copy from.
+      * @param count Amount of vertices.
+      * @param layout Where each attribute is within a vertex. Must have
+      *               positions.
+      */
+    static void copyHeightMap(float* dst, const void* vertices, size_t count,
+                              const VertexLayout& layout);
+
+    /**
+      * Copy the occlusion terms out of vertices into the layout
+      * writeOcclusionMap() writes.
+      *
+      * @param dst Receives a byte per vertex.
+      * @param vertices Vertices to copy from.
+      * @param count Amount of vertices.
+      * @param layout Where each attribute is within a vertex. Must have
+      *               occlusion terms.
+      */
+    static void copyOcclusionMap(uint8_t* dst, const void* vertices,
+                                 size_t count, const VertexLayout& layout);
+
+    /**
+      * Get the amount of indices writeGridIndices() writes.
+      */
+    static unsigned getGridIndexCount(unsigned width, unsigned depth,
+                                      IndexOrder order);
+
+    /**
+      * Write indices covering a row-major grid of vertices in an order,
+      * wound like the terrain. dst is never read.
+      *
+      * @param dst Receives getGridIndexCount() indices.
+      * @param width Amount of vertices per row.
+      * @param depth Amount of rows.
+      * @param order Index order to write in.
+      */
+    static void writeGridIndices(unsigned* dst, unsigned width,
+                                 unsigned depth, IndexOrder order);
+
+    /**
+      * Get the chunks of the terrain, row after row, with their bounds.
+      */
+    vector<Chunk> getChunks() const;
+
+    /**
+      * Get the chunks covering a plane of heights, row after row.
+      *
+      * @param heights Smoothed heights the bounds are taken from.
+      */
+    static vector<Chunk> getChunks(const HeightPlane& heights);
+
+    /**
+      * Write the heights of one chunk to dst as a CHUNK_SIZE square.
+      * Chunks on the far edges that are smaller repeat their last column
+      * and row, which only adds triangles without area.
+      *
+      * @param dst Receives CHUNK_VERTEX_COUNT heights.
+      */
+    static void writeChunkHeights(float* dst, const HeightPlane& heights,
+                                  const Chunk& chunk);
+
+    /**
+      * Write the packed vertices of one chunk to dst as a CHUNK_SIZE
+      * square, padded like writeChunkHeights(). dst is never read.
+      *
+      * @param dst Receives CHUNK_VERTEX_COUNT vertices.
+      * @param heights Smoothed heights of the whole terrain.
+      * @param chunk Chunk to write.
+      * @param vertexOrder Layout of the vertices.
+      */
+    static void writePackedChunkVertices(
+        PackedVertex* dst, const HeightPlane& heights, const Chunk& chunk,
+        VertexOrder vertexOrder = VertexOrder::ROWS
+    );
+
+    /**
+      * Get the layout of a chunk's vertices, see getVertexSequence().
+      * Indices of the CHUNK_SIZE square grid are taken to such a layout
+      * with remapIndices().
+      */
+    static const vector<uint32_t>& getChunkVertexSequence(VertexOrder order);
+
+    /**
+      * Get the amount of indices writeChunkIndices() writes.
+      */
+    static unsigned getChunkIndexCount(IndexOrder order);
+
+    /**
+      * Write 16-bit indices covering one chunk in an order, shared by all
+      * chunks by drawing each with its firstVertex as vertex offset.
+      * Strips are restarted with 0xFFFF.
+      *
+      * @param dst Receives getChunkIndexCount(order) indices.
+      * @param vertexOrder Layout of the vertices the indices point at.
+      */
+    static void writeChunkIndices(
+        uint16_t* dst, IndexOrder order,
+        VertexOrder vertexOrder = VertexOrder::ROWS
+    );
+
+    /**
+      * Get the kernel equivalent to SMOOTH_PAS_COUNT smoothing passes.
+      */
+    static const Kernel& getSmoothingKernel();
+
+    /**
+      * Get the bake that gives each vertex its ambient occlusion term.
+      */
+    static const HorizonOcclusion& getHorizonOcclusion();
+
+    /** Height of a white pixel in the height map. Set to 64. */
+    static constexpr float HEIGHT_SCALE = 64.f;
 
 private:
-    /** How many components each vertex has. Set to 3 for 3d. */
-    const unsigned COMPONENTS;
     /** How many times to smooth the terrain. Set to 5. */
-    const unsigned SMOOTH_PAS_COUNT;
+    static constexpr unsigned SMOOTH_PAS_COUNT = 5;
+    /** Rows of unsmoothed heights shared between copies as one block.
+      * Set to 32. */
+    static constexpr unsigned SOURCE_BLOCK_ROWS = 32;
+
+    /**
+      * Everything baked from the unsmoothed heights, shared between copies.
+      * Unlike the unsmoothed heights it is cloned whole, because the
+      * pyramid, the occlusion bake, the quadtree and the uploads all read
+      * it as contiguous planes.
+      */
+    struct Surface {
+        Surface() = default;
+
+        /**
+          * Copy constructor, gives the copy a pyramid over its own heights.
+          */
+        Surface(const Surface& rhs);
+
+        Surface& operator=(const Surface&) = delete;
+
+        /** Row-major smoothed heights, one per vertex. */
+        vector<float> heights;
+        /** Row-major ambient occlusion terms baked from heights. */
+        vector<float> occlusion;
+        /** Min/max pyramid over heights, for ray casts. */
+        unique_ptr<HeightPyramid> pyramid;
+    };
 
     /**
       * Helper constructor.
@@ -102,38 +543,43 @@ private:
     void construct();
 
     /**
-      * Get the coordinate that corresponds to the given heightmap
-      * coordinates.
+      * Get a row of the unsmoothed heights for writing, cloning its block
+      * first if another copy shares it.
       */
-    float *getCoord(unsigned x, unsigned z);
+    float* editSourceRow(unsigned z);
 
     /**
-     * Get normalized pixel value at the given coordinates.
-     */
-    float getPixel(unsigned x, unsigned z);
+      * Get a row of the unsmoothed heights.
+      */
+    const float* getSourceRow(unsigned z) const;
 
     /**
-      * Generate vertices.
+      * Get the baked surface for writing, cloning it first if another copy
+      * shares it.
       */
-    void generateVertices();
+    Surface& editSurface();
 
     /**
-      * Generate normals.
+      * Fill rows [z0, z1) of _source from the height map.
       */
-    void generateNormals();
+    void generateHeights(size_t z0, size_t z1);
 
     /**
-      * Generate indices.
+      * Smooth a rectangle of _source into the heights of _surface, which
+      * must not be shared. Reads a halo of samples around the rectangle.
+      *
+      * @return The highest height in the rectangle.
       */
-    void generateIndices();
+    float smoothHeights(const Rect& rect);
 
     /**
-      * Smooth out the quantized vertex data.
+      * Remember that a rectangle of _source changed, merging it with any
+      * dirty rectangle it overlaps.
       */
-    void smoothVertices();
+    void markDirty(Rect rect);
 
-    /** Height map image */
-    unsigned char* _heightMap;
+    /** Height map, shared between copies. */
+    shared_ptr<const HeightSource> _heightMap;
     /** Width of the height map image. */
     unsigned _width;
     /** Depth of the height map image. */
@@ -144,10 +590,13 @@ private:
     float _terrainWidth;
     /** Depth of the terrain model. */
     float _terrainDepth;
-    /** The vertices. */
-    float *_vertices;
-    /** The normals. */
-    float *_normals;
-    /** The indices. */
-    unsigned *_indices;
+    /** Row-major heights before smoothing, where edits go, in blocks of
+      * SOURCE_BLOCK_ROWS rows. Each block is shared between copies until
+      * one of them edits a row in it. */
+    vector<shared_ptr<vector<float>>> _source;
+    /** Smoothed heights and what is baked from them. Shared between
+      * copies until one of them is updated. */
+    shared_ptr<Surface> _surface;
+    /** Rectangles of _source edited since the last update(). */
+    vector<Rect> _dirty;
 };
@@ -0,0 +1,236 @@
+#include "TerrainCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "../Hash.h"
+#include "Terrain.h"
+
+using std::runtime_error;
+
+const char TerrainCache::HEADER_MAGIC[4] = {'T', 'R', 'C', 'K'};
+
+/**
+  * Round offset up to the next section boundary.
+  */
+static uint64_t
+alignSection(uint64_t offset) {
+    const uint64_t mask = TerrainCache::SECTION_ALIGNMENT - 1;
+    return (offset + mask) & ~mask;
+}
+
+/**
+  * Hash the build parameters, the layout and the index order on top of the
+  * hash of the source.
+  */
+static uint64_t
+getKey(uint64_t sourceHash, const VertexLayout& layout, IndexOrder order) {
+    uint64_t key = Terrain::hashParameters(sourceHash);
+    key = hashValue(layout.stride, key);
+    key = hashValue(layout.position, key);
+    key = hashValue(layout.normal, key);
+    key = hashValue(layout.tex, key);
+    key = hashValue(layout.occlusion, key);
+    return hashValue(order, key);
+}
+
+TerrainCache::
+TerrainCache(const string& sourcePath, const string& cachePath,
+             const VertexLayout& layout, IndexOrder order) :
+        _data(nullptr),
+        _header(nullptr),
+        _warm(false) {
+    uint64_t sourceHash;
+    {
+        MappedFile source(sourcePath);
+        sourceHash = hashBytes(source.getData(), source.getSize());
+    }
+    const uint64_t key = getKey(sourceHash, layout, order);
+    _warm = open(cachePath, key, layout);
+    if (!_warm) {
+        cook(std::make_shared<const Heightmap>(sourcePath), cachePath, key,
+             layout, order);
+    }
+}
+
+TerrainCache::
+TerrainCache(shared_ptr<const HeightSource> source, const string& cachePath,
+             const VertexLayout& layout, IndexOrder order) :
+        _data(nullptr),
+        _header(nullptr),
+        _warm(false) {
+    const uint64_t key = getKey(source->hashSource(HASH_SEED), layout, order);
+    _warm = open(cachePath, key, layout);
+    if (!_warm) {
+        cook(source, cachePath, key, layout, order);
+    }
+}
+
+bool TerrainCache::
+isWarm() const {
+    return _warm;
+}
+
+unsigned TerrainCache::
+getWidth() const {
+    return _header->width;
+}
+
+unsigned TerrainCache::
+getDepth() const {
+    return _header->depth;
+}
+
+float TerrainCache::
+getHeightAt(unsigned x, unsigned z) const {
+    const float* heights =
+        reinterpret_cast<const float*>(_data + _header->heightsOffset);
+    return heights[z * _header->width + x];
+}
+
+HeightPlane TerrainCache::
+getHeightPlane() const {
+    return HeightPlane(
+        reinterpret_cast<const float*>(_data + _header->heightsOffset),
+        _header->width, _header->depth
+    );
+}
+
+float TerrainCache::
+getMaxHeight() const {
+    return _header->maxBounds[1];
+}
+
+const float* TerrainCache::
+getMinBounds() const {
+    return _header->minBounds;
+}
+
+const float* TerrainCache::
+getMaxBounds() const {
+    return _header->maxBounds;
+}
+
+size_t TerrainCache::
+getVertexCount() const {
+    return static_cast<size_t>(_header->width) * _header->depth;
+}
+
+const void* TerrainCache::
+getVertices() const {
+    return _data + _header->verticesOffset;
+}
+
+size_t TerrainCache::
+getVerticesSize() const {
+    return getVertexCount() * _header->stride;
+}
+
+unsigned TerrainCache::
+getIndexCount() const {
+    return _header->indexCount;
+}
+
+IndexOrder TerrainCache::
+getIndexOrder() const {
+    return static_cast<IndexOrder>(_header->indexOrder);
+}
+
+const uint32_t* TerrainCache::
+getIndices() const {
+    return reinterpret_cast<const uint32_t*>(_data + _header->indicesOffset);
+}
+
+bool TerrainCache::
+open(const string& cachePath, uint64_t key, const VertexLayout& layout) {
+    unique_ptr<MappedFile> file;
+    try {
+        file.reset(new MappedFile(cachePath));
+    } catch (const runtime_error&) {
+        return false;
+    }
+    if (file->getSize() < sizeof(Header)) {
+        return false;
+    }
+
+    const Header* header = reinterpret_cast<const Header*>(file->getData());
+    const uint64_t vertexCount =
+        static_cast<uint64_t>(header->width) * header->depth;
+    if ((memcmp(header->magic, HEADER_MAGIC, sizeof(header->magic)) != 0) ||
+        (header->version != HEADER_VERSION) ||
+        (header->key != key) ||
+        (header->size != file->getSize()) ||
+        (header->stride != layout.stride) ||
+        (header->heightsOffset + vertexCount * sizeof(float) > header->size) ||
+        (header->verticesOffset + vertexCount * header->stride > header->size) ||
+        (header->indicesOffset +
+            uint64_t(header->indexCount) * sizeof(uint32_t) > header->size)) {
+        return false;
+    }
+
+    _file = std::move(file);
+    _data = _file->getData();
+    _header = header;
+    return true;
+}
+
+void TerrainCache::
+cook(shared_ptr<const HeightSource> source, const string& cachePath,
+     uint64_t key, const VertexLayout& layout, IndexOrder order) {
+    Terrain terrain(source);
+
+    Header header = {};
+    memcpy(header.magic, HEADER_MAGIC, sizeof(header.magic));
+    header.version = HEADER_VERSION;
+    header.key = key;
+    header.width = terrain.getWidth();
+    header.depth = terrain.getDepth();
+    header.stride = static_cast<uint32_t>(layout.stride);
+    header.indexCount = terrain.getIndexCount(order);
+    header.indexOrder = static_cast<uint32_t>(order);
+
+    const uint64_t vertexCount = terrain.getVertexCount();
+    header.heightsOffset = alignSection(sizeof(Header));
+    header.verticesOffset =
+        alignSection(header.heightsOffset + vertexCount * sizeof(float));
+    header.indicesOffset =
+        alignSection(header.verticesOffset + vertexCount * layout.stride);
+    header.size =
+        header.indicesOffset + uint64_t(header.indexCount) * sizeof(uint32_t);
+
+    unsigned char* data;
+    try {
+        _file.reset(new MappedFile(
+            MappedFile::create(cachePath, static_cast<size_t>(header.size))
+        ));
+        data = _file->getWritableData();
+    } catch (const runtime_error&) {
+        /* NOTE(jan): Nowhere to cook to, e.g. a read-only directory. Keep
+         * the cooked bytes in memory so that callers see no difference. */
+        _file.reset();
+        _memory.resize(static_cast<size_t>(header.size));
+        data = _memory.data();
+    }
+
+    float* heights = reinterpret_cast<float*>(data + header.heightsOffset);
+    terrain.writeHeights(heights);
+    terrain.writeVertices(data + header.verticesOffset, layout);
+    terrain.writeIndices(
+        reinterpret_cast<uint32_t*>(data + header.indicesOffset), order
+    );
+
+    const float minHeight = *std::min_element(heights, heights + vertexCount);
+    header.minBounds[0] = 0.f;
+    header.minBounds[1] = minHeight;
+    header.minBounds[2] = 0.f;
+    header.maxBounds[0] = static_cast<float>(header.width - 1);
+    header.maxBounds[1] = terrain.getMaxHeight();
+    header.maxBounds[2] = static_cast<float>(header.depth - 1);
+
+    /* NOTE(jan): The header goes in last, so a run that dies half way
+     * through cooking leaves a file that fails the magic check. */
+    memcpy(data, &header, sizeof(header));
+    _data = data;
+    _header = reinterpret_cast<const Header*>(data);
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../MappedFile.h"
+#include "../heightfield/HeightPlane.h"
+#include "../heightfield/HeightSource.h"
+#include "IndexOrder.h"
+#include "VertexLayout.h"
+
+using std::shared_ptr;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+/**
+  * A Terrain cooked into a single binary file, holding the smoothed
+  * heights, interleaved vertices, indices and bounds.
+  *
+  * The file is keyed by a hash of the source height map, the Terrain build
+  * parameters, the vertex layout and the index order. When a matching file
+  * exists it is mapped and nothing is generated, the vertices and indices
+  * are read straight out of the mapping. Otherwise the Terrain is built once and
+  * cooked into the file for the next run.
+  */
+class TerrainCache {
+public:
+    /**
+      * Layout of the header at the start of a cooked file. Sections follow
+      * at their offsets, each aligned to SECTION_ALIGNMENT.
+      */
+    struct Header {
+        /** Set to HEADER_MAGIC. */
+        char magic[4];
+        /** Set to HEADER_VERSION. */
+        uint32_t version;
+        /** Hash of everything the contents were built from. */
+        uint64_t key;
+        /** Size of the whole file in bytes. */
+        uint64_t size;
+        /** Amount of vertices per row. */
+        uint32_t width;
+        /** Amount of rows. */
+        uint32_t depth;
+        /** Size of one vertex in bytes. */
+        uint32_t stride;
+        /** Amount of indices. */
+        uint32_t indexCount;
+        /** IndexOrder the indices are in. */
+        uint32_t indexOrder;
+        /** Lowest corner of the bounding box. */
+        float minBounds[3];
+        /** Highest corner of the bounding box. */
+        float maxBounds[3];
+        /** Offset of the row-major float heights. */
+        uint64_t heightsOffset;
+        /** Offset of the interleaved vertices. */
+        uint64_t verticesOffset;
+        /** Offset of the 32-bit indices. */
+        uint64_t indicesOffset;
+    };
+
+    /** Magic bytes at the start of a cooked file. */
+    static const char HEADER_MAGIC[4];
+    /** Version of the cooked format. */
+    static const uint32_t HEADER_VERSION = 2;
+    /** Alignment of each section within the file. */
+    static const size_t SECTION_ALIGNMENT = 64;
+
+    /**
+      * Constructor, maps the cooked terrain for a height map, cooking it
+      * first if it is missing or stale.
+      *
+      * @param sourcePath Path to the source height map.
+      * @param cachePath Path to the cooked file.
+      * @param layout Layout of the vertices to cook.
+      * @param order Order of the indices to cook.
+      */
+    TerrainCache(const string& sourcePath, const string& cachePath,
+                 const VertexLayout& layout,
+                 IndexOrder order = IndexOrder::ROWS);
+
+    /**
+      * Constructor, maps the cooked terrain for any source of heights,
+      * cooking it first if it is missing or stale. The source is keyed by
+      * HeightSource::hashSource().
+      *
+      * @param source Source of the heights.
+      * @param cachePath Path to the cooked file.
+      * @param layout Layout of the vertices to cook.
+      * @param order Order of the indices to cook.
+      */
+    TerrainCache(shared_ptr<const HeightSource> source,
+                 const string& cachePath, const VertexLayout& layout,
+                 IndexOrder order = IndexOrder::ROWS);
+
+    /**
+      * Whether the cooked file was reused rather than built this run.
+      */
+    bool isWarm() const;
+
+    /**
+      * Get the amount of vertices per row.
+      */
+    unsigned getWidth() const;
+
+    /**
+      * Get the amount of rows.
+      */
+    unsigned getDepth() const;
+
+    /**
+      * Get the height at the given heightmap coordinates.
+      */
+    float getHeightAt(unsigned x, unsigned z) const;
+
+    /**
+      * Get a view of the heights, for interpolated and batched queries.
+      * Stays valid for the lifetime of the cache.
+      */
+    HeightPlane getHeightPlane() const;
+
+    /**
+      * Get the highest height on the terrain.
+      */
+    float getMaxHeight() const;
+
+    /**
+      * Get the lowest corner of the bounding box.
+      */
+    const float* getMinBounds() const;
+
+    /**
+      * Get the highest corner of the bounding box.
+      */
+    const float* getMaxBounds() const;
+
+    /**
+      * Get the amount of vertices.
+      */
+    size_t getVertexCount() const;
+
+    /**
+      * Get the interleaved vertices, in the layout they were cooked with.
+      */
+    const void* getVertices() const;
+
+    /**
+      * Get the size of the vertices in bytes.
+      */
+    size_t getVerticesSize() const;
+
+    /**
+      * Get the amount of indices.
+      */
+    unsigned getIndexCount() const;
+
+    /**
+      * Get the order the indices are in.
+      */
+    IndexOrder getIndexOrder() const;
+
+    /**
+      * Get the indices, a triangle list or strips depending on
+      * getIndexOrder().
+      */
+    const uint32_t* getIndices() const;
+
+private:
+    /**
+      * Map a cooked file, keeping it only if it matches key.
+      *
+      * @return Whether the file was usable.
+      */
+    bool open(const string& cachePath, uint64_t key,
+              const VertexLayout& layout);
+
+    /**
+      * Build the terrain and cook it into cachePath. If the file cannot
+      * be written the cooked bytes are kept in memory instead.
+      */
+    void cook(shared_ptr<const HeightSource> source,
+              const string& cachePath, uint64_t key,
+              const VertexLayout& layout, IndexOrder order);
+
+    /** The cooked file, if one is mapped. */
+    unique_ptr<MappedFile> _file;
+    /** The cooked bytes, if they could not be written out. */
+    vector<unsigned char> _memory;
+    /** Start of the cooked bytes, in _file or _memory. */
+    const unsigned char* _data;
+    /** Header at the start of _data. */
+    const Header* _header;
+    /** Whether the cooked file was reused. */
+    bool _warm;
+};
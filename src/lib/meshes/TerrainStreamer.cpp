@@ -0,0 +1,246 @@
+#include "TerrainStreamer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include "../Hash.h"
+#include "../MappedFile.h"
+#include "../ThreadPool.h"
+#include "../heightfield/HeightFilter.h"
+#include "../heightfield/HeightPlane.h"
+#include "../heightfield/HorizonOcclusion.h"
+#include "Terrain.h"
+#include "TerrainCache.h"
+
+using std::max;
+using std::min;
+using std::runtime_error;
+
+/** Rows handed to a worker at once while loading or writing a strip. */
+static const size_t BAND_ROWS = 32;
+
+/**
+  * Round offset up to the next section boundary.
+  */
+static uint64_t
+alignSection(uint64_t offset) {
+    const uint64_t mask = TerrainCache::SECTION_ALIGNMENT - 1;
+    return (offset + mask) & ~mask;
+}
+
+TerrainStreamer::
+TerrainStreamer(shared_ptr<const HeightSource> heightMap,
+                const VertexLayout& layout, unsigned chunkSize,
+                IndexOrder order) :
+        _heightMap(heightMap),
+        _layout(layout),
+        _chunkSize(max(1u, chunkSize)),
+        _order(order),
+        _width(heightMap->getWidth()),
+        _depth(heightMap->getDepth()),
+        _peakBytes(0) {
+    if ((_width < 2) || (_depth < 2)) {
+        throw runtime_error("Height map is too small to mesh.");
+    }
+    /* NOTE(jan): The source hashes its contents, so editing the heights
+     * in place makes every chunk go stale. */
+    uint64_t key = heightMap->hashSource(HASH_SEED);
+    key = Terrain::hashParameters(key);
+    key = hashValue(layout.stride, key);
+    key = hashValue(layout.position, key);
+    key = hashValue(layout.normal, key);
+    key = hashValue(layout.tex, key);
+    key = hashValue(layout.occlusion, key);
+    key = hashValue(_chunkSize, key);
+    _key = hashValue(order, key);
+}
+
+string TerrainStreamer::
+getChunkPath(const string& prefix, unsigned x, unsigned z) {
+    std::ostringstream path;
+    path << prefix << "." << x << "." << z << ".cooked";
+    return path.str();
+}
+
+unsigned TerrainStreamer::
+getChunkCountX() const {
+    return (_width - 2) / _chunkSize + 1;
+}
+
+unsigned TerrainStreamer::
+getChunkCountZ() const {
+    return (_depth - 2) / _chunkSize + 1;
+}
+
+float TerrainStreamer::
+build(const string& prefix) {
+    /* NOTE(jan): A strip of chunks covers vertex rows [z0, z1]. Normals
+     * read the smoothed row on either side of that, the occlusion bake
+     * the rows up to its radius away, and smoothing reads radius source
+     * rows around those. */
+    const unsigned radius = Terrain::getSmoothingKernel().getRadius();
+    const HorizonOcclusion& occlusion = Terrain::getHorizonOcclusion();
+    const bool occluded = _layout.occlusion != VertexLayout::ABSENT;
+    const unsigned halo = occluded ? max(1u, occlusion.getRadius()) : 1;
+    float maxHeight = 0.f;
+    for (unsigned z = 0; z < getChunkCountZ(); z++) {
+        const unsigned z0 = z * _chunkSize;
+        const unsigned z1 = min(z0 + _chunkSize, _depth - 1);
+        const unsigned smoothZ0 = z0 > halo ? z0 - halo : 0;
+        const unsigned smoothZ1 = min(_depth, z1 + 1 + halo);
+        const unsigned sourceZ0 = smoothZ0 > radius ? smoothZ0 - radius : 0;
+        const unsigned sourceZ1 = min(_depth, smoothZ1 + radius);
+        loadStrip(sourceZ0, sourceZ1, smoothZ0, smoothZ1);
+        if (occluded) {
+            const HeightPlane window(
+                _heights.data(), _width, sourceZ1 - sourceZ0
+            );
+            ThreadPool::shared().parallelFor(
+                z1 + 1 - z0, BAND_ROWS,
+                [&](size_t b0, size_t b1) {
+                    occlusion.bake(
+                        window, sourceZ0, _depth, _occlusion.data(),
+                        0, static_cast<unsigned>(z0 + b0),
+                        _width, static_cast<unsigned>(z0 + b1)
+                    );
+                }
+            );
+        }
+
+        for (unsigned x = 0; x < getChunkCountX(); x++) {
+            maxHeight = max(maxHeight, writeChunk(prefix, x, z, sourceZ0));
+        }
+    }
+    return maxHeight;
+}
+
+size_t TerrainStreamer::
+getPeakBytes() const {
+    return _peakBytes;
+}
+
+void TerrainStreamer::
+loadStrip(unsigned z0, unsigned z1, unsigned smoothZ0, unsigned smoothZ1) {
+    const unsigned rows = z1 - z0;
+    _source.resize(static_cast<size_t>(rows) * _width);
+    _heights.resize(static_cast<size_t>(rows) * _width);
+    if (_layout.occlusion != VertexLayout::ABSENT) {
+        _occlusion.resize(static_cast<size_t>(rows) * _width);
+    }
+    _peakBytes = max(
+        _peakBytes,
+        (_source.capacity() + _heights.capacity() + _occlusion.capacity()) *
+            sizeof(float)
+    );
+
+    ThreadPool& pool = ThreadPool::shared();
+    pool.parallelFor(rows, BAND_ROWS, [&](size_t b0, size_t b1) {
+        for (size_t z = b0; z < b1; z++) {
+            float* row = _source.data() + z * _width;
+            _heightMap->readRow(static_cast<unsigned>(z0 + z), row);
+            for (unsigned x = 0; x < _width; x++) {
+                row[x] *= Terrain::HEIGHT_SCALE;
+            }
+        }
+    });
+
+    /* NOTE(jan): Filtering clamps at the edges of the strip, which only
+     * matches the whole plane where the strip edge is the plane edge.
+     * Everywhere else the rows smoothed are a full radius inside. */
+    const Kernel& kernel = Terrain::getSmoothingKernel();
+    const unsigned first = smoothZ0 - z0;
+    pool.parallelFor(smoothZ1 - smoothZ0, BAND_ROWS,
+                     [&](size_t b0, size_t b1) {
+        HeightFilter filter(_width, rows);
+        filter.convolve(
+            _source.data(), _heights.data(), kernel,
+            0, static_cast<unsigned>(first + b0),
+            _width, static_cast<unsigned>(first + b1)
+        );
+    });
+}
+
+float TerrainStreamer::
+writeChunk(const string& prefix, unsigned x, unsigned z,
+           unsigned firstRow) const {
+    const unsigned x0 = x * _chunkSize;
+    const unsigned x1 = min(x0 + _chunkSize, _width - 1);
+    const unsigned z0 = z * _chunkSize;
+    const unsigned z1 = min(z0 + _chunkSize, _depth - 1);
+
+    TerrainCache::Header header = {};
+    memcpy(header.magic, TerrainCache::HEADER_MAGIC, sizeof(header.magic));
+    header.version = TerrainCache::HEADER_VERSION;
+    header.key = hashValue(z, hashValue(x, _key));
+    header.width = x1 - x0 + 1;
+    header.depth = z1 - z0 + 1;
+    header.stride = static_cast<uint32_t>(_layout.stride);
+    header.indexCount =
+        Terrain::getGridIndexCount(header.width, header.depth, _order);
+    header.indexOrder = static_cast<uint32_t>(_order);
+
+    const uint64_t vertexCount =
+        static_cast<uint64_t>(header.width) * header.depth;
+    header.heightsOffset = alignSection(sizeof(header));
+    header.verticesOffset =
+        alignSection(header.heightsOffset + vertexCount * sizeof(float));
+    header.indicesOffset =
+        alignSection(header.verticesOffset + vertexCount * _layout.stride);
+    header.size =
+        header.indicesOffset + uint64_t(header.indexCount) * sizeof(uint32_t);
+
+    MappedFile file = MappedFile::create(
+        getChunkPath(prefix, x, z), static_cast<size_t>(header.size)
+    );
+    unsigned char* data = file.getWritableData();
+
+    const HeightPlane window(
+        _heights.data(), _width,
+        static_cast<unsigned>(_heights.size() / _width)
+    );
+    float* heights = reinterpret_cast<float*>(data + header.heightsOffset);
+    float minHeight = window.getHeightAt(x0, z0 - firstRow);
+    float maxHeight = minHeight;
+    for (unsigned row = z0; row <= z1; row++) {
+        const float* src = window.getData() +
+            static_cast<size_t>(row - firstRow) * _width + x0;
+        float* dst = heights + static_cast<size_t>(row - z0) * header.width;
+        std::copy(src, src + header.width, dst);
+        const auto bounds = std::minmax_element(src, src + header.width);
+        minHeight = min(minHeight, *bounds.first);
+        maxHeight = max(maxHeight, *bounds.second);
+    }
+
+    unsigned char* vertices = data + header.verticesOffset;
+    const size_t rowPitch = header.width * _layout.stride;
+    ThreadPool::shared().parallelFor(
+        header.depth, BAND_ROWS,
+        [&](size_t b0, size_t b1) {
+            const Terrain::Rect band = {
+                x0, static_cast<unsigned>(z0 + b0),
+                x1 + 1, static_cast<unsigned>(z0 + b1)
+            };
+            Terrain::writeVertices(vertices + b0 * rowPitch, _layout,
+                                   window, _occlusion.data(), firstRow,
+                                   _depth, band);
+        }
+    );
+    Terrain::writeGridIndices(
+        reinterpret_cast<uint32_t*>(data + header.indicesOffset),
+        header.width, header.depth, _order
+    );
+
+    header.minBounds[0] = static_cast<float>(x0);
+    header.minBounds[1] = minHeight;
+    header.minBounds[2] = static_cast<float>(z0);
+    header.maxBounds[0] = static_cast<float>(x1);
+    header.maxBounds[1] = maxHeight;
+    header.maxBounds[2] = static_cast<float>(z1);
+
+    /* NOTE(jan): The header goes in last, so a build that dies half way
+     * through leaves a chunk that fails the magic check. */
+    memcpy(data, &header, sizeof(header));
+    return maxHeight;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../heightfield/HeightSource.h"
+#include "IndexOrder.h"
+#include "VertexLayout.h"
+
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+/**
+  * Builds the Terrain mesh for height maps too big to hold in memory,
+  * cutting it into square chunks that are written to separate files.
+  *
+  * The height map is mapped rather than read, or generated as it is read
+  * for procedural sources, and the mesh is built one strip of chunks at a
+  * time. Only the strip's heights are resident, plus the rows of halo
+  * that smoothing, normals and the occlusion bake read above and below
+  * it. Each chunk is written straight into its own mapped output file, so
+  * peak memory depends on the width of the height map and the chunk size
+  * but not on the depth. The output matches what Terrain builds for the
+  * same height map, cut at chunk boundaries.
+  *
+  * Chunks share their edge vertices with their neighbours. Each file is
+  * laid out like a TerrainCache file, with heights, vertices and indices
+  * local to the chunk, and with bounds in terrain coordinates that give
+  * the chunk's place.
+  */
+class TerrainStreamer {
+public:
+    /** Quads along each side of a chunk, unless told otherwise. */
+    static const unsigned DEFAULT_CHUNK_SIZE = 1024;
+
+    /**
+      * Constructor.
+      *
+      * @param heightMap Source of the heights.
+      * @param layout Layout of the vertices to write.
+      * @param chunkSize Quads along each side of a chunk.
+      * @param order Order of each chunk's indices.
+      */
+    TerrainStreamer(shared_ptr<const HeightSource> heightMap,
+                    const VertexLayout& layout,
+                    unsigned chunkSize = DEFAULT_CHUNK_SIZE,
+                    IndexOrder order = IndexOrder::ROWS);
+
+    /**
+      * Get the path a chunk is written to.
+      *
+      * @param prefix Path prefix passed to build().
+      * @param x Column of the chunk.
+      * @param z Row of the chunk.
+      */
+    static string getChunkPath(const string& prefix, unsigned x, unsigned z);
+
+    /**
+      * Get the amount of chunks along x.
+      */
+    unsigned getChunkCountX() const;
+
+    /**
+      * Get the amount of chunks along z.
+      */
+    unsigned getChunkCountZ() const;
+
+    /**
+      * Build every chunk and write it to getChunkPath().
+      *
+      * @param prefix Path prefix of the chunk files.
+      * @return The highest height on the terrain.
+      */
+    float build(const string& prefix);
+
+    /**
+      * Get the most bytes of heights held at once by build(). Mapped pages
+      * of the input and output files are not counted, the OS can evict
+      * those whenever it needs to.
+      */
+    size_t getPeakBytes() const;
+
+private:
+    /**
+      * Read source rows [z0, z1) into _source and smooth rows
+      * [smoothZ0, smoothZ1) of them into _heights. Sizes _occlusion to
+      * match, if the layout has it.
+      */
+    void loadStrip(unsigned z0, unsigned z1,
+                   unsigned smoothZ0, unsigned smoothZ1);
+
+    /**
+      * Write the chunk at column x of the loaded strip.
+      *
+      * @param prefix Path prefix of the chunk files.
+      * @param x Column of the chunk.
+      * @param z Row of the chunk.
+      * @param firstRow Terrain row of the first row of the strip.
+      * @return The highest height in the chunk.
+      */
+    float writeChunk(const string& prefix, unsigned x, unsigned z,
+                     unsigned firstRow) const;
+
+    /** The height map. */
+    shared_ptr<const HeightSource> _heightMap;
+    /** Layout of the vertices. */
+    VertexLayout _layout;
+    /** Quads along each side of a chunk. */
+    unsigned _chunkSize;
+    /** Order of each chunk's indices. */
+    IndexOrder _order;
+    /** Amount of samples per row. */
+    unsigned _width;
+    /** Amount of rows. */
+    unsigned _depth;
+    /** Hash of everything the chunks are built from. */
+    uint64_t _key;
+    /** Rows of unsmoothed heights of the current strip and its halo. */
+    vector<float> _source;
+    /** The same rows, smoothed where the strip needs them. */
+    vector<float> _heights;
+    /** Occlusion terms of the strip's rows, laid out like _heights. */
+    vector<float> _occlusion;
+    /** Largest size of the strip buffers together, in bytes. */
+    size_t _peakBytes;
+};
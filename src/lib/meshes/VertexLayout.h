@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+  * Describes where a mesh writes each attribute of an interleaved vertex,
+  * so that meshes can fill vertex buffers without knowing the vertex type.
+  */
+struct VertexLayout {
+    /** Marks an attribute the vertex type does not have. */
+    static const size_t ABSENT = static_cast<size_t>(-1);
+
+    /** Distance between consecutive vertices in bytes. */
+    size_t stride;
+    /** Offset of the position, three floats. */
+    size_t position;
+    /** Offset of the normal, three floats. */
+    size_t normal;
+    /** Offset of the texture coordinate, two floats. */
+    size_t tex;
+    /** Offset of the ambient occlusion term, one float. */
+    size_t occlusion;
+};
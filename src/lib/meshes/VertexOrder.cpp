@@ -0,0 +1,56 @@
+#include "VertexOrder.h"
+
+#include <algorithm>
+
+#include "IndexOrder.h"
+
+/**
+  * Spread the low 16 bits of a out to the even bits of the result.
+  */
+static uint32_t
+spreadBits(uint32_t a) {
+    a &= 0x0000FFFF;
+    a = (a | (a << 8)) & 0x00FF00FF;
+    a = (a | (a << 4)) & 0x0F0F0F0F;
+    a = (a | (a << 2)) & 0x33333333;
+    a = (a | (a << 1)) & 0x55555555;
+    return a;
+}
+
+vector<uint32_t>
+getVertexSequence(unsigned width, unsigned depth, VertexOrder order) {
+    const size_t count = static_cast<size_t>(width) * depth;
+    vector<uint32_t> sequence(count);
+    for (size_t i = 0; i < count; i++) {
+        sequence[i] = static_cast<uint32_t>(i);
+    }
+    if (order == VertexOrder::MORTON) {
+        /* NOTE(jan): Grids that are not a power of two along each side
+         * leave gaps in the curve, which sorting closes up. */
+        vector<uint32_t> codes(count);
+        for (size_t i = 0; i < count; i++) {
+            const uint32_t x = static_cast<uint32_t>(i % width);
+            const uint32_t z = static_cast<uint32_t>(i / width);
+            codes[i] = spreadBits(x) | (spreadBits(z) << 1);
+        }
+        std::sort(
+            sequence.begin(), sequence.end(),
+            [&](uint32_t a, uint32_t b) { return codes[a] < codes[b]; }
+        );
+    }
+    return sequence;
+}
+
+void
+remapIndices(uint32_t* indices, size_t indexCount,
+             const vector<uint32_t>& sequence) {
+    vector<uint32_t> places(sequence.size());
+    for (size_t i = 0; i < sequence.size(); i++) {
+        places[sequence[i]] = static_cast<uint32_t>(i);
+    }
+    for (size_t i = 0; i < indexCount; i++) {
+        if (indices[i] != PRIMITIVE_RESTART_INDEX) {
+            indices[i] = places[indices[i]];
+        }
+    }
+}
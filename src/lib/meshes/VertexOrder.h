@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+/**
+  * How a mesh built on a grid lays out its vertices.
+  */
+enum class VertexOrder {
+    /** Row after row. */
+    ROWS,
+    /**
+      * Along a Z-order (Morton) curve, which visits the grid a square
+      * block at a time, so vertices near each other on the grid are near
+      * each other in memory whichever way they are walked.
+      */
+    MORTON,
+};
+
+/**
+  * Get the order a grid's vertices are laid out in.
+  *
+  * @param width Amount of vertices per row.
+  * @param depth Amount of rows.
+  * @param order Layout to get.
+  * @return For every place in the vertex buffer, the row-major index of
+  *         the vertex that goes there.
+  */
+vector<uint32_t> getVertexSequence(unsigned width, unsigned depth,
+                                   VertexOrder order);
+
+/**
+  * Point indices into row-major vertices at the same vertices laid out
+  * along a sequence instead. PRIMITIVE_RESTART_INDEX is left as it is.
+  *
+  * @param indices Indices to remap in place.
+  * @param indexCount Amount of indices.
+  * @param sequence Layout from getVertexSequence().
+  */
+void remapIndices(uint32_t* indices, size_t indexCount,
+                  const vector<uint32_t>& sequence);
@@ -1,14 +1,25 @@
 #include <array>
+#include <atomic>
 #include <chrono>
 #include <filesystem>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <set>
 #include <unordered_map>
 #include <string>
 #include <vector>
 
+#include "lib/ThreadPool.h"
+#include "lib/heightfield/Clipmap.h"
+#include "lib/heightfield/HeightPyramid.h"
+#include "lib/heightfield/NoiseChunk.h"
+#include "lib/meshes/LodQuadtree.h"
+#include "lib/meshes/RtinMesher.h"
 #include "lib/meshes/Terrain.h"
+#include "lib/meshes/TerrainCache.h"
+#include "lib/meshes/VertexOrder.h"
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
@@ -44,6 +55,15 @@ struct MVP {
     glm::mat4 model;
     glm::mat4 view;
     glm::mat4 proj;
+    /* NOTE(jan): Camera position in model space, for shaders that vary
+     * detail with distance. */
+    glm::vec4 eye;
+    /* NOTE(jan): Size of the swap chain images in x and y, for shaders
+     * that measure detail in pixels. */
+    glm::vec4 viewport;
+    /* NOTE(jan): Distance beyond which the ground is ray-marched rather
+     * than drawn as triangles, zero if it never is. */
+    float farField;
 };
 
 struct Scene {
@@ -53,16 +73,125 @@ struct Scene {
     MVP mvp;
     Image grassTexture;
     Image groundTexture;
+    Image groundNormalMap;
+    Image groundHeightMap;
+    Image groundOcclusionMap;
+    Image groundClipmap;
 	Image colour;
     Image depth;
     Image noise;
 };
 
-std::vector<TerrainVertex> groundVertices;
 std::vector<uint32_t> indices;
+/* NOTE(jan): CHUNKS draws every chunk of the ground, in full or
+ * triangulated adaptively. CDLOD draws the nodes of a LodQuadtree picked
+ * around the camera every frame, with detail falling off with distance.
+ * CLIPMAP draws nested rings around the camera straight from the noise
+ * the world is generated from, out to the far plane and beyond the
+ * world's edges, without the smoothing, erosion or edits of the others.
+ * TESSELLATION draws coarse patches that the GPU cuts up by how long
+ * their edges are on screen. */
+enum class GroundRenderer {
+    CHUNKS,
+    CDLOD,
+    CLIPMAP,
+    TESSELLATION,
+};
+const GroundRenderer GROUND_RENDERER = GroundRenderer::CDLOD;
+/* NOTE(jan): Whether the ground's indirect draws start past the first
+ * instance, which needs drawIndirectFirstInstance. CDLOD draws the
+ * quarters' grid from the instances after the whole nodes', and CLIPMAP
+ * and CHUNKS draw each level or chunk from its own instance. */
+const bool GROUND_FIRST_INSTANCE =
+    GROUND_RENDERER != GroundRenderer::TESSELLATION;
+/* NOTE(jan): With CHUNKS, the ground is split into chunks, each with a
+ * square grid of packed vertices of its own in groundBuffer, and drawn as
+ * an instance placed by its corner in groundInstanceBuffer. CDLOD has no
+ * vertices, its shader places them from their index and the height map. */
 Buffer groundBuffer;
+std::vector<Terrain::Chunk> groundChunks;
+/* NOTE(jan): The 16-bit indices of a whole chunk, shared by all of them,
+ * followed by room for an adaptive triangulation of each chunk.
+ * groundDrawBuffer holds an indirect draw per chunk that picks one of the
+ * two and offsets it to the chunk's vertices, so the command buffers stay
+ * as they are when switching. */
 Buffer groundIndexBuffer;
-std::vector<uint32_t> groundIndexVector;
+Buffer groundDrawBuffer;
+uint32_t groundIndexCount;
+/* NOTE(jan): Largest height error allowed for the adaptive triangulation,
+ * zero draws the full grid. */
+const float GROUND_MAX_ERROR = 0.25f;
+/* NOTE(jan): STRIPS draws the full grid as strips, the adaptive
+ * triangulation is a list and cannot share the pipeline with them. */
+const IndexOrder GROUND_INDEX_ORDER = IndexOrder::CACHE_OPTIMIZED;
+/* NOTE(jan): Layout of each chunk's vertices in groundBuffer. MORTON keeps
+ * the vertices a cache-optimized or adaptive chunk reaches for together
+ * in memory, so fewer cache lines are fetched per triangle. Strips walk
+ * the rows in order already, and are better off with ROWS. */
+const VertexOrder GROUND_VERTEX_ORDER = GROUND_INDEX_ORDER == IndexOrder::STRIPS
+    ? VertexOrder::ROWS
+    : VertexOrder::MORTON;
+/* NOTE(jan): Layout of the grass clumps, which are culled and shaded near
+ * their neighbours on the grid. */
+const VertexOrder GRASS_VERTEX_ORDER = VertexOrder::MORTON;
+const bool GROUND_ADAPTIVE =
+    (GROUND_RENDERER == GroundRenderer::CHUNKS) &&
+    (GROUND_MAX_ERROR > 0.f) && (GROUND_INDEX_ORDER != IndexOrder::STRIPS);
+/* NOTE(jan): With CDLOD, groundIndexBuffer holds the indices of the grid
+ * for whole nodes followed by those of the grid of half the resolution
+ * for quarters of nodes, and groundDrawBuffer an indirect draw of each.
+ * groundDrawBuffer and groundInstanceBuffer are host visible and
+ * rewritten with the nodes picked every frame. */
+std::unique_ptr<LodQuadtree> groundLod;
+Buffer groundInstanceBuffer;
+VkDrawIndexedIndirectCommand groundGridDraws[2];
+/* NOTE(jan): Distance within which the ground is drawn at full
+ * resolution. */
+const float GROUND_LOD_RANGE = 3.f * LodQuadtree::LEAF_SIZE;
+/* NOTE(jan): With CDLOD, ground further than GROUND_FAR_FIELD_DISTANCE
+ * from the camera is ray-marched through groundBoundsBuffer by
+ * shaders/farfield, a pixel at a time, instead of drawn as triangles.
+ * groundBoundsBuffer holds the lowest and highest height of every cell of
+ * a HeightPyramid over the ground. Zero draws all of it as triangles. */
+const float GROUND_FAR_FIELD_DISTANCE = 256.f;
+const bool GROUND_FAR_FIELD =
+    (GROUND_RENDERER == GroundRenderer::CDLOD) &&
+    (GROUND_FAR_FIELD_DISTANCE > 0.f);
+Buffer groundBoundsBuffer;
+/* NOTE(jan): With CLIPMAP, groundBuffer holds the grid every level of
+ * groundClipmap is drawn with, and groundIndexBuffer the indices of the
+ * whole grid for the finest level followed by four with a hole in the
+ * middle for the others, one per place the level below can sit in.
+ * groundDrawBuffer holds a draw per level and groundInstanceBuffer an
+ * instance per level, both host visible and rewritten every frame. */
+std::unique_ptr<Clipmap> groundClipmap;
+VkDrawIndexedIndirectCommand groundRingDraws[5];
+/* NOTE(jan): Five levels of 128 quads reach 1024 from the camera, past
+ * the far plane. */
+const unsigned CLIPMAP_LEVEL_COUNT = 5;
+const unsigned CLIPMAP_SIZE = 128;
+/* NOTE(jan): Quads along the edge of each level over which it blends into
+ * the next. */
+const unsigned CLIPMAP_TRANSITION = CLIPMAP_SIZE / 10;
+/* NOTE(jan): With TESSELLATION, groundBuffer holds the corners of square
+ * patches of GROUND_PATCH_SIZE quads and groundIndexBuffer four corners
+ * per patch. A patch is cut into at most 64 pieces along each side, so at
+ * 64 quads no triangle gets smaller than a quad of the height map. */
+const bool GROUND_TESSELLATED = GROUND_RENDERER == GroundRenderer::TESSELLATION;
+const unsigned GROUND_PATCH_SIZE = 64;
+bool groundSculpting = false;
+/* NOTE(jan): The world is generated rather than loaded, so its size is not
+ * tied to an image. */
+const uint32_t WORLD_SEED = 1;
+const unsigned WORLD_SIZE = 1024;
+std::shared_ptr<const HeightSource> world;
+/* NOTE(jan): Built from the world on the first edit, warm starts only have
+ * the cooked copy. */
+std::unique_ptr<Terrain> editableTerrain;
+const float BRUSH_RADIUS = 6.f;
+const float BRUSH_DISTANCE = 10.f;
+const float BRUSH_REACH = 200.f;
+const float BRUSH_RATE = 4.f;
 auto eye = glm::vec3(50.0f, -2.0f, 50.0f);
 auto at = glm::vec3(0.0f, -2.0f, 0.0f);
 auto up = glm::vec3(0.0f, 1.0f, 0.0f);
@@ -99,6 +228,199 @@ debugCallback(
     return VK_FALSE;
 }
 
+/**
+  * Point every chunk's draw at the indices of a whole chunk.
+  */
+void
+drawFullGround(VkDrawIndexedIndirectCommand* draws) {
+    for (size_t c = 0; c < groundChunks.size(); c++) {
+        draws[c] = {};
+        draws[c].indexCount = groundIndexCount;
+        draws[c].instanceCount = 1;
+        draws[c].firstInstance = static_cast<uint32_t>(c);
+        draws[c].vertexOffset =
+            static_cast<int32_t>(groundChunks[c].firstVertex);
+    }
+}
+
+/**
+  * Triangulate every chunk of the ground adaptively into its own range of
+  * groundIndexCount indices and point its draw at them.
+  *
+  * @param heights Smoothed heights of the ground.
+  * @param indices Receives a range of groundIndexCount indices per chunk.
+  * @param draws Receives a draw per chunk.
+  * @return The amount of triangles.
+  */
+size_t
+triangulateGround(const HeightPlane& heights, uint16_t* indices,
+                  VkDrawIndexedIndirectCommand* draws) {
+    std::atomic<size_t> triangleCount(0);
+    ThreadPool::shared().parallelFor(
+        groundChunks.size(), 1,
+        [&](size_t c0, size_t c1) {
+            std::vector<float> chunkHeights(Terrain::CHUNK_VERTEX_COUNT);
+            const HeightPlane plane(
+                chunkHeights.data(), Terrain::CHUNK_SIZE, Terrain::CHUNK_SIZE
+            );
+            for (size_t c = c0; c < c1; c++) {
+                const Terrain::Chunk& chunk = groundChunks[c];
+                Terrain::writeChunkHeights(chunkHeights.data(), heights, chunk);
+                /* NOTE(jan): Chunks are triangulated on their own, so
+                 * their edges are kept whole to meet their neighbours'. */
+                auto triangles =
+                    RtinMesher(plane, true).triangulate(GROUND_MAX_ERROR);
+                if (GROUND_INDEX_ORDER == IndexOrder::CACHE_OPTIMIZED) {
+                    optimizeVertexCache(
+                        triangles.data(), triangles.size(),
+                        Terrain::CHUNK_VERTEX_COUNT
+                    );
+                }
+                remapIndices(
+                    triangles.data(), triangles.size(),
+                    Terrain::getChunkVertexSequence(GROUND_VERTEX_ORDER)
+                );
+                std::copy(triangles.begin(), triangles.end(),
+                          indices + c * groundIndexCount);
+                draws[c] = {};
+                draws[c].indexCount = static_cast<uint32_t>(triangles.size());
+                draws[c].instanceCount = 1;
+                draws[c].firstInstance = static_cast<uint32_t>(c);
+                draws[c].firstIndex =
+                    static_cast<uint32_t>((c + 1) * groundIndexCount);
+                draws[c].vertexOffset = static_cast<int32_t>(chunk.firstVertex);
+                triangleCount += triangles.size() / 3;
+            }
+        }
+    );
+    return triangleCount;
+}
+
+/**
+  * Pick the nodes of the ground's quadtree to draw around the camera, and
+  * point the two grid draws at them.
+  *
+  * @param instances Receives an instance per node, whole nodes first.
+  * @param draws Receives the draws of both grids.
+  * @return The amount of triangles drawn.
+  */
+size_t
+selectGround(LodInstance* instances,
+             VkDrawIndexedIndirectCommand* draws) {
+    static std::vector<LodQuadtree::Node> nodes;
+    static std::vector<LodQuadtree::Node> quarters;
+    nodes.clear();
+    quarters.clear();
+    groundLod->select(
+        eye, nodes, quarters,
+        GROUND_FAR_FIELD
+            ? GROUND_FAR_FIELD_DISTANCE
+            : std::numeric_limits<float>::infinity()
+    );
+
+    size_t i = 0;
+    for (const auto* selection: {&nodes, &quarters}) {
+        for (const auto& node: *selection) {
+            LodInstance& instance = instances[i++];
+            instance.origin = glm::vec2(node.x, node.z);
+            instance.spacing = static_cast<float>(1u << node.level);
+            instance.morph = {
+                groundLod->getMorphStart(node.level),
+                groundLod->getMorphEnd(node.level)
+            };
+        }
+    }
+    draws[0] = groundGridDraws[0];
+    draws[0].instanceCount = static_cast<uint32_t>(nodes.size());
+    draws[1] = groundGridDraws[1];
+    draws[1].instanceCount = static_cast<uint32_t>(quarters.size());
+    draws[1].firstInstance = static_cast<uint32_t>(nodes.size());
+    const size_t quads = LodQuadtree::LEAF_SIZE * LodQuadtree::LEAF_SIZE;
+    return (nodes.size() * quads + quarters.size() * quads / 4) * 2;
+}
+
+/**
+  * Write the indices of a clipmap level's grid of CLIPMAP_SIZE quads per
+  * side, leaving out the middle half that the level below covers.
+  *
+  * @param indices Receives the indices, 16 bits each.
+  * @param holeX First quad of the hole along x, or negative for no hole.
+  * @param holeZ First quad of the hole along z.
+  */
+void
+writeClipmapIndices(std::vector<uint16_t>& indices, int holeX, int holeZ) {
+    const unsigned width = CLIPMAP_SIZE + 1;
+    const int hole = CLIPMAP_SIZE / 2;
+    std::vector<uint32_t> written;
+    for (int z = 0; z < int(CLIPMAP_SIZE); z++) {
+        for (int x = 0; x < int(CLIPMAP_SIZE); x++) {
+            if ((holeX >= 0) &&
+                (x >= holeX) && (x < holeX + hole) &&
+                (z >= holeZ) && (z < holeZ + hole)) {
+                continue;
+            }
+            const uint32_t i = z * width + x;
+            written.insert(written.end(), {
+                i, i + width, i + 1,
+                i + 1, i + width, i + 1 + width
+            });
+        }
+    }
+    optimizeVertexCache(written.data(), written.size(), width * width);
+    for (uint32_t index: written) {
+        indices.push_back(static_cast<uint16_t>(index));
+    }
+}
+
+/**
+  * Point the draw of every level of the ground's clipmap at its window,
+  * and at the grid with its hole where the level below sits.
+  *
+  * @param instances Receives an instance per level.
+  * @param draws Receives a draw per level.
+  * @return The amount of triangles drawn.
+  */
+size_t
+placeGround(ClipmapVertex::Instance* instances,
+            VkDrawIndexedIndirectCommand* draws) {
+    const int size = static_cast<int>(groundClipmap->getTextureSize());
+    const auto wrap = [size](int a) {
+        return static_cast<float>(((a % size) + size) % size);
+    };
+    size_t triangleCount = 0;
+    for (unsigned l = 0; l < CLIPMAP_LEVEL_COUNT; l++) {
+        const int x = groundClipmap->getOriginX(l);
+        const int z = groundClipmap->getOriginZ(l);
+        ClipmapVertex::Instance& instance = instances[l];
+        instance.origin = glm::vec2(x, z);
+        instance.texel = glm::vec2(wrap(x), wrap(z));
+        instance.spacing = static_cast<float>(1u << l);
+        instance.level = static_cast<float>(l);
+        if (l + 1 < CLIPMAP_LEVEL_COUNT) {
+            /* NOTE(jan): Windows start on even samples, so this is a
+             * sample of the level above. */
+            instance.coarseTexel = glm::vec2(wrap(x / 2), wrap(z / 2));
+            instance.transition = static_cast<float>(CLIPMAP_TRANSITION);
+        } else {
+            instance.coarseTexel = glm::vec2(0.f);
+            instance.transition = 0.f;
+        }
+
+        size_t variant = 0;
+        if (l > 0) {
+            const int holeX = groundClipmap->getOriginX(l - 1) / 2 - x -
+                int(CLIPMAP_SIZE / 4);
+            const int holeZ = groundClipmap->getOriginZ(l - 1) / 2 - z -
+                int(CLIPMAP_SIZE / 4);
+            variant = 1 + holeX + holeZ * 2;
+        }
+        draws[l] = groundRingDraws[variant];
+        draws[l].firstInstance = l;
+        triangleCount += draws[l].indexCount / 3;
+    }
+    return triangleCount;
+}
+
 void onKeyEvent(
     GLFWwindow* window,
     int key,
@@ -286,6 +608,12 @@ main (int argc, char** argv, char** envp) {
         std::vector<VkPhysicalDevice> devices(count);
         vkEnumeratePhysicalDevices(vk.h, &count, devices.data());
         int max_score = -1;
+        /* NOTE(jan): Every device fills in vk's swap chain support, sample
+         * count and queue families as it is looked at, so the best one's
+         * are kept aside and put back once all have been seen. */
+        SwapChain bestSwap = {};
+        Queues bestQueues = {};
+        VkSampleCountFlagBits bestSampleCount = VK_SAMPLE_COUNT_1_BIT;
         for (const auto& device: devices) {
             int score = -1;
             VkPhysicalDeviceProperties properties;
@@ -314,6 +642,7 @@ main (int argc, char** argv, char** envp) {
             vkGetPhysicalDeviceSurfaceFormatsKHR(
                 device, vk.surface, &count, nullptr
             );
+            vk.swap.formats.clear();
             if (count > 0) {
                 vk.swap.formats.resize(count);
                 vkGetPhysicalDeviceSurfaceFormatsKHR(
@@ -324,6 +653,7 @@ main (int argc, char** argv, char** envp) {
             vkGetPhysicalDeviceSurfacePresentModesKHR(
                 device, vk.surface, &count, nullptr
             );
+            vk.swap.modes.clear();
             if (count > 0) {
                 vk.swap.modes.resize(count);
                 vkGetPhysicalDeviceSurfacePresentModesKHR(
@@ -359,6 +689,16 @@ main (int argc, char** argv, char** envp) {
             } else if (!features.geometryShader) {
                 LOG(ERROR) << properties.deviceName << " does not support "
                     << "geometry shaders, skipping...";
+            } else if (!features.multiDrawIndirect) {
+                LOG(ERROR) << properties.deviceName << " does not support "
+                    << "multiple indirect draws, skipping...";
+            } else if (GROUND_FIRST_INSTANCE &&
+                       !features.drawIndirectFirstInstance) {
+                LOG(ERROR) << properties.deviceName << " does not support "
+                    << "indirect draws from any instance, skipping...";
+            } else if (GROUND_TESSELLATED && !features.tessellationShader) {
+                LOG(ERROR) << properties.deviceName << " does not support "
+                    << "tessellation shaders, skipping...";
             } else if (!features.samplerAnisotropy) {
                 LOG(ERROR) << properties.deviceName << " does not support "
                     << "anisotropic samplers, skipping...";
@@ -408,9 +748,15 @@ main (int argc, char** argv, char** envp) {
                       << "' scored at " << score;
             if (score > max_score) {
                 vk.physical_device = device;
+                max_score = score;
+                bestSwap = vk.swap;
+                bestQueues = vk.queues;
+                bestSampleCount = vk.sampleCount;
             }
-            break;
         }
+        vk.swap = bestSwap;
+        vk.queues = bestQueues;
+        vk.sampleCount = bestSampleCount;
     }
     if (vk.physical_device == VK_NULL_HANDLE) {
         throw std::runtime_error("No suitable Vulkan devices detected.");
@@ -434,8 +780,12 @@ main (int argc, char** argv, char** envp) {
         }
         VkPhysicalDeviceFeatures features = {};
         features.geometryShader = VK_TRUE;
+        features.multiDrawIndirect = VK_TRUE;
+        features.drawIndirectFirstInstance =
+            GROUND_FIRST_INSTANCE ? VK_TRUE : VK_FALSE;
         features.samplerAnisotropy = VK_TRUE;
 		features.sampleRateShading = VK_TRUE;
+        features.tessellationShader = GROUND_TESSELLATED ? VK_TRUE : VK_FALSE;
         VkDeviceCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
         createInfo.queueCreateInfoCount =
@@ -633,6 +983,7 @@ main (int argc, char** argv, char** envp) {
      * pipeline creation process. */
     Pipeline grassPipeline = {};
 	Pipeline groundPipeline = {};
+    Pipeline farFieldPipeline = {};
 
     /* NOTE(jan): Render pass. */
     VkRenderPass defaultRenderPass;
@@ -714,8 +1065,13 @@ main (int argc, char** argv, char** envp) {
             b.descriptorCount = 1;
             b.stageFlags = (
                 VK_SHADER_STAGE_VERTEX_BIT |
-                VK_SHADER_STAGE_GEOMETRY_BIT
+                VK_SHADER_STAGE_GEOMETRY_BIT |
+                VK_SHADER_STAGE_FRAGMENT_BIT
             );
+            if (GROUND_TESSELLATED) {
+                b.stageFlags |= VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT |
+                    VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+            }
             b.pImmutableSamplers = nullptr;
             bindings.push_back(b);
         }
@@ -740,6 +1096,58 @@ main (int argc, char** argv, char** envp) {
             b.pImmutableSamplers = nullptr;
             bindings.push_back(b);
         }
+        {
+            VkDescriptorSetLayoutBinding b = {};
+            b.binding = 4;
+            b.descriptorCount = 1;
+            b.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            b.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+            b.pImmutableSamplers = nullptr;
+            bindings.push_back(b);
+        }
+        {
+            VkDescriptorSetLayoutBinding b = {};
+            b.binding = 5;
+            b.descriptorCount = 1;
+            b.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            b.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+            if (GROUND_TESSELLATED) {
+                b.stageFlags |= VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT |
+                    VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+            }
+            if (GROUND_FAR_FIELD) {
+                b.stageFlags |= VK_SHADER_STAGE_FRAGMENT_BIT;
+            }
+            b.pImmutableSamplers = nullptr;
+            bindings.push_back(b);
+        }
+        {
+            VkDescriptorSetLayoutBinding b = {};
+            b.binding = 6;
+            b.descriptorCount = 1;
+            b.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            b.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+            b.pImmutableSamplers = nullptr;
+            bindings.push_back(b);
+        }
+        {
+            VkDescriptorSetLayoutBinding b = {};
+            b.binding = 7;
+            b.descriptorCount = 1;
+            b.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            b.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+            b.pImmutableSamplers = nullptr;
+            bindings.push_back(b);
+        }
+        {
+            VkDescriptorSetLayoutBinding b = {};
+            b.binding = 8;
+            b.descriptorCount = 1;
+            b.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            b.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+            b.pImmutableSamplers = nullptr;
+            bindings.push_back(b);
+        }
         defaultDescriptorSetLayout = vk.createDescriptorSetLayout(bindings);
     }
 
@@ -754,8 +1162,46 @@ main (int argc, char** argv, char** envp) {
 
 	LOG(INFO) << "Creating ground pipeline...";
     {
-        groundPipeline = vk.createPipeline<TerrainVertex>(
-            "shaders/ground",
+        const VkPrimitiveTopology topology =
+            GROUND_INDEX_ORDER == IndexOrder::STRIPS
+                ? VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP
+                : VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        if (GROUND_RENDERER == GroundRenderer::CDLOD) {
+            groundPipeline = vk.createPipeline<LodInstance>(
+                "shaders/ground",
+                defaultRenderPass,
+                defaultDescriptorSetLayout,
+                topology
+            );
+        } else if (GROUND_RENDERER == GroundRenderer::CLIPMAP) {
+            groundPipeline = vk.createPipeline<ClipmapVertex>(
+                "shaders/clipmap",
+                defaultRenderPass,
+                defaultDescriptorSetLayout,
+                VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST
+            );
+        } else if (GROUND_TESSELLATED) {
+            groundPipeline = vk.createPipeline<PatchVertex>(
+                "shaders/tessellation",
+                defaultRenderPass,
+                defaultDescriptorSetLayout,
+                VK_PRIMITIVE_TOPOLOGY_PATCH_LIST,
+                4
+            );
+        } else {
+            groundPipeline = vk.createPipeline<ChunkVertex>(
+                "shaders/chunks",
+                defaultRenderPass,
+                defaultDescriptorSetLayout,
+                topology
+            );
+        }
+    }
+
+    if (GROUND_FAR_FIELD) {
+        LOG(INFO) << "Creating far field pipeline...";
+        farFieldPipeline = vk.createPipeline<NoVertex>(
+            "shaders/farfield",
             defaultRenderPass,
             defaultDescriptorSetLayout
         );
@@ -776,7 +1222,21 @@ main (int argc, char** argv, char** envp) {
 
     /* NOTE(jan): Vertex buffers. */
     {
-        Terrain terrain("noise.png");
+        /* NOTE(jan): The ground mesh is cooked on the first run. Later
+         * runs map the cooked file and upload straight out of it. */
+        const auto noise = std::make_shared<FractalNoise>(WORLD_SEED);
+        world = std::make_shared<NoiseChunk>(
+            noise, 0, 0, WORLD_SIZE, WORLD_SIZE
+        );
+        TerrainCache terrain(
+            world, "world.cooked", TerrainVertex::getLayout(),
+            GROUND_INDEX_ORDER
+        );
+        if (terrain.isWarm()) {
+            LOG(INFO) << "Loaded cooked terrain.";
+        } else {
+            LOG(INFO) << "Cooked terrain.";
+        }
 
         LOG(INFO) << "Generating model...";
         const int extent = 256;
@@ -785,51 +1245,371 @@ main (int argc, char** argv, char** envp) {
         eye.z = 128;
 
         std::vector<GridVertex> vertices;
-        const float* positions = terrain.getPositions();
-        const float* normals = terrain.getNormals();
-        for (unsigned x = 0; x < terrain.getWidth(); x++) {
-            for (unsigned z = 0; z < terrain.getDepth(); z++) {
-                TerrainVertex v;
-                v.pos = glm::vec3(positions[0], positions[1], positions[2]);
-                v.normal = glm::vec3(normals[0], normals[1], normals[2]);
-                v.tex = glm::vec2(
-                    x / terrain.getWidth(),
-                    z / terrain.getDepth()
+        /* NOTE(jan): Normals are shaded from a texture with a texel per
+         * vertex, so they keep their detail however coarsely the ground
+         * is triangulated. */
+        {
+            const auto heights = terrain.getHeightPlane();
+            const Terrain::Rect all = {
+                0, 0, heights.getWidth(), heights.getDepth()
+            };
+            scene.groundNormalMap = vk.createTexture(
+                heights.getWidth(), heights.getDepth(),
+                VK_FORMAT_R8G8_SNORM,
+                terrain.getVertexCount() * 2,
+                [&](void* data) {
+                    Terrain::writeNormalMap(
+                        static_cast<int8_t*>(data), heights, 0,
+                        heights.getDepth(), all
+                    );
+                }
+            );
+        }
+
+        /* NOTE(jan): Heights for shaders that place the ground's vertices
+         * themselves, and the occlusion terms they shade it with, also a
+         * texel per vertex. */
+        {
+            const auto heights = terrain.getHeightPlane();
+            scene.groundHeightMap = vk.createTexture(
+                heights.getWidth(), heights.getDepth(),
+                VK_FORMAT_R32_SFLOAT,
+                terrain.getVertexCount() * sizeof(float),
+                [&](void* data) {
+                    Terrain::copyHeightMap(
+                        static_cast<float*>(data), terrain.getVertices(),
+                        terrain.getVertexCount(), TerrainVertex::getLayout()
+                    );
+                }
+            );
+            scene.groundOcclusionMap = vk.createTexture(
+                heights.getWidth(), heights.getDepth(),
+                VK_FORMAT_R8_UNORM,
+                terrain.getVertexCount(),
+                [&](void* data) {
+                    Terrain::copyOcclusionMap(
+                        static_cast<uint8_t*>(data), terrain.getVertices(),
+                        terrain.getVertexCount(), TerrainVertex::getLayout()
+                    );
+                }
+            );
+        }
+
+        /* NOTE(jan): The clipmap's tiles, filled as the camera first
+         * moves. Other renderers get a single texel so that the
+         * descriptor still has an image. */
+        if (GROUND_RENDERER == GroundRenderer::CLIPMAP) {
+            groundClipmap.reset(new Clipmap(
+                noise, Terrain::HEIGHT_SCALE, CLIPMAP_LEVEL_COUNT,
+                CLIPMAP_SIZE
+            ));
+            const uint32_t size = groundClipmap->getTextureSize();
+            const VkDeviceSize bytes =
+                size * size * CLIPMAP_LEVEL_COUNT * sizeof(float);
+            scene.groundClipmap = vk.createTexture(
+                size, size * CLIPMAP_LEVEL_COUNT, VK_FORMAT_R32_SFLOAT, bytes,
+                [&](void* data) { memset(data, 0, bytes); }
+            );
+        } else {
+            scene.groundClipmap = vk.createTexture(
+                1, 1, VK_FORMAT_R32_SFLOAT, sizeof(float),
+                [&](void* data) { memset(data, 0, sizeof(float)); }
+            );
+        }
+
+        /* NOTE(jan): Without a far field, the bounds are a single cell
+         * so that the descriptor still has a buffer. */
+        if (GROUND_FAR_FIELD) {
+            const HeightPyramid pyramid(terrain.getHeightPlane());
+            const unsigned levelCount = pyramid.getLevelCount();
+            groundBoundsBuffer = vk.createDeviceLocalBuffer(
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                pyramid.getCellOffset(levelCount) * 2 * sizeof(float),
+                [&](void* data) {
+                    auto bounds = static_cast<float*>(data);
+                    for (unsigned l = 0; l < levelCount; l++) {
+                        pyramid.writeBounds(
+                            bounds, l, 0, 0, pyramid.getLevelWidth(l),
+                            pyramid.getLevelDepth(l)
+                        );
+                        bounds += pyramid.getLevelWidth(l) *
+                            pyramid.getLevelDepth(l) * 2;
+                    }
+                }
+            );
+            LOG(INFO) << "Built a far field pyramid of " << levelCount
+                      << " levels.";
+        } else {
+            const float bounds[2] = {0.f, 0.f};
+            groundBoundsBuffer = vk.createDeviceLocalBuffer(
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, sizeof(bounds), bounds
+            );
+        }
+
+        if (GROUND_RENDERER == GroundRenderer::CDLOD) {
+            /* NOTE(jan): Whole nodes are drawn with a grid of LEAF_SIZE
+             * quads along each side and quarters with one of half as many,
+             * one after the other in the index buffer. Both number their
+             * vertices in rows as wide as the whole grid's, which is all
+             * the shader needs to place them. Strips keep their restarts
+             * as 0xFFFF. */
+            const unsigned width = LodQuadtree::LEAF_SIZE + 1;
+            const unsigned gridSizes[2] = {
+                width, LodQuadtree::LEAF_SIZE / 2 + 1
+            };
+            std::vector<uint16_t> gridIndices;
+            for (int g = 0; g < 2; g++) {
+                const unsigned size = gridSizes[g];
+                std::vector<uint32_t> written(
+                    Terrain::getGridIndexCount(size, size, GROUND_INDEX_ORDER)
                 );
-                groundVertices.push_back(v);
-                positions += 3;
-                normals += 3;
+                Terrain::writeGridIndices(
+                    written.data(), size, size, GROUND_INDEX_ORDER
+                );
+                groundGridDraws[g] = {};
+                groundGridDraws[g].indexCount =
+                    static_cast<uint32_t>(written.size());
+                groundGridDraws[g].firstIndex =
+                    static_cast<uint32_t>(gridIndices.size());
+                for (uint32_t index: written) {
+                    if (index != 0xFFFFFFFF) {
+                        index = index / size * width + index % size;
+                    }
+                    gridIndices.push_back(static_cast<uint16_t>(index));
+                }
             }
-        }
-        groundBuffer = vk.createVertexBuffer<TerrainVertex>(groundVertices);
+            groundIndexBuffer = vk.createDeviceLocalBuffer(
+                VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                gridIndices.size() * sizeof(uint16_t),
+                gridIndices.data()
+            );
 
-        const unsigned* groundIndices = terrain.getIndices();
-        groundIndexVector.resize(terrain.getIndexCount());
-        groundIndexVector.assign(
-            groundIndices,
-            groundIndices + terrain.getIndexCount()
-        );
-        groundIndexBuffer = vk.createIndexBuffer(groundIndexVector);
+            groundLod.reset(
+                new LodQuadtree(terrain.getHeightPlane(), GROUND_LOD_RANGE)
+            );
+            groundInstanceBuffer = vk.createBuffer(
+                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                groundLod->getMaxSelectionSize() * sizeof(LodInstance)
+            );
+            groundDrawBuffer = vk.createBuffer(
+                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                2 * sizeof(VkDrawIndexedIndirectCommand)
+            );
+            LOG(INFO) << "Built a ground quadtree of "
+                      << groundLod->getLevelCount() << " levels.";
+        } else if (GROUND_TESSELLATED) {
+            /* NOTE(jan): The last patch along each side is cut short at
+             * the edge of the terrain. */
+            const unsigned width = terrain.getWidth();
+            const unsigned depth = terrain.getDepth();
+            const unsigned columns =
+                (width - 1 + GROUND_PATCH_SIZE - 1) / GROUND_PATCH_SIZE;
+            const unsigned rows =
+                (depth - 1 + GROUND_PATCH_SIZE - 1) / GROUND_PATCH_SIZE;
+            std::vector<PatchVertex> corners;
+            for (unsigned z = 0; z <= rows; z++) {
+                for (unsigned x = 0; x <= columns; x++) {
+                    PatchVertex corner = {};
+                    corner.corner = glm::vec2(
+                        std::min(x * GROUND_PATCH_SIZE, width - 1),
+                        std::min(z * GROUND_PATCH_SIZE, depth - 1)
+                    );
+                    corners.push_back(corner);
+                }
+            }
+            groundBuffer = vk.createVertexBuffer<PatchVertex>(corners);
+
+            std::vector<uint16_t> patches;
+            for (unsigned z = 0; z < rows; z++) {
+                for (unsigned x = 0; x < columns; x++) {
+                    const uint16_t i =
+                        static_cast<uint16_t>(z * (columns + 1) + x);
+                    const uint16_t below =
+                        static_cast<uint16_t>(i + columns + 1);
+                    patches.insert(patches.end(), {
+                        i, static_cast<uint16_t>(i + 1),
+                        static_cast<uint16_t>(below + 1), below
+                    });
+                }
+            }
+            groundIndexBuffer = vk.createDeviceLocalBuffer(
+                VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                patches.size() * sizeof(uint16_t),
+                patches.data()
+            );
+            VkDrawIndexedIndirectCommand draw = {};
+            draw.indexCount = static_cast<uint32_t>(patches.size());
+            draw.instanceCount = 1;
+            groundDrawBuffer = vk.createDeviceLocalBuffer(
+                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                sizeof(draw),
+                &draw
+            );
+            LOG(INFO) << "Tessellating " << patches.size() / 4
+                      << " ground patches.";
+        } else if (GROUND_RENDERER == GroundRenderer::CLIPMAP) {
+            std::vector<ClipmapVertex> grid;
+            for (unsigned z = 0; z <= CLIPMAP_SIZE; z++) {
+                for (unsigned x = 0; x <= CLIPMAP_SIZE; x++) {
+                    ClipmapVertex vertex = {};
+                    vertex.grid = glm::vec2(x, z);
+                    grid.push_back(vertex);
+                }
+            }
+            groundBuffer = vk.createVertexBuffer<ClipmapVertex>(grid);
+
+            /* NOTE(jan): The level below sits a quarter of the way in,
+             * give or take a quad along each axis. */
+            std::vector<uint16_t> gridIndices;
+            for (int v = 0; v < 5; v++) {
+                groundRingDraws[v] = {};
+                groundRingDraws[v].instanceCount = 1;
+                groundRingDraws[v].firstIndex =
+                    static_cast<uint32_t>(gridIndices.size());
+                if (v == 0) {
+                    writeClipmapIndices(gridIndices, -1, -1);
+                } else {
+                    writeClipmapIndices(
+                        gridIndices,
+                        CLIPMAP_SIZE / 4 + (v - 1) % 2,
+                        CLIPMAP_SIZE / 4 + (v - 1) / 2
+                    );
+                }
+                groundRingDraws[v].indexCount = static_cast<uint32_t>(
+                    gridIndices.size() - groundRingDraws[v].firstIndex
+                );
+            }
+            groundIndexBuffer = vk.createDeviceLocalBuffer(
+                VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                gridIndices.size() * sizeof(uint16_t),
+                gridIndices.data()
+            );
+            groundInstanceBuffer = vk.createBuffer(
+                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                CLIPMAP_LEVEL_COUNT * sizeof(ClipmapVertex::Instance)
+            );
+            groundDrawBuffer = vk.createBuffer(
+                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                CLIPMAP_LEVEL_COUNT * sizeof(VkDrawIndexedIndirectCommand)
+            );
+        } else {
+            groundChunks = Terrain::getChunks(terrain.getHeightPlane());
+            const auto heights = terrain.getHeightPlane();
+            groundBuffer = vk.createDeviceLocalBuffer(
+                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                groundChunks.size() * Terrain::CHUNK_VERTEX_COUNT *
+                    sizeof(Terrain::PackedVertex),
+                [&](void* data) {
+                    auto vertices =
+                        static_cast<Terrain::PackedVertex*>(data);
+                    for (const auto& chunk: groundChunks) {
+                        Terrain::writePackedChunkVertices(
+                            vertices, heights, chunk, GROUND_VERTEX_ORDER
+                        );
+                        vertices += Terrain::CHUNK_VERTEX_COUNT;
+                    }
+                }
+            );
+            std::vector<ChunkVertex::Instance> origins;
+            for (const auto& chunk: groundChunks) {
+                ChunkVertex::Instance origin = {};
+                origin.origin = glm::vec2(chunk.rect.x0, chunk.rect.z0);
+                origins.push_back(origin);
+            }
+            groundInstanceBuffer = vk.createVertexBuffer(origins);
+            /* NOTE(jan): An RTIN only ever merges the grid's triangles, so
+             * each chunk's adaptive indices fit in as much room as the full
+             * chunk's. */
+            groundIndexCount = Terrain::getChunkIndexCount(GROUND_INDEX_ORDER);
+            const size_t rangeCount =
+                GROUND_ADAPTIVE ? groundChunks.size() + 1 : 1;
+            std::vector<uint16_t> groundIndices(rangeCount * groundIndexCount);
+            Terrain::writeChunkIndices(
+                groundIndices.data(), GROUND_INDEX_ORDER, GROUND_VERTEX_ORDER
+            );
+            std::vector<VkDrawIndexedIndirectCommand> groundDraws(
+                groundChunks.size()
+            );
+            if (GROUND_ADAPTIVE) {
+                auto start = std::chrono::steady_clock::now();
+                const size_t triangleCount = triangulateGround(
+                    terrain.getHeightPlane(),
+                    groundIndices.data() + groundIndexCount, groundDraws.data()
+                );
+                auto elapsed = std::chrono::duration_cast<
+                    std::chrono::milliseconds
+                >(std::chrono::steady_clock::now() - start);
+                LOG(INFO) << "Triangulated " << groundChunks.size()
+                          << " ground chunks to " << triangleCount << " of "
+                          << groundChunks.size() * groundIndexCount / 3
+                          << " triangles in " << elapsed.count() << "ms.";
+            } else {
+                drawFullGround(groundDraws.data());
+            }
+            {
+                std::vector<uint32_t> drawn(groundIndexCount);
+                Terrain::writeGridIndices(
+                    drawn.data(), Terrain::CHUNK_SIZE, Terrain::CHUNK_SIZE,
+                    GROUND_INDEX_ORDER
+                );
+                LOG(INFO) << "Ground chunk ACMR is "
+                          << getAcmr(drawn.data(), drawn.size(),
+                                     Terrain::CHUNK_VERTEX_COUNT,
+                                     GROUND_INDEX_ORDER)
+                          << ".";
+            }
+            groundIndexBuffer = vk.createDeviceLocalBuffer(
+                VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                groundIndices.size() * sizeof(uint16_t),
+                groundIndices.data()
+            );
+            groundDrawBuffer = vk.createDeviceLocalBuffer(
+                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                groundDraws.size() * sizeof(VkDrawIndexedIndirectCommand),
+                groundDraws.data()
+            );
+        }
 
         const float density = 1.f;
         const int count = static_cast<int>(extent * density);
         WangTiling wangTiling(count, count);
         {
+            /* NOTE(jan): Look up the ground under every clump in one
+             * batch. */
+            std::vector<float> xs;
+            std::vector<float> zs;
+            xs.reserve(count * count);
+            zs.reserve(count * count);
             for (int z = 0; z < count; z++) {
                 for (int x = 0; x < count; x++) {
-                    GridVertex vertex = {};
-                    vertex.pos = {
-                        x * (1/(float)density),
-                        terrain.getHeightAt(x, z) + 0.2f,
-                        z * (1/(float)density),
-                    };
-                    vertex.type = wangTiling.getTile(z, x).getID();
-                    indices.push_back(
-                        static_cast<uint32_t>(vertices.size())
-                    );
-                    vertices.push_back(vertex);
+                    xs.push_back(x * (1/(float)density));
+                    zs.push_back(z * (1/(float)density));
                 }
             }
+            std::vector<float> heights(xs.size());
+            terrain.getHeightPlane().sampleHeights(
+                xs.data(), zs.data(), heights.data(), xs.size()
+            );
+
+            /* NOTE(jan): Clumps are laid out along GRASS_VERTEX_ORDER and
+             * drawn in the order they are laid out in. */
+            vertices.reserve(xs.size());
+            for (uint32_t i: getVertexSequence(count, count,
+                                               GRASS_VERTEX_ORDER)) {
+                GridVertex vertex = {};
+                vertex.pos = {xs[i], heights[i] + 0.2f, zs[i]};
+                vertex.type = wangTiling.getTile(i / count, i % count).getID();
+                indices.push_back(static_cast<uint32_t>(vertices.size()));
+                vertices.push_back(vertex);
+            }
         }
         scene.vertices = vk.createVertexBuffer<GridVertex>(vertices);
     }
@@ -927,12 +1707,18 @@ main (int argc, char** argv, char** envp) {
             s.descriptorCount = 1;
             size.push_back(s);
         }
-        for (int i = 0; i < 3; i++) {
+        for (int i = 0; i < 7; i++) {
             VkDescriptorPoolSize s = {};
             s.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
             s.descriptorCount = 1;
             size.push_back(s);
         }
+        {
+            VkDescriptorPoolSize s = {};
+            s.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            s.descriptorCount = 1;
+            size.push_back(s);
+        }
         defaultDescriptorPool = vk.createDescriptorPool(size);
     }
 
@@ -946,11 +1732,11 @@ main (int argc, char** argv, char** envp) {
         );
 
         std::vector<VkWriteDescriptorSet> writes;
+        VkDescriptorBufferInfo uniforms = {};
         {
-            VkDescriptorBufferInfo i = {};
-            i.buffer = scene.uniforms.buffer;
-            i.offset = 0;
-            i.range = sizeof(scene.mvp);
+            uniforms.buffer = scene.uniforms.buffer;
+            uniforms.offset = 0;
+            uniforms.range = sizeof(scene.mvp);
             VkWriteDescriptorSet w = {};
             w.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
             w.dstSet = defaultDescriptorSet;
@@ -958,14 +1744,14 @@ main (int argc, char** argv, char** envp) {
             w.dstArrayElement = 0;
             w.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
             w.descriptorCount = 1;
-            w.pBufferInfo = &i;
+            w.pBufferInfo = &uniforms;
             writes.push_back(w);
         }
+        VkDescriptorImageInfo grassImage = {};
         {
-            VkDescriptorImageInfo i = {};
-            i.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            i.imageView = scene.grassTexture.v;
-            i.sampler = scene.grassTexture.s;
+            grassImage.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            grassImage.imageView = scene.grassTexture.v;
+            grassImage.sampler = scene.grassTexture.s;
             VkWriteDescriptorSet w = {};
             w.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
             w.dstSet = defaultDescriptorSet;
@@ -973,14 +1759,14 @@ main (int argc, char** argv, char** envp) {
             w.dstArrayElement = 0;
             w.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
             w.descriptorCount = 1;
-            w.pImageInfo = &i;
+            w.pImageInfo = &grassImage;
             writes.push_back(w);
         }
+        VkDescriptorImageInfo groundImage = {};
         {
-            VkDescriptorImageInfo i = {};
-            i.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            i.imageView = scene.groundTexture.v;
-            i.sampler = scene.groundTexture.s;
+            groundImage.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            groundImage.imageView = scene.groundTexture.v;
+            groundImage.sampler = scene.groundTexture.s;
             VkWriteDescriptorSet w = {};
             w.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
             w.dstSet = defaultDescriptorSet;
@@ -988,14 +1774,14 @@ main (int argc, char** argv, char** envp) {
             w.dstArrayElement = 0;
             w.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
             w.descriptorCount = 1;
-            w.pImageInfo = &i;
+            w.pImageInfo = &groundImage;
             writes.push_back(w);
         }
+        VkDescriptorImageInfo noiseImage = {};
         {
-            VkDescriptorImageInfo i = {};
-            i.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            i.imageView = scene.noise.v;
-            i.sampler = scene.noise.s;
+            noiseImage.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            noiseImage.imageView = scene.noise.v;
+            noiseImage.sampler = scene.noise.s;
             VkWriteDescriptorSet w = {};
             w.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
             w.dstSet = defaultDescriptorSet;
@@ -1003,7 +1789,82 @@ main (int argc, char** argv, char** envp) {
             w.dstArrayElement = 0;
             w.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
             w.descriptorCount = 1;
-            w.pImageInfo = &i;
+            w.pImageInfo = &noiseImage;
+            writes.push_back(w);
+        }
+        VkDescriptorImageInfo normalMap = {};
+        {
+            normalMap.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            normalMap.imageView = scene.groundNormalMap.v;
+            normalMap.sampler = scene.groundNormalMap.s;
+            VkWriteDescriptorSet w = {};
+            w.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            w.dstSet = defaultDescriptorSet;
+            w.dstBinding = 4;
+            w.dstArrayElement = 0;
+            w.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            w.descriptorCount = 1;
+            w.pImageInfo = &normalMap;
+            writes.push_back(w);
+        }
+        VkDescriptorImageInfo heightMap = {};
+        {
+            heightMap.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            heightMap.imageView = scene.groundHeightMap.v;
+            heightMap.sampler = scene.groundHeightMap.s;
+            VkWriteDescriptorSet w = {};
+            w.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            w.dstSet = defaultDescriptorSet;
+            w.dstBinding = 5;
+            w.dstArrayElement = 0;
+            w.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            w.descriptorCount = 1;
+            w.pImageInfo = &heightMap;
+            writes.push_back(w);
+        }
+        VkDescriptorImageInfo clipmap = {};
+        {
+            clipmap.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            clipmap.imageView = scene.groundClipmap.v;
+            clipmap.sampler = scene.groundClipmap.s;
+            VkWriteDescriptorSet w = {};
+            w.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            w.dstSet = defaultDescriptorSet;
+            w.dstBinding = 6;
+            w.dstArrayElement = 0;
+            w.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            w.descriptorCount = 1;
+            w.pImageInfo = &clipmap;
+            writes.push_back(w);
+        }
+        VkDescriptorImageInfo occlusionMap = {};
+        {
+            occlusionMap.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            occlusionMap.imageView = scene.groundOcclusionMap.v;
+            occlusionMap.sampler = scene.groundOcclusionMap.s;
+            VkWriteDescriptorSet w = {};
+            w.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            w.dstSet = defaultDescriptorSet;
+            w.dstBinding = 7;
+            w.dstArrayElement = 0;
+            w.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            w.descriptorCount = 1;
+            w.pImageInfo = &occlusionMap;
+            writes.push_back(w);
+        }
+        VkDescriptorBufferInfo bounds = {};
+        {
+            bounds.buffer = groundBoundsBuffer.buffer;
+            bounds.offset = 0;
+            bounds.range = VK_WHOLE_SIZE;
+            VkWriteDescriptorSet w = {};
+            w.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            w.dstSet = defaultDescriptorSet;
+            w.dstBinding = 8;
+            w.dstArrayElement = 0;
+            w.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            w.descriptorCount = 1;
+            w.pBufferInfo = &bounds;
             writes.push_back(w);
         }
 
@@ -1069,22 +1930,56 @@ main (int argc, char** argv, char** envp) {
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
             groundPipeline.handle
         );
-		VkBuffer ground_vertex_buffers[] = { groundBuffer.buffer };
-		vkCmdBindVertexBuffers(
-			vk.swap.command_buffers[i],
-			0, 1,
-			ground_vertex_buffers,
-			offsets
-		);
+		VkBuffer ground_vertex_buffers[] = {
+            groundBuffer.buffer, groundInstanceBuffer.buffer
+        };
+        VkDeviceSize ground_offsets[] = {0, 0};
+        /* NOTE(jan): TESSELLATION only has vertices, CDLOD only
+         * instances. */
+        if ((GROUND_RENDERER == GroundRenderer::CHUNKS) ||
+            (GROUND_RENDERER == GroundRenderer::CLIPMAP)) {
+            vkCmdBindVertexBuffers(
+                vk.swap.command_buffers[i], 0, 2, ground_vertex_buffers,
+                ground_offsets
+            );
+        } else {
+            vkCmdBindVertexBuffers(
+                vk.swap.command_buffers[i], 0, 1,
+                &ground_vertex_buffers[
+                    GROUND_RENDERER == GroundRenderer::CDLOD ? 1 : 0
+                ],
+                ground_offsets
+            );
+        }
         vkCmdBindIndexBuffer(
             vk.swap.command_buffers[i], groundIndexBuffer.buffer,
-            0, VK_INDEX_TYPE_UINT32
+            0, VK_INDEX_TYPE_UINT16
         );
-		vkCmdDrawIndexed(
-			vk.swap.command_buffers[i],
-            static_cast<uint32_t>(groundIndexVector.size()),
-			1, 0, 0, 0
-		);
+        /* NOTE(jan): The draws are rewritten every frame with CDLOD and
+         * CLIPMAP, so the command buffers can stay as they are. */
+        uint32_t groundDrawCount =
+            static_cast<uint32_t>(groundChunks.size());
+        if (GROUND_RENDERER == GroundRenderer::CDLOD) {
+            groundDrawCount = 2;
+        } else if (GROUND_RENDERER == GroundRenderer::CLIPMAP) {
+            groundDrawCount = CLIPMAP_LEVEL_COUNT;
+        } else if (GROUND_TESSELLATED) {
+            groundDrawCount = 1;
+        }
+        vkCmdDrawIndexedIndirect(
+            vk.swap.command_buffers[i], groundDrawBuffer.buffer,
+            0, groundDrawCount, sizeof(VkDrawIndexedIndirectCommand)
+        );
+
+        /* NOTE(jan): After the near ground, so that most of the pixels it
+         * covers fail the depth test before anything is marched. */
+        if (GROUND_FAR_FIELD) {
+            vkCmdBindPipeline(
+                vk.swap.command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS,
+                farFieldPipeline.handle
+            );
+            vkCmdDraw(vk.swap.command_buffers[i], 3, 1, 0, 0);
+        }
 
         vkCmdBindPipeline(
             vk.swap.command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS,
@@ -1135,6 +2030,10 @@ main (int argc, char** argv, char** envp) {
         0.1f,
         1000.0f
     );
+    scene.mvp.viewport = glm::vec4(
+        vk.swap.extent.width, vk.swap.extent.height, 0.f, 0.f
+    );
+    scene.mvp.farField = GROUND_FAR_FIELD ? GROUND_FAR_FIELD_DISTANCE : 0.f;
 
     /* NOTE(jan): Log frame times. */
     std::ofstream frameTimeFile("frames.csv", std::ios::out);
@@ -1162,12 +2061,84 @@ main (int argc, char** argv, char** envp) {
         last_f = std::chrono::high_resolution_clock::now();
 
         /* NOTE(jan): Copy MVP. */
+        scene.mvp.eye =
+            glm::inverse(scene.mvp.model) * glm::vec4(eye, 1.0f);
         void* mvp_dst;
         size_t s = sizeof(scene.mvp);
         vkMapMemory(vk.device, scene.uniforms.memory, 0, s, 0, &mvp_dst);
             memcpy(mvp_dst, &scene.mvp, s);
         vkUnmapMemory(vk.device, scene.uniforms.memory);
 
+        /* NOTE(jan): Pick the ground's nodes for this frame. The previous
+         * frame has been presented, so nothing reads the buffers. */
+        size_t groundTriangleCount = 0;
+        if (GROUND_RENDERER == GroundRenderer::CDLOD) {
+            void* instances;
+            void* draws;
+            vkMapMemory(
+                vk.device, groundInstanceBuffer.memory, 0, VK_WHOLE_SIZE, 0,
+                &instances
+            );
+            vkMapMemory(
+                vk.device, groundDrawBuffer.memory, 0, VK_WHOLE_SIZE, 0,
+                &draws
+            );
+                groundTriangleCount = selectGround(
+                    static_cast<LodInstance*>(instances),
+                    static_cast<VkDrawIndexedIndirectCommand*>(draws)
+                );
+            vkUnmapMemory(vk.device, groundDrawBuffer.memory);
+            vkUnmapMemory(vk.device, groundInstanceBuffer.memory);
+        } else if (GROUND_RENDERER == GroundRenderer::CLIPMAP) {
+            /* NOTE(jan): Only the rows and columns that scrolled into a
+             * level are written, wherever they wrap to in its tile. */
+            const auto regions = groundClipmap->move(eye.x, eye.z);
+            const uint32_t tile = groundClipmap->getTextureSize();
+            std::vector<VkBufferImageCopy> copies;
+            VkDeviceSize size = 0;
+            for (const auto& region: regions) {
+                VkBufferImageCopy copy = {};
+                copy.bufferOffset = size;
+                copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                copy.imageSubresource.layerCount = 1;
+                copy.imageOffset = {
+                    static_cast<int32_t>(region.textureX),
+                    static_cast<int32_t>(region.level * tile + region.textureZ),
+                    0
+                };
+                copy.imageExtent = {region.width, region.depth, 1};
+                copies.push_back(copy);
+                size += region.width * region.depth * sizeof(float);
+            }
+            vk.updateTexture(
+                scene.groundClipmap, VK_FORMAT_R32_SFLOAT, size, copies,
+                [&](void* data) {
+                    auto texels = static_cast<float*>(data);
+                    for (const auto& region: regions) {
+                        groundClipmap->writeRegion(texels, region);
+                        texels += region.width * region.depth;
+                    }
+                }
+            );
+
+            void* instances;
+            void* draws;
+            vkMapMemory(
+                vk.device, groundInstanceBuffer.memory, 0, VK_WHOLE_SIZE, 0,
+                &instances
+            );
+            vkMapMemory(
+                vk.device, groundDrawBuffer.memory, 0, VK_WHOLE_SIZE, 0,
+                &draws
+            );
+                groundTriangleCount = placeGround(
+                    static_cast<ClipmapVertex::Instance*>(instances),
+                    static_cast<VkDrawIndexedIndirectCommand*>(draws)
+                );
+            vkUnmapMemory(vk.device, groundDrawBuffer.memory);
+            vkUnmapMemory(vk.device, groundInstanceBuffer.memory);
+        }
+
         uint32_t imageIndex;
         vkAcquireNextImageKHR(
             vk.device, vk.swap.h,
@@ -1333,11 +2304,268 @@ main (int argc, char** argv, char** envp) {
             at -= down * delta * delta_f;
         }
 
+        /* NOTE(jan): Sculpting, E raises and Q lowers the ground the
+         * camera is looking at, or the ground a little way ahead if it is
+         * looking at the sky. */
+        if ((keyboard[GLFW_KEY_E] == GLFW_PRESS) ||
+            (keyboard[GLFW_KEY_Q] == GLFW_PRESS)) {
+            if (!editableTerrain) {
+                editableTerrain.reset(new Terrain(world));
+            }
+            /* NOTE(jan): Re-triangulating every frame is too slow, draw the
+             * full grid until the brush is let go. */
+            if (!groundSculpting && GROUND_ADAPTIVE) {
+                VkBufferCopy region = {};
+                region.size =
+                    groundChunks.size() * sizeof(VkDrawIndexedIndirectCommand);
+                vk.updateDeviceLocalBuffer(
+                    groundDrawBuffer, region.size, {region},
+                    [&](void* data) {
+                        drawFullGround(
+                            static_cast<VkDrawIndexedIndirectCommand*>(data)
+                        );
+                    }
+                );
+            }
+            groundSculpting = true;
+            HeightRay ray;
+            ray.origin = eye;
+            ray.direction = glm::normalize(at - eye);
+            ray.maxDistance = BRUSH_REACH;
+            HeightHit hit = editableTerrain->castRay(ray);
+            glm::vec3 target;
+            if (hit.hit) {
+                target = hit.position;
+            } else {
+                glm::vec3 forward = at - eye;
+                forward.y = 0.0f;
+                forward = glm::normalize(forward);
+                target = eye + forward * BRUSH_DISTANCE;
+            }
+            float amount = BRUSH_RATE * delta_f;
+            if (keyboard[GLFW_KEY_Q] == GLFW_PRESS) {
+                amount = -amount;
+            }
+            editableTerrain->applyBrush(
+                target.x, target.z, BRUSH_RADIUS, amount
+            );
+        }
+
+        /* NOTE(jan): Re-upload only the chunks the edits touched, and the
+         * changed rectangles of the normal, height and occlusion maps. */
+        if (editableTerrain && editableTerrain->isDirty()) {
+            auto changed = editableTerrain->update();
+            if (GROUND_RENDERER == GroundRenderer::CDLOD) {
+                for (const auto& rect: changed) {
+                    groundLod->update(
+                        editableTerrain->getHeightPlane(),
+                        rect.x0, rect.z0, rect.x1, rect.z1
+                    );
+                }
+                /* NOTE(jan): The cells of every level over the changed
+                 * samples, a region per row of cells. A sample belongs to
+                 * the quads on either side of it. */
+                if (GROUND_FAR_FIELD) {
+                    struct Cells {
+                        unsigned level, x0, z0, x1, z1;
+                    };
+                    const HeightPyramid& pyramid =
+                        editableTerrain->getPyramid();
+                    const VkDeviceSize cellSize = 2 * sizeof(float);
+                    std::vector<Cells> cells;
+                    std::vector<VkBufferCopy> regions;
+                    VkDeviceSize size = 0;
+                    for (const auto& rect: changed) {
+                        const unsigned x0 = rect.x0 > 0 ? rect.x0 - 1 : 0;
+                        const unsigned z0 = rect.z0 > 0 ? rect.z0 - 1 : 0;
+                        for (unsigned l = 0; l < pyramid.getLevelCount();
+                             l++) {
+                            const unsigned width = pyramid.getLevelWidth(l);
+                            const unsigned depth = pyramid.getLevelDepth(l);
+                            const size_t offset = pyramid.getCellOffset(l);
+                            const Cells c = {
+                                l, x0 >> l, z0 >> l,
+                                std::min(((rect.x1 - 1) >> l) + 1, width),
+                                std::min(((rect.z1 - 1) >> l) + 1, depth)
+                            };
+                            for (unsigned z = c.z0; z < c.z1; z++) {
+                                VkBufferCopy region = {};
+                                region.srcOffset = size;
+                                region.dstOffset = cellSize *
+                                    (offset + size_t(z) * width + c.x0);
+                                region.size = cellSize * (c.x1 - c.x0);
+                                regions.push_back(region);
+                                size += region.size;
+                            }
+                            cells.push_back(c);
+                        }
+                    }
+                    vk.updateDeviceLocalBuffer(
+                        groundBoundsBuffer, size, regions,
+                        [&](void* data) {
+                            auto bounds = static_cast<float*>(data);
+                            for (const auto& c: cells) {
+                                pyramid.writeBounds(
+                                    bounds, c.level, c.x0, c.z0, c.x1, c.z1
+                                );
+                                bounds += (c.x1 - c.x0) * (c.z1 - c.z0) * 2;
+                            }
+                        }
+                    );
+                }
+            } else if (GROUND_RENDERER == GroundRenderer::CHUNKS) {
+                const VkDeviceSize chunkSize =
+                    Terrain::CHUNK_VERTEX_COUNT * sizeof(Terrain::PackedVertex);
+                groundChunks = editableTerrain->getChunks();
+
+                std::vector<const Terrain::Chunk*> touched;
+                std::vector<VkBufferCopy> regions;
+                for (const auto& chunk: groundChunks) {
+                    for (const auto& rect: changed) {
+                        if ((rect.x0 < chunk.rect.x1) &&
+                            (chunk.rect.x0 < rect.x1) &&
+                            (rect.z0 < chunk.rect.z1) &&
+                            (chunk.rect.z0 < rect.z1)) {
+                            VkBufferCopy region = {};
+                            region.srcOffset = touched.size() * chunkSize;
+                            region.dstOffset = chunk.firstVertex *
+                                sizeof(Terrain::PackedVertex);
+                            region.size = chunkSize;
+                            regions.push_back(region);
+                            touched.push_back(&chunk);
+                            break;
+                        }
+                    }
+                }
+                vk.updateDeviceLocalBuffer(
+                    groundBuffer, touched.size() * chunkSize, regions,
+                    [&](void* data) {
+                        auto vertices =
+                            static_cast<Terrain::PackedVertex*>(data);
+                        const auto heights = editableTerrain->getHeightPlane();
+                        for (const auto* chunk: touched) {
+                            Terrain::writePackedChunkVertices(
+                                vertices, heights, *chunk, GROUND_VERTEX_ORDER
+                            );
+                            vertices += Terrain::CHUNK_VERTEX_COUNT;
+                        }
+                    }
+                );
+            }
+
+            std::vector<VkBufferImageCopy> normalRegions;
+            VkDeviceSize normalSize = 0;
+            for (const auto& rect: changed) {
+                VkBufferImageCopy region = {};
+                region.bufferOffset = normalSize;
+                region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                region.imageSubresource.layerCount = 1;
+                region.imageOffset = {
+                    static_cast<int32_t>(rect.x0),
+                    static_cast<int32_t>(rect.z0),
+                    0
+                };
+                region.imageExtent = {rect.x1 - rect.x0, rect.z1 - rect.z0, 1};
+                normalRegions.push_back(region);
+                normalSize += (rect.x1 - rect.x0) * (rect.z1 - rect.z0) * 2;
+            }
+            vk.updateTexture(
+                scene.groundNormalMap, VK_FORMAT_R8G8_SNORM, normalSize,
+                normalRegions,
+                [&](void* data) {
+                    auto bytes = static_cast<int8_t*>(data);
+                    for (const auto& rect: changed) {
+                        editableTerrain->writeNormalMap(bytes, rect);
+                        bytes += (rect.x1 - rect.x0) * (rect.z1 - rect.z0) * 2;
+                    }
+                }
+            );
+
+            /* NOTE(jan): The height map has the same texels as the normal
+             * map, four bytes each rather than two. */
+            for (auto& region: normalRegions) {
+                region.bufferOffset *= 2;
+            }
+            vk.updateTexture(
+                scene.groundHeightMap, VK_FORMAT_R32_SFLOAT,
+                normalSize * 2, normalRegions,
+                [&](void* data) {
+                    auto texels = static_cast<float*>(data);
+                    for (const auto& rect: changed) {
+                        editableTerrain->writeHeightMap(texels, rect);
+                        texels += (rect.x1 - rect.x0) * (rect.z1 - rect.z0);
+                    }
+                }
+            );
+
+            /* NOTE(jan): So does the occlusion map, at a byte each, with
+             * every rectangle starting on four bytes. */
+            VkDeviceSize occlusionSize = 0;
+            for (size_t r = 0; r < changed.size(); r++) {
+                const auto& rect = changed[r];
+                normalRegions[r].bufferOffset = occlusionSize;
+                occlusionSize +=
+                    ((rect.x1 - rect.x0) * (rect.z1 - rect.z0) + 3) & ~3u;
+            }
+            vk.updateTexture(
+                scene.groundOcclusionMap, VK_FORMAT_R8_UNORM, occlusionSize,
+                normalRegions,
+                [&](void* data) {
+                    auto texels = static_cast<uint8_t*>(data);
+                    for (const auto& rect: changed) {
+                        editableTerrain->writeOcclusionMap(texels, rect);
+                        texels +=
+                            ((rect.x1 - rect.x0) * (rect.z1 - rect.z0) + 3) &
+                            ~3u;
+                    }
+                }
+            );
+        }
+
+        if (groundSculpting && GROUND_ADAPTIVE &&
+            (keyboard[GLFW_KEY_E] != GLFW_PRESS) &&
+            (keyboard[GLFW_KEY_Q] != GLFW_PRESS)) {
+            std::vector<uint16_t> indices(
+                groundChunks.size() * groundIndexCount
+            );
+            std::vector<VkDrawIndexedIndirectCommand> draws(
+                groundChunks.size()
+            );
+            triangulateGround(
+                editableTerrain->getHeightPlane(), indices.data(),
+                draws.data()
+            );
+
+            VkBufferCopy region = {};
+            region.dstOffset = groundIndexCount * sizeof(uint16_t);
+            region.size = indices.size() * sizeof(uint16_t);
+            vk.updateDeviceLocalBuffer(
+                groundIndexBuffer, region.size, {region},
+                [&](void* data) {
+                    memcpy(data, indices.data(), region.size);
+                }
+            );
+            region.dstOffset = 0;
+            region.size = draws.size() * sizeof(VkDrawIndexedIndirectCommand);
+            vk.updateDeviceLocalBuffer(
+                groundDrawBuffer, region.size, {region},
+                [&](void* data) {
+                    memcpy(data, draws.data(), region.size);
+                }
+            );
+            groundSculpting = false;
+        }
+
         scene.mvp.view = glm::lookAt(eye, at, up);
 
         if (keyboard[GLFW_KEY_P] == GLFW_PRESS) {
 			LOG(INFO) << "eye(" << eye.x << " " << eye.y << " " << eye.z << ")";
 			LOG(INFO) << "at(" << at.x << " " << at.y << " " << at.z << ")";
+            if ((GROUND_RENDERER == GroundRenderer::CDLOD) ||
+                (GROUND_RENDERER == GroundRenderer::CLIPMAP)) {
+                LOG(INFO) << "Drew " << groundTriangleCount
+                          << " ground triangles.";
+            }
 		}
     }
 
@@ -1375,11 +2603,27 @@ main (int argc, char** argv, char** envp) {
     vkDestroySampler(vk.device, scene.groundTexture.s, nullptr);
     vkDestroyImageView(vk.device, scene.groundTexture.v, nullptr);
     vkDestroyImage(vk.device, scene.groundTexture.i, nullptr);
+    vkDestroySampler(vk.device, scene.groundNormalMap.s, nullptr);
+    vkDestroyImageView(vk.device, scene.groundNormalMap.v, nullptr);
+    vkDestroyImage(vk.device, scene.groundNormalMap.i, nullptr);
+    vkDestroySampler(vk.device, scene.groundHeightMap.s, nullptr);
+    vkDestroyImageView(vk.device, scene.groundHeightMap.v, nullptr);
+    vkDestroyImage(vk.device, scene.groundHeightMap.i, nullptr);
+    vkDestroySampler(vk.device, scene.groundOcclusionMap.s, nullptr);
+    vkDestroyImageView(vk.device, scene.groundOcclusionMap.v, nullptr);
+    vkDestroyImage(vk.device, scene.groundOcclusionMap.i, nullptr);
+    vkDestroySampler(vk.device, scene.groundClipmap.s, nullptr);
+    vkDestroyImageView(vk.device, scene.groundClipmap.v, nullptr);
+    vkDestroyImage(vk.device, scene.groundClipmap.i, nullptr);
     vkDestroySampler(vk.device, scene.noise.s, nullptr);
     vkDestroyImageView(vk.device, scene.noise.v, nullptr);
     vkDestroyImage(vk.device, scene.noise.i, nullptr);
     vkFreeMemory(vk.device, scene.grassTexture.m, nullptr);
     vkFreeMemory(vk.device, scene.groundTexture.m, nullptr);
+    vkFreeMemory(vk.device, scene.groundNormalMap.m, nullptr);
+    vkFreeMemory(vk.device, scene.groundHeightMap.m, nullptr);
+    vkFreeMemory(vk.device, scene.groundOcclusionMap.m, nullptr);
+    vkFreeMemory(vk.device, scene.groundClipmap.m, nullptr);
     vkFreeMemory(vk.device, scene.noise.m, nullptr);
     vkFreeMemory(vk.device, scene.indices.memory, nullptr);
     vkDestroyBuffer(vk.device, scene.indices.buffer, nullptr);
@@ -1387,6 +2631,14 @@ main (int argc, char** argv, char** envp) {
     vkDestroyBuffer(vk.device, scene.vertices.buffer, nullptr);
     vkFreeMemory(vk.device, groundBuffer.memory, nullptr);
     vkDestroyBuffer(vk.device, groundBuffer.buffer, nullptr);
+    vkFreeMemory(vk.device, groundIndexBuffer.memory, nullptr);
+    vkDestroyBuffer(vk.device, groundIndexBuffer.buffer, nullptr);
+    vkFreeMemory(vk.device, groundDrawBuffer.memory, nullptr);
+    vkDestroyBuffer(vk.device, groundDrawBuffer.buffer, nullptr);
+    vkFreeMemory(vk.device, groundInstanceBuffer.memory, nullptr);
+    vkDestroyBuffer(vk.device, groundInstanceBuffer.buffer, nullptr);
+    vkFreeMemory(vk.device, groundBoundsBuffer.memory, nullptr);
+    vkDestroyBuffer(vk.device, groundBoundsBuffer.buffer, nullptr);
     vkFreeMemory(vk.device, scene.uniforms.memory, nullptr);
     vkDestroyBuffer(vk.device, scene.uniforms.buffer, nullptr);
     vkDestroyDescriptorPool(
@@ -1404,6 +2656,10 @@ main (int argc, char** argv, char** envp) {
     vkDestroyRenderPass(vk.device, defaultRenderPass, nullptr);
     vkDestroyPipeline(vk.device, groundPipeline.handle, nullptr);
     vkDestroyPipelineLayout(vk.device, groundPipeline.layout, nullptr);
+    if (GROUND_FAR_FIELD) {
+        vkDestroyPipeline(vk.device, farFieldPipeline.handle, nullptr);
+        vkDestroyPipelineLayout(vk.device, farFieldPipeline.layout, nullptr);
+    }
     for (const auto& i: vk.swap.images) {
         vkDestroyImageView(vk.device, i.v, nullptr);
     }
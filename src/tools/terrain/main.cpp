@@ -1,6 +1,16 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <vector>
 
+#include "lib/Hash.h"
+#include "lib/heightfield/Erosion.h"
+#include "lib/heightfield/NoiseChunk.h"
 #include "lib/meshes/Terrain.h"
+#include "lib/meshes/TerrainStreamer.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -9,26 +19,248 @@ using std::cout;
 using std::cerr;
 using std::endl;
 using std::exception;
+using std::make_shared;
+using std::shared_ptr;
+using std::vector;
+
+/**
+  * Heights held in memory, such as those left by erosion.
+  */
+class HeightGrid : public HeightSource {
+public:
+    HeightGrid(unsigned width, unsigned depth, vector<float> heights) :
+            _width(width),
+            _depth(depth),
+            _heights(std::move(heights)) {
+    }
+
+    unsigned getWidth() const override {
+        return _width;
+    }
+
+    unsigned getDepth() const override {
+        return _depth;
+    }
+
+    void readRow(unsigned z, float* out) const override {
+        const float* row = _heights.data() + static_cast<size_t>(z) * _width;
+        std::copy(row, row + _width, out);
+    }
+
+    uint64_t hashSource(uint64_t seed) const override {
+        uint64_t hash = hashValue(_width, seed);
+        hash = hashValue(_depth, hash);
+        return hashBytes(_heights.data(), _heights.size() * sizeof(float),
+                         hash);
+    }
+
+private:
+    unsigned _width;
+    unsigned _depth;
+    vector<float> _heights;
+};
 
 void
 usage() {
-    cout << "usage: terrain.exe <heightmapFile>" << endl;
+    cout << "usage: terrain.exe [options] <heightmapFile> "
+         << "[outputPrefix [chunkSize]]" << endl;
     cout << endl;
     cout << "\theightmapFile\t\tPath to a greyscale image to be used to "
          << "generate the heightmap." << endl;
+    cout << "\t\t\t\tRaw .r16 / .r32, 16-bit .pgm and .hmap "
+         << "heightfields are memory-mapped." << endl;
+    cout << "\t\t\t\tfbm:<seed>:<size> generates a size x size "
+         << "procedural world instead." << endl;
+    cout << "\toutputPrefix\t\tStream the mesh out to chunk files starting "
+         << "with this," << endl;
+    cout << "\t\t\t\twithout holding the whole terrain in memory." << endl;
+    cout << "\tchunkSize\t\tQuads along each side of a chunk, "
+         << TerrainStreamer::DEFAULT_CHUNK_SIZE << " by default." << endl;
+    cout << endl;
+    cout << "\t--hydraulic <n>\t\tRun n iterations of hydraulic erosion."
+         << endl;
+    cout << "\t--thermal <n>\t\tRun n iterations of thermal erosion, "
+         << "after any hydraulic." << endl;
+    cout << "\t--out <file.hmap>\tSave the eroded heights." << endl;
     cout << endl;
 }
 
+/**
+  * Open a height map, or set up a procedural world for "fbm:<seed>:<size>"
+  * and report how fast it generates.
+  */
+shared_ptr<const HeightSource>
+openSource(const char* path) {
+    const char* prefix = "fbm:";
+    if (strncmp(path, prefix, strlen(prefix)) != 0) {
+        return make_shared<Heightmap>(path);
+    }
+    char* end;
+    const auto seed =
+        static_cast<uint32_t>(std::strtoul(path + strlen(prefix), &end, 10));
+    const unsigned size = *end == ':'
+        ? static_cast<unsigned>(std::strtoul(end + 1, nullptr, 10))
+        : 1024;
+    auto source = make_shared<NoiseChunk>(
+        make_shared<FractalNoise>(seed), 0, 0, size, size
+    );
+
+    /* NOTE(jan): One thread, to report the rate per core. */
+    const unsigned rows = size < 256 ? size : 256;
+    vector<float> row(size);
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned z = 0; z < rows; z++) {
+        source->readRow(z, row.data());
+    }
+    const double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start
+    ).count();
+    cout << "noise:\t\t" << rows * double(size) / seconds / 1e6
+         << " Msamples/s per core" << endl;
+    return source;
+}
+
+/**
+  * Report how fast a simulation went over a grid of cells.
+  */
+void
+reportRate(const char* name, unsigned iterations, size_t cells,
+           std::chrono::steady_clock::time_point start) {
+    const double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start
+    ).count();
+    cout << name << "\t" << iterations << " iterations in " << seconds
+         << " s, " << iterations * double(cells) / seconds / 1e6
+         << " Mcells/s" << endl;
+}
+
+/**
+  * Erode a height map, optionally saving the result, and report how fast
+  * each kind of erosion ran.
+  *
+  * @return The eroded heights.
+  */
+shared_ptr<const HeightSource>
+erode(shared_ptr<const HeightSource> source, unsigned hydraulic,
+      unsigned thermal, const char* outPath) {
+    const unsigned width = source->getWidth();
+    const unsigned depth = source->getDepth();
+    const size_t cells = static_cast<size_t>(width) * depth;
+
+    /* NOTE(jan): The rates are in cells, so erode at the scale the terrain
+     * is drawn at rather than in [0, 1]. */
+    vector<float> heights(cells);
+    for (unsigned z = 0; z < depth; z++) {
+        float* row = heights.data() + static_cast<size_t>(z) * width;
+        source->readRow(z, row);
+        for (unsigned x = 0; x < width; x++) {
+            row[x] *= Terrain::HEIGHT_SCALE;
+        }
+    }
+
+    Erosion erosion(heights.data(), width, depth);
+    auto start = std::chrono::steady_clock::now();
+    erosion.runHydraulic(hydraulic);
+    if (hydraulic > 0) {
+        reportRate("hydraulic:", hydraulic, cells, start);
+        cout << "water left:\t" << erosion.getWater() / double(cells)
+             << " per cell" << endl;
+    }
+    start = std::chrono::steady_clock::now();
+    erosion.runThermal(thermal);
+    if (thermal > 0) {
+        reportRate("thermal:", thermal, cells, start);
+    }
+
+    erosion.writeHeights(heights.data());
+    for (float& height: heights) {
+        height /= Terrain::HEIGHT_SCALE;
+    }
+    if (outPath != nullptr) {
+        Heightmap::write(outPath, width, depth, heights.data());
+    }
+    return make_shared<HeightGrid>(width, depth, std::move(heights));
+}
+
+/**
+  * Stream a height map out to chunk files and report what it took.
+  */
+void
+stream(shared_ptr<const HeightSource> source, const char* prefix,
+       unsigned chunkSize) {
+    /* NOTE(jan): Same as TerrainVertex, which lives with the renderer: a
+     * vec3 position, a vec2 texture coordinate and a float occlusion term.
+     * Normals are left to the normal map. */
+    VertexLayout layout = {};
+    layout.stride = 6 * sizeof(float);
+    layout.position = 0;
+    layout.normal = VertexLayout::ABSENT;
+    layout.tex = 3 * sizeof(float);
+    layout.occlusion = 5 * sizeof(float);
+
+    TerrainStreamer streamer(source, layout, chunkSize);
+    const float maxHeight = streamer.build(prefix);
+    cout << "chunks:\t\t" << streamer.getChunkCountX() << "x"
+         << streamer.getChunkCountZ() << endl;
+    cout << "max height:\t" << maxHeight << endl;
+    cout << "peak heights:\t" << streamer.getPeakBytes() / 1024 << " KiB"
+         << endl;
+}
+
 int main(int argc, char** argv) {
-    if (argc < 2) {
+    vector<const char*> arguments;
+    unsigned hydraulic = 0;
+    unsigned thermal = 0;
+    const char* outPath = nullptr;
+    for (int i = 1; i < argc; i++) {
+        const bool hasValue = i + 1 < argc;
+        if ((strcmp(argv[i], "--hydraulic") == 0) && hasValue) {
+            hydraulic = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if ((strcmp(argv[i], "--thermal") == 0) && hasValue) {
+            thermal = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if ((strcmp(argv[i], "--out") == 0) && hasValue) {
+            outPath = argv[++i];
+        } else {
+            arguments.push_back(argv[i]);
+        }
+    }
+    if (arguments.empty()) {
         usage();
         return 1;
     }
     try {
-        Terrain terrain(argv[1]);
+        shared_ptr<const HeightSource> source = openSource(arguments[0]);
+        if ((hydraulic > 0) || (thermal > 0) || (outPath != nullptr)) {
+            source = erode(source, hydraulic, thermal, outPath);
+        }
+
+        if (arguments.size() >= 2) {
+            const unsigned chunkSize = arguments.size() >= 3
+                ? static_cast<unsigned>(std::atoi(arguments[2]))
+                : TerrainStreamer::DEFAULT_CHUNK_SIZE;
+            stream(source, arguments[1], chunkSize);
+            return 0;
+        }
+
+        Terrain terrain(source);
         cout << "width:\t\t" << terrain.getWidth() << endl;
         cout << "depth:\t\t" << terrain.getDepth() << endl;
         cout << "max height:\t" << terrain.getMaxHeight() << endl;
+
+        /* NOTE(jan): Vertices transformed per triangle for each index
+         * order, with a FIFO cache of VERTEX_CACHE_SIZE entries. */
+        const IndexOrder orders[] = {
+            IndexOrder::ROWS, IndexOrder::CACHE_OPTIMIZED, IndexOrder::STRIPS
+        };
+        const char* names[] = {"rows", "optimized", "strips"};
+        for (unsigned i = 0; i < 3; i++) {
+            vector<uint32_t> indices(terrain.getIndexCount(orders[i]));
+            terrain.writeIndices(indices.data(), orders[i]);
+            cout << "acmr " << names[i] << ":\t"
+                 << getAcmr(indices.data(), indices.size(),
+                            terrain.getVertexCount(), orders[i])
+                 << endl;
+        }
     } catch (exception& e) {
         cerr << e.what() << endl;
     }